@@ -18,6 +18,7 @@
 #include "conditional_gaussian.hpp"
 #include "transforms.hpp"
 #include "utils.hpp"
+#include "measurement_gate.hpp"
 #include "system_constants.hpp"
 
 /**
@@ -71,6 +72,46 @@ void createMeasurementDistributionsAU(const unsigned N,
 		std::map<unsigned, std::vector<rcptr<Factor>>>& predMeasurements,
 		std::map<unsigned, std::vector<rcptr<Factor>>>& validationRegion);
 
+/**
+ * @brief Conditions the candidates' joints on every measurement sharing
+ * an association domain.
+ *
+ * For each candidate p in the domain the product of its predicted
+ * measurement distribution and the other candidates' predicted marginals
+ * is formed once, and all the measurements are then introduced into it
+ * with a single batched observeAndReduce.
+ *
+ * @param domain The association domain shared by the measurements.
+ *
+ * @param members The indices of the measurements sharing the domain.
+ *
+ * @param values The sensor's measurements, indexed as members.
+ *
+ * @param sensor The sensor's index into the predicted measurement distributions.
+ *
+ * @param conditionalLists conditionalLists[j][p] receives candidate p's joint
+ * conditioned on the j-th measurement.
+ */
+void conditionOnMeasurements(const DASS& domain,
+		const std::vector<unsigned>& members,
+		const std::vector<ColVector<double>>& values,
+		const unsigned sensor,
+		const emdw::RVIds& virtualMeasurementVars, 
+		const std::vector<rcptr<Factor>>& predMarginals,
+		std::map<unsigned, std::vector<rcptr<Factor>>>& predMeasurements,
+		std::vector<std::map<emdw::RVIdType, rcptr<Factor>>>& conditionalLists);
+
+/**
+ * @brief Absorbs every measurement node's message into its neighbouring
+ * state nodes.
+ *
+ * The messages destined for each state node are collected first, so that
+ * every state factor is updated and reduced only once.
+ *
+ * @param measurementNodes The current measurement nodes.
+ */
+void absorbMeasurementMessages(std::vector<rcptr<Node>>& measurementNodes);
+
 /**
  * @brief Performs measurement update on exisitng targets.
  *
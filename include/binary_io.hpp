@@ -0,0 +1,139 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the binary encoding of factors. See the notes above
+ * the function declarations.
+ *************************************************************************/
+#ifndef BINARYIO_HPP
+#define BINARYIO_HPP
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "emdw.hpp"
+
+/**
+ * The binary encoding of a factor starts with a four character tag naming
+ * its type, followed by the format version. Values are written in the
+ * host's byte order, arrays are written in a single block without any
+ * per element formatting.
+ *
+ * Readers accept any version up to kBinaryVersion, a new version must
+ * still be able to read the older ones.
+ */
+const uint16_t kBinaryVersion = 1;
+
+/**
+ * @brief Write a trivially copyable value.
+ */
+template <class T>
+inline void writeBinary(std::ostream& file, const T& value) {
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+} // writeBinary()
+
+/**
+ * @brief Write an array of trivially copyable values.
+ */
+template <class T>
+inline void writeBinary(std::ostream& file, const T* values, const size_t n) {
+	if (n) file.write(reinterpret_cast<const char*>(values), n*sizeof(T));
+} // writeBinary()
+
+/**
+ * @brief Read a trivially copyable value.
+ *
+ * @return False if the stream ran out.
+ */
+template <class T>
+inline bool readBinary(std::istream& file, T& value) {
+	return (bool) file.read(reinterpret_cast<char*>(&value), sizeof(T));
+} // readBinary()
+
+/**
+ * @brief Read an array of trivially copyable values.
+ *
+ * @return False if the stream ran out.
+ */
+template <class T>
+inline bool readBinary(std::istream& file, T* values, const size_t n) {
+	if (!n) return (bool) file;
+	return (bool) file.read(reinterpret_cast<char*>(values), n*sizeof(T));
+} // readBinary()
+
+/**
+ * @brief Read an array of trivially copyable values whose length was
+ * read from the stream.
+ *
+ * The array is grown in blocks as the values arrive, so a corrupt length
+ * fails once the stream runs out instead of allocating it up front.
+ *
+ * @return False if the stream ran out.
+ */
+template <class T, class Allocator>
+inline bool readBinary(std::istream& file, std::vector<T, Allocator>& values, const size_t n) {
+	const size_t kBlock = 4096;
+
+	values.clear();
+	for (size_t read = 0; read < n; read += kBlock) {
+		size_t count = std::min(kBlock, n - read);
+		values.resize(read + count);
+		if (!readBinary(file, &values[read], count)) return false;
+	} // for
+
+	return (bool) file;
+} // readBinary()
+
+/**
+ * @brief Write a scope, its size followed by its identities.
+ */
+inline void writeBinary(std::ostream& file, const emdw::RVIds& vars) {
+	writeBinary(file, (uint32_t) vars.size());
+	for (unsigned i = 0; i < vars.size(); i++) writeBinary(file, (uint32_t) vars[i]);
+} // writeBinary()
+
+/**
+ * @brief Read a scope.
+ */
+inline bool readBinary(std::istream& file, emdw::RVIds& vars) {
+	uint32_t n;
+	if (!readBinary(file, n)) return false;
+
+	std::vector<uint32_t> ids;
+	if (!readBinary(file, ids, n)) return false;
+	vars.assign(ids.begin(), ids.end());
+
+	return true;
+} // readBinary()
+
+/**
+ * @brief Write a type tag and the current format version.
+ *
+ * @param tag Four characters naming the encoded type.
+ */
+inline void writeBinaryHeader(std::ostream& file, const char* tag) {
+	file.write(tag, 4);
+	writeBinary(file, kBinaryVersion);
+} // writeBinaryHeader()
+
+/**
+ * @brief Read and check a type tag and format version.
+ *
+ * @return The encoded format version, 0 if the stream ran out.
+ */
+inline uint16_t readBinaryHeader(std::istream& file, const char* tag) {
+	char found[4];
+	uint16_t version = 0;
+	if (!file.read(found, 4) || !readBinary(file, version)) return 0;
+
+	ASSERT( !std::memcmp(found, tag, 4), "Expected an encoded " << std::string(tag, 4)
+			<< " not " << std::string(found, 4) );
+	ASSERT( version && version <= kBinaryVersion, "Unsupported encoding version " << version );
+
+	return version;
+} // readBinaryHeader()
+
+#endif // BINARYIO_HPP
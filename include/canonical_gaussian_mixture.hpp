@@ -9,15 +9,22 @@
 #ifndef CANONICALGAUSSIANMIXTURE_HPP
 #define CANONICALGAUSSIANMIXTURE_HPP
 
+#include <iterator>
 #include "factor.hpp"
 #include "factoroperator.hpp"
 #include "emdw.hpp"
 #include "anytype.hpp"
 #include "gausscanonical.hpp"
 #include "v2vtransform.hpp"
+#include "component_store.hpp"
+#include "operator_policy.hpp"
+#include "step_arena.hpp"
 
 // Forward declaration.
 class CanonicalGaussianMixture;
+class BatchTransform;
+class DifferentiableTransform;
+class TransitionFactor;
 
 /**
  * @brief Prune the Gaussian mixture.
@@ -65,6 +72,92 @@ std::vector<rcptr<Factor>> pruneComponents( const std::vector<rcptr<Factor>>& co
 std::vector<rcptr<Factor>> mergeComponents( const std::vector<rcptr<Factor>>& components, const unsigned maxComps, 
 		const double threshold, const double unionDistance);
 
+/**
+ * @brief Prune a packed Gaussian mixture in place.
+ *
+ * Identical to pruneComponents above, but operates directly
+ * on a mixture's packed components.
+ *
+ * @param logMasses The logarithmic mass of each component, it is
+ * reduced along with the components.
+ *
+ * @param moments The components' moment cache, if given it is
+ * reduced along with the components.
+ */
+void pruneComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, const double threshold, bool clip, ComponentMoments* moments = 0);
+
+/**
+ * @brief Merge the closely spaced components of a packed Gaussian
+ * mixture in place.
+ *
+ * Identical to mergeComponents above, but operates directly
+ * on a mixture's packed components.
+ *
+ * @param logMasses The logarithmic mass of each component, it is
+ * replaced by the masses of the merged components.
+ *
+ * @param moments The components' moment cache, if given the original
+ * components' moments are taken from it. It is invalidated afterwards.
+ */
+void mergeComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, const double threshold, const double unionDistance,
+		ComponentMoments* moments = 0);
+
+/**
+ * @brief Reduce a packed Gaussian mixture by repeatedly merging the
+ * cheapest pair of components.
+ *
+ * The cost of merging components i and j is Runnalls' upper bound on the
+ * Kullback-Leibler divergence it introduces,
+ *
+ *     B(i, j) = 0.5*[ (w_i + w_j)log|S_ij| - w_i log|S_i| - w_j log|S_j| ],
+ *
+ * where S_ij is the covariance of the moment matched pair. All pairwise costs
+ * are kept on a priority queue, after each merge only the merged component's
+ * costs are added. Components without finite mass are discarded.
+ *
+ * See A. R. Runnalls, "Kullback-Leibler approach to Gaussian mixture
+ * reduction", IEEE Transactions on Aerospace and Electronic Systems, 2007.
+ *
+ * @param components The components, replaced by the reduced mixture.
+ *
+ * @param logMasses The logarithmic mass of each component, it is
+ * replaced by the masses of the reduced components.
+ *
+ * @param maxComp The number of components to reduce to.
+ *
+ * @param moments The components' moment cache, if given the original
+ * components' moments are taken from it. It is invalidated afterwards.
+ */
+void runnallsReduceComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, ComponentMoments* moments = 0);
+
+/**
+ * @brief Fused product and reduction of two packed Gaussian mixtures.
+ *
+ * Every pair of components is first only scored by the logarithmic
+ * mass of its product. The maxComp heaviest products above the threshold
+ * are then formed one at a time, heaviest first, and each is merged with
+ * the first previously formed product whose mean lies within unionDistance
+ * of its own. The full product is never stored.
+ *
+ * If no product has a finite mass, the full product is formed instead.
+ *
+ * @param components The lhs components, they must already span the
+ * product's scope, see embedComponents. They are replaced by the reduced
+ * product.
+ *
+ * @param rhs The rhs components, may not be the same store.
+ *
+ * @param rhsMap rhsMap[i] is the position of rhs' i-th variable in the product.
+ *
+ * @param logMasses The logarithmic mass of each reduced product.
+ */
+void absorbAndReduceComponents(ComponentStore& components, const ComponentStore& rhs,
+		const std::vector<unsigned>& rhsMap, const unsigned maxComp, const double threshold,
+		const double unionDistance, std::vector<double>& logMasses);
+
 /**
  * @brief Match a Gaussian Mixture's moments with a single Gaussian.
  *
@@ -174,15 +267,183 @@ class InplaceWeakDampingCGM : public Operator1<CanonicalGaussianMixture> {
 				double df);
 }; // InplaceWeakDampingCGM
 
+/**
+ * @brief Inplace reduction operator, prunes and then merges.
+ *
+ * The default reducer, see pruneAndMerge.
+ */
+class InplacePruneAndMergeCGM : public Operator1<CanonicalGaussianMixture> {
+	public:
+		const std::string& isA() const;
+		void inplaceProcess(CanonicalGaussianMixture* lhsPtr);
+}; // InplacePruneAndMergeCGM
+
+/**
+ * @brief Inplace reduction operator, greedily merges the pair of
+ * components that loses the least information.
+ *
+ * See runnallsReduceComponents.
+ */
+class InplaceRunnallsReduceCGM : public Operator1<CanonicalGaussianMixture> {
+	public:
+		const std::string& isA() const;
+		void inplaceProcess(CanonicalGaussianMixture* lhsPtr);
+}; // InplaceRunnallsReduceCGM
+
+/**
+ * @brief Read-only view of a single mixture component.
+ *
+ * Refers directly to a mixture's packed component, nothing is copied
+ * until one of the gLinear getters or clone is called. A view is only
+ * valid while the mixture it was taken from is alive and unmodified.
+ */
+class ComponentView {
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param vars The mixture's scope.
+		 *
+		 * @param components The mixture's packed components.
+		 *
+		 * @param i The component's index.
+		 *
+		 * @param moments The mixture's moment cache, if null the
+		 * moments are determined on every request.
+		 */
+		ComponentView(const emdw::RVIds& vars, const ComponentStore& components, const unsigned i,
+				ComponentMoments* moments = 0)
+			: vars_(&vars), comps_(&components), moments_(moments), i_(i) {}
+
+	public:
+		/**
+		 * @brief The component's scope.
+		 */
+		const emdw::RVIds& getVars() const { return *vars_; }
+
+		/**
+		 * @brief Returns the number of variables.
+		 */
+		unsigned noOfVars() const { return vars_->size(); }
+
+		/**
+		 * @brief Pointer to the row major precision matrix.
+		 */
+		const double* K() const { return comps_->K(i_); }
+
+		/**
+		 * @brief Pointer to the information vector.
+		 */
+		const double* h() const { return comps_->h(i_); }
+
+		/**
+		 * @brief The normalising constant.
+		 */
+		double getG() const { return comps_->g(i_); }
+
+		/**
+		 * @brief Copy of the precision matrix.
+		 */
+		Matrix<double> getK() const { return comps_->getK(i_); }
+
+		/**
+		 * @brief Copy of the information vector.
+		 */
+		ColVector<double> getH() const { return comps_->getH(i_); }
+
+		/**
+		 * @brief The packed components the view refers to.
+		 */
+		const ComponentStore& getStore() const { return *comps_; }
+
+		/**
+		 * @brief The component's index in its store.
+		 */
+		unsigned getIndex() const { return i_; }
+
+		/**
+		 * @brief The component's mass in logarithmic form.
+		 */
+		double getLogMass() const;
+
+		/**
+		 * @brief The component's mean.
+		 */
+		ColVector<double> getMean() const;
+
+		/**
+		 * @brief The component's covariance matrix.
+		 */
+		Matrix<double> getCov() const;
+
+		/**
+		 * @brief Deep copy the component into a new GaussCanonical.
+		 */
+		uniqptr<Factor> clone() const;
+
+	private:
+		const emdw::RVIds* vars_;
+		const ComponentStore* comps_;
+		ComponentMoments* moments_;
+		unsigned i_;
+}; // ComponentView
+
+/**
+ * @brief Forward iterator over a mixture's components.
+ */
+class ComponentIterator : public std::iterator<std::forward_iterator_tag, ComponentView> {
+	public:
+		ComponentIterator(const emdw::RVIds& vars, const ComponentStore& components, const unsigned i,
+				ComponentMoments* moments = 0)
+			: vars_(&vars), comps_(&components), moments_(moments), i_(i) {}
+
+		ComponentView operator*() const { return ComponentView(*vars_, *comps_, i_, moments_); }
+		ComponentIterator& operator++() { i_++; return *this; }
+		bool operator==(const ComponentIterator& rhs) const { return i_ == rhs.i_ && comps_ == rhs.comps_; }
+		bool operator!=(const ComponentIterator& rhs) const { return !(*this == rhs); }
+
+	private:
+		const emdw::RVIds* vars_;
+		const ComponentStore* comps_;
+		ComponentMoments* moments_;
+		unsigned i_;
+}; // ComponentIterator
+
+/**
+ * @brief Range over a mixture's components, for use in range-based for loops.
+ */
+class ComponentRange {
+	public:
+		ComponentRange(const emdw::RVIds& vars, const ComponentStore& components, ComponentMoments* moments = 0)
+			: vars_(&vars), comps_(&components), moments_(moments) {}
+
+		ComponentIterator begin() const { return ComponentIterator(*vars_, *comps_, 0, moments_); }
+		ComponentIterator end() const { return ComponentIterator(*vars_, *comps_, comps_->size(), moments_); }
+		unsigned size() const { return comps_->size(); }
+		ComponentView operator[](const unsigned i) const { return ComponentView(*vars_, *comps_, i, moments_); }
+
+	private:
+		const emdw::RVIds* vars_;
+		const ComponentStore* comps_;
+		ComponentMoments* moments_;
+}; // ComponentRange
+
 /**
  * @brief Canonical Gaussian Mixture Model
  *
- * A rough Gaussian Mixture implementation. It is a wrapper type 
- * for a vector of GaussCanonical factors, the weight of each
- * GM component is hidden in GaussCanonical's g component.
+ * A rough Gaussian Mixture implementation. The components are kept
+ * in canonical form in a packed ComponentStore, the weight of each
+ * GM component is hidden in its g component. The components can be
+ * read in place through components(), GaussCanonical factors are only
+ * created on demand, see cloneComponents.
  *
- * For now, the underlying GaussCanonical factors make use of
- * their default operators. The mixture is limited in size
+ * The mixture's operators work directly on the packed components. The
+ * linear and affine constructors add a TransitionFactor's blocks to each
+ * component. The non-linear constructor linearises each component about
+ * its mean if the transform is a linearised DifferentiableTransform, and
+ * propagates every remaining component's sigma points at once if it is a
+ * BatchTransform. Only other transforms pass each component through
+ * GaussCanonical. The mixture is limited in size
  * to some maximum number of components, after which insignificant 
  * components are pruned and the closely spaced components 
  * merged. If the mixture is still too large after pruning and merging, only
@@ -199,14 +460,8 @@ class InplaceWeakDampingCGM : public Operator1<CanonicalGaussianMixture> {
  * which aren't are noted in the documentation. inplaceWeakDamping is
  * is not implemented.
  *
- * The vacuous constructor is alright in CanonicalGaussianMixture,
- * but GaussCanonical's vacuous constructor currently does 
- * initialize the variables properly and can lead to strange errors.
- * This probably because no one has ever used the vacuous constructor before.
- *
  * The implementation is fairly lax; it doesn't bother checking dimensional
- * consistency and the like. To play it safe, there is a ridiculous amount of
- * copying of the GM components which is expensive and probably unnecessary.
+ * consistency and the like.
  *
  * Never use in a ClusterGraph.
  *
@@ -224,17 +479,15 @@ class CanonicalGaussianMixture : public Factor {
 	friend class MarginalizeCGM;
 	friend class ObserveAndReduceCGM;
 	friend class InplaceWeakDampingCGM;
+	friend class InplacePruneAndMergeCGM;
+	friend class InplaceRunnallsReduceCGM;
 
 	public:
 		/** 
 		 * @brief Default vacuous constructor.
 		 * 
-		 * Creates a single vacuous component Gaussian mixture.
-		 *
-		 * This currently is a bit dodgy from GaussCanonical's
-		 * side, as its vacuous constructor doesn't initialise
-		 * the g, h, K parameters as zero so weird errors may 
-		 * result.
+		 * Creates a single vacuous component Gaussian mixture,
+		 * its K, h and g are all zero.
 		 * 
 		 * @param vars Each variable in the PGM will be identified
 		 * with a specific integer that indentifies it.
@@ -472,12 +725,118 @@ class CanonicalGaussianMixture : public Factor {
 				const rcptr<FactorOperator>& inplaceDamper = 0
 				);
 
+		/** 
+		 * @brief Affine Gaussian constructor.
+		 * 
+		 * Creates a new Gaussian Mixture over x and y = Ax + b + e from
+		 * an existing Gaussian Mixture over x. The joint is formed in
+		 * closed form, see TransitionFactor.
+		 * 
+		 * @param xFPtr A pointer to an existing CanonicalGaussianMixture.
+		 *
+		 * @param A A matrix describing some appropriate linear transform.
+		 *
+		 * @param b The transform's offset.
+		 *
+		 * @param newVars The scope of the newly created GM.
+		 *
+		 * @param Q A noise covariance matrix.
+		 *
+		 * @param presorted Set to true if vars is sorted according to their 
+		 * integer values.
+		 *
+		 * @param maxComponents The maximum allowable number of components in the mixture.
+		 *
+		 * @param threshold The mimimum allowable mass a component is allowed to contribute. Given in logarithmic form.
+		 *
+		 * @param unionDistance The minimum Mahalanobis distance allowed between components.
+		 * If the distance between their means is less than this threshold they merged into 
+		 * one.
+		 *
+		 * A list of Factor operators, if it equals zero it will be set to a default
+		 * operator.
+		 */
+		CanonicalGaussianMixture(
+				const rcptr<Factor>& xFPtr,
+				const Matrix<double>& A,
+				const ColVector<double>& b,
+				const emdw::RVIds& newVars,
+				const Matrix<double>& Q,
+				bool presorted = false,
+				const unsigned maxComponents = 3,
+				const double threshold = -2000,
+				const double unionDistance = 9,
+				const rcptr<FactorOperator>& inplaceNormalizer = 0,
+				const rcptr<FactorOperator>& normalizer = 0,
+				const rcptr<FactorOperator>& inplaceAbsorber = 0,
+				const rcptr<FactorOperator>& absorber = 0,
+				const rcptr<FactorOperator>& inplaceCanceller = 0,
+				const rcptr<FactorOperator>& canceller = 0,
+				const rcptr<FactorOperator>& marginalizer = 0,
+				const rcptr<FactorOperator>& observerAndReducer = 0,
+				const rcptr<FactorOperator>& inplaceDamper = 0
+				);
+
+		/** 
+		 * @brief Transition constructor.
+		 * 
+		 * Creates a new Gaussian Mixture over x and y from an existing
+		 * Gaussian Mixture over x and a precomputed transition, each
+		 * joint component is a prior component plus the transition's
+		 * blocks.
+		 * 
+		 * @param xFPtr A pointer to an existing CanonicalGaussianMixture.
+		 *
+		 * @param transition The transition from x to y, it includes the noise.
+		 *
+		 * @param newVars The scope of the newly created GM.
+		 *
+		 * @param presorted Set to true if vars is sorted according to their 
+		 * integer values.
+		 *
+		 * @param maxComponents The maximum allowable number of components in the mixture.
+		 *
+		 * @param threshold The mimimum allowable mass a component is allowed to contribute. Given in logarithmic form.
+		 *
+		 * @param unionDistance The minimum Mahalanobis distance allowed between components.
+		 * If the distance between their means is less than this threshold they merged into 
+		 * one.
+		 *
+		 * A list of Factor operators, if it equals zero it will be set to a default
+		 * operator.
+		 */
+		CanonicalGaussianMixture(
+				const rcptr<Factor>& xFPtr,
+				const rcptr<const TransitionFactor>& transition,
+				const emdw::RVIds& newVars,
+				bool presorted = false,
+				const unsigned maxComponents = 3,
+				const double threshold = -2000,
+				const double unionDistance = 9,
+				const rcptr<FactorOperator>& inplaceNormalizer = 0,
+				const rcptr<FactorOperator>& normalizer = 0,
+				const rcptr<FactorOperator>& inplaceAbsorber = 0,
+				const rcptr<FactorOperator>& absorber = 0,
+				const rcptr<FactorOperator>& inplaceCanceller = 0,
+				const rcptr<FactorOperator>& canceller = 0,
+				const rcptr<FactorOperator>& marginalizer = 0,
+				const rcptr<FactorOperator>& observerAndReducer = 0,
+				const rcptr<FactorOperator>& inplaceDamper = 0
+				);
+
 		/** 
 		 * @brief Non-linear Gaussian constructor.
 		 * 
 		 * Creates a new Gaussian Mixture by shifting an exisiting
 		 * Gaussian Mixture through a non-linear transfrom according to 
 		 * Chapman-Kolmogrov equation using the Unscented Transform.
+		 * If the transform is an AffineTransform the joint is formed
+		 * exactly instead, see TransitionFactor. A linearised
+		 * DifferentiableTransform is linearised about each component's
+		 * mean, see linearisedTransform. Otherwise, if the
+		 * transform is also a BatchTransform the sigma points
+		 * of all the components are propagated together, see
+		 * unscentedTransform.
 		 * 
 		 * @param xFPtr A pointer to an existing CanonicalGaussianMixture.
 		 *
@@ -543,8 +902,8 @@ class CanonicalGaussianMixture : public Factor {
 		 * @brief Class specific configuration
 		 *
 		 * Reconfigures the exsiting clas, replacing old members with new 
-		 * ones. It may seem pointless, but it greatly simplifies the 
-		 * inplaceProcesses.
+		 * ones. The inplace operators no longer use this, they change
+		 * the existing components directly.
 		 *list
 		 * @param vars Each variable in the PGM will be identified
 		 * with a specific integer that indentifies it.
@@ -680,7 +1039,7 @@ class CanonicalGaussianMixture : public Factor {
 		 *
 		 * @return A unique pointer to the scoped reduced Factor.
 		 */
-		inline uniqptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
+		uniqptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
 				bool presorted = false, FactorOperator* procPtr = 0) const;
 
 		/**
@@ -764,12 +1123,28 @@ class CanonicalGaussianMixture : public Factor {
 		 */
 		virtual std::ostream& txtWrite(std::ostream& file) const;
 
+		/**
+		 * @brief Write the mixture in binary.
+		 *
+		 * Writes the scope, the pruning and merging characteristics
+		 * and the packed K, h and g of every component, see binary_io.hpp.
+		 * The operators are not written.
+		 */
+		std::ostream& binWrite(std::ostream& file) const;
+
+		/**
+		 * @brief Replace the mixture with one read in binary, keeping
+		 * the current operators.
+		 */
+		std::istream& binRead(std::istream& file);
+
 	public:
 		/**
 		 * @brief Moment match the mixture with a single Gaussian.
 		 *
 		 * Determine a single GaussCanonical which matches the mixture's
-		 * first two moments.
+		 * first two moments. The collapse is cached until the mixture
+		 * next changes.
 		 *
 		 * @return A unique pointer to a single GaussCanonical Factor
 		 * with matching moments.
@@ -781,13 +1156,52 @@ class CanonicalGaussianMixture : public Factor {
 		 *
 		 * Determine a single Gaussian which matches the mixtures
 		 * first two moments. This returns a CanonicalGaussianMixture 
-		 * containing a single component.
+		 * containing a single component. The collapse is cached until
+		 * the mixture next changes.
 		 *
 		 * @return A unique pointer to a single CanonicalGaussianMixture
 		 * Factor a single components with matching moments.
 		 */
 		uniqptr<Factor> momentMatchCGM() const;
 
+		/**
+		 * @brief Moment match the mixture with a single Gaussian,
+		 * made in the given arena.
+		 *
+		 * @param arena The arena of the current time step.
+		 *
+		 * @return A single GaussCanonical Factor with matching moments.
+		 */
+		rcptr<Factor> momentMatch(StepArena& arena) const;
+
+		/**
+		 * @brief Moment match the mixture with a single component
+		 * CanonicalGaussianMixture, made in the given arena.
+		 *
+		 * @param arena The arena of the current time step.
+		 *
+		 * @return A single component CanonicalGaussianMixture Factor
+		 * with matching moments.
+		 */
+		rcptr<Factor> momentMatchCGM(StepArena& arena) const;
+
+		/**
+		 * @return The number of collapses served from a mixture's
+		 * cache since the counters were last reset.
+		 */
+		static unsigned long collapseHits();
+
+		/**
+		 * @return The number of collapses determined afresh since
+		 * the counters were last reset.
+		 */
+		static unsigned long collapseMisses();
+
+		/**
+		 * @brief Reset the collapse hit and miss counters.
+		 */
+		static void resetCollapseCounters();
+
 		/**
 		 * @brief Prunes insignificant components and
 		 * merges closely spaced components.
@@ -798,6 +1212,90 @@ class CanonicalGaussianMixture : public Factor {
 		 */
 		void pruneAndMerge();
 
+		/**
+		 * @brief Reduces the mixture to at most the maximum number
+		 * of components.
+		 *
+		 * @param procPtr The reduction operator, if null the mixture's
+		 * own reducer is used. See setReducer.
+		 */
+		void reduce(FactorOperator* procPtr = 0);
+
+		/**
+		 * @brief Set the mixture's reduction operator.
+		 *
+		 * @param reducer Either InplacePruneAndMergeCGM, the default, or
+		 * InplaceRunnallsReduceCGM. If null the default is used.
+		 */
+		void setReducer(const rcptr<FactorOperator>& reducer);
+
+		/**
+		 * @brief Keep the components' moments in square root form.
+		 *
+		 * The Cholesky factors of the components' precisions are then
+		 * kept alongside K, h and g: absorbing and cancelling update them
+		 * in place instead of discarding them, and nearly singular
+		 * precisions, such as those of the clutter states, are factored
+		 * with a floor on their pivots rather than rejected. Mixtures
+		 * derived from this one inherit the setting. Off by default.
+		 */
+		void setSquareRoot(const bool squareRoot);
+
+		/**
+		 * @brief Are the components' moments kept in square root form?
+		 */
+		bool isSquareRoot() const;
+
+		/**
+		 * @brief Absorb a factor, keeping the product within the
+		 * mixture's component budget.
+		 *
+		 * Equivalent to inplaceAbsorb followed by reduce. With the default
+		 * reducer, if the product would exceed the maximum number of
+		 * components only the retained products are formed, see
+		 * absorbAndReduceComponents.
+		 *
+		 * @param rhsPtr A CanonicalGaussianMixture or GaussCanonical.
+		 */
+		void inplaceAbsorbAndReduce(const Factor* rhsPtr);
+
+		/**
+		 * @brief Absorb and cancel a batch of messages with a single
+		 * reduction.
+		 *
+		 * The cancelled messages are divided out first, which never adds
+		 * components. The absorbed messages are multiplied together, they
+		 * are small compared to the mixture, and their product is absorbed
+		 * with inplaceAbsorbAndReduce.
+		 *
+		 * @param absorbed The messages to absorb.
+		 *
+		 * @param cancelled The messages to cancel.
+		 */
+		void inplaceAbsorbAndReduce(const std::vector<rcptr<Factor>>& absorbed,
+				const std::vector<rcptr<Factor>>& cancelled);
+
+		/**
+		 * @brief Introduce several measurements of the same variables,
+		 * one at a time.
+		 *
+		 * Equivalent to calling observeAndReduce once per measurement,
+		 * but the scope is split and each component's blocks are gathered
+		 * only once, see observeComponents.
+		 *
+		 * @param variables The observed variables.
+		 *
+		 * @param values values[t] is the t-th measurement, in the same
+		 * order as variables.
+		 *
+		 * @param arena If given, the reduced mixtures are made in it.
+		 *
+		 * @return One reduced mixture per measurement.
+		 */
+		std::vector<rcptr<Factor>> observeAndReduce(const emdw::RVIds& variables,
+				const std::vector<ColVector<double>>& values,
+				StepArena* arena = 0) const;
+
 	public:
 		/**
 		 * @brief Adjust the mass of each component in the GM.
@@ -809,9 +1307,47 @@ class CanonicalGaussianMixture : public Factor {
 		 */
 		void adjustMass(const double mass);
 
+		/**
+		 * @brief Append a copy of a component to the mixture.
+		 *
+		 * @param component A component with the same scope as the mixture.
+		 *
+		 * @param logMass A shift in the component's weight, given in logarithmic form.
+		 */
+		void appendComponent(const ComponentView& component, const double logMass = 0.0);
+
+		/**
+		 * @brief Append a GaussCanonical to the mixture.
+		 *
+		 * @param component A GaussCanonical with the same scope as the mixture.
+		 *
+		 * @param logMass A shift in the component's weight, given in logarithmic form.
+		 */
+		void appendComponent(const Factor* component, const double logMass = 0.0);
+
 	public:
+		/**
+		 * @brief Read-only access to a single component, nothing is copied.
+		 */
+		ComponentView getComponent(const unsigned i) const;
+
+		/**
+		 * @brief Read-only range over the components, nothing is copied.
+		 */
+		ComponentRange components() const;
+
+		/**
+		 * @brief Deep copy the mixture components.
+		 *
+		 * Each component is unpacked into a new GaussCanonical. Only use
+		 * this if ownership is required, otherwise see components().
+		 */
+		std::vector<rcptr<Factor>> cloneComponents() const;
+
 		/**
 		 * @brief Return Gaussian mixture components.
+		 *
+		 * Identical to cloneComponents.
 		 */
 		std::vector<rcptr<Factor>> getComponents() const;
 
@@ -833,6 +1369,11 @@ class CanonicalGaussianMixture : public Factor {
 		 */
 		double getLogMass() const;
 
+		/**
+		 * @brief Return the logarithmic mass of each component.
+		 */
+		std::vector<double> getLogWeights() const;
+
 		/**
 		 * @brief Return the weights.
 		 */
@@ -863,28 +1404,121 @@ class CanonicalGaussianMixture : public Factor {
 		 */
 		std::vector<Matrix<double>> getK() const;
 
+	private:
+		/**
+		 * @brief Append a single component matching the mixture's
+		 * first two moments to matched.
+		 *
+		 * The components' cached moments are read in place and
+		 * accumulated in a single pass, into stack buffers for the
+		 * tracker's dimensions. Masses not yet cached are determined
+		 * in the same pass and cached.
+		 */
+		void matchMoments(ComponentStore& matched) const;
+
+		/**
+		 * @brief The single component matching the mixture's first
+		 * two moments.
+		 *
+		 * Determined with matchMoments on first use and reused until
+		 * the components next change, as tracked by generation_.
+		 *
+		 * @return A store holding the single matched component.
+		 */
+		const ComponentStore& collapsed() const;
+
+		/**
+		 * @brief Determine the logarithmic mass of each component
+		 * and of the mixture, unless they are already cached.
+		 */
+		void updateMasses() const;
+
+		/**
+		 * @brief Form the components of the joint over x and y
+		 * through a transition.
+		 *
+		 * @param x The mixture over x.
+		 *
+		 * @param transition The transition from x to y.
+		 *
+		 * @param newVars The scope of y.
+		 */
+		void predict(const CanonicalGaussianMixture& x, const TransitionFactor& transition,
+				const emdw::RVIds& newVars);
+
+		/**
+		 * @brief Append the components of the joint over x and
+		 * y = f(x) + e, linearising f about each component's mean.
+		 *
+		 * One evaluation of f and its Jacobian J per component replaces
+		 * the sigma points, y ~ Jx + (f(mu) - J mu) + e is then exact, see
+		 * TransitionFactor. Components of x without moments are skipped.
+		 * The joint's components are over x then y, unsorted.
+		 *
+		 * @param x The mixture over x.
+		 *
+		 * @param newVars The scope of y.
+		 *
+		 * @param Q The covariance of the noise e.
+		 *
+		 * @param rejected Appended with the components the transform
+		 * refused to linearise.
+		 */
+		void linearisedTransform(const CanonicalGaussianMixture& x, const DifferentiableTransform& transform,
+				const emdw::RVIds& newVars, const Matrix<double>& Q, std::vector<unsigned>& rejected);
+
+		/**
+		 * @brief Append the components of the joint over x and y = f(x) + e.
+		 *
+		 * The 2n + 1 sigma points of every selected component of x are
+		 * generated together and passed through the transform in a single
+		 * block, their statistics then determine each joint component's
+		 * moments. Components of x without moments are skipped. The
+		 * joint's components are over x then y, unsorted.
+		 *
+		 * @param x The mixture over x.
+		 *
+		 * @param newVars The scope of y.
+		 *
+		 * @param Q The covariance of the noise e.
+		 *
+		 * @param indices The components of x to transform.
+		 */
+		void unscentedTransform(const CanonicalGaussianMixture& x, const BatchTransform& transform,
+				const emdw::RVIds& newVars, const Matrix<double>& Q, const std::vector<unsigned>& indices);
+
 	// Data Members
 	private:
 		// Scope and components
 		emdw::RVIds vars_;
-		mutable std::vector<rcptr<Factor>> comps_;
-		mutable unsigned N_;
+		ComponentStore comps_;
+
+		// Cached logarithmic masses, only valid if massesValid_ is set
+		mutable std::vector<double> logMasses_;
+		mutable double logMass_ = 0;
+		mutable bool massesValid_ = false;
+
+		// Lazily determined moments of each component
+		mutable ComponentMoments moments_;
+
+		// Bumped whenever the components change
+		unsigned long generation_ = 0;
+
+		// Cached collapse, only valid if collapsedGeneration_ == generation_
+		mutable ComponentStore collapsed_;
+		mutable unsigned long collapsedGeneration_ = 0;
+
+		// Collapse cache statistics, shared by every mixture
+		static unsigned long collapseHits_;
+		static unsigned long collapseMisses_;
 
 		// Pruning and merging characteristics
 		mutable unsigned maxComp_;
 		mutable double threshold_;
 		mutable double unionDistance_;
 
-		// Operators
-		rcptr<FactorOperator> inplaceNormalizer_;
-		rcptr<FactorOperator> normalizer_;
-		rcptr<FactorOperator> inplaceAbsorber_;
-		rcptr<FactorOperator> absorber_;
-		rcptr<FactorOperator> inplaceCanceller_;
-		rcptr<FactorOperator> canceller_;
-		rcptr<FactorOperator> marginalizer_;
-		rcptr<FactorOperator> observeAndReducer_;
-		rcptr<FactorOperator> inplaceDamper_;
+		// Operators, shared with every mixture using the same operators
+		rcptr<const OperatorPolicy> ops_;
 
 }; // CanonicalGaussianMixture 
 
@@ -0,0 +1,103 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the spatial index over mixture component means. See
+ * the notes above the class declaration.
+ *************************************************************************/
+#ifndef COMPONENTINDEX_HPP
+#define COMPONENTINDEX_HPP
+
+#include <vector>
+
+/**
+ * @brief A kd-tree over the means of a mixture's components.
+ *
+ * Used by mergeComponents to find the components which could lie within
+ * the union distance of a dominant component, without testing every
+ * remaining component. Each point i carries its own search radius r_i,
+ * a query at c returns every point with |p_i - c| <= r_i. Every node keeps
+ * the bounding box and the largest radius of its points, so whole subtrees
+ * are skipped.
+ *
+ * Points can be removed, emptied subtrees are skipped as well. The
+ * points and radii are not copied, they must outlive the index.
+ *
+ * @author SCJ Robertson
+ * @since 05/06/17
+ */
+class ComponentIndex {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param points N row major points of the given dimension.
+		 *
+		 * @param radii The search radius of each point.
+		 *
+		 * @param dimension The dimension of each point.
+		 */
+		ComponentIndex(const std::vector<double>& points, const std::vector<double>& radii,
+				const unsigned dimension);
+
+	public:
+		/**
+		 * @brief Find every remaining point within its radius of the centre.
+		 *
+		 * @param centre A point of the index's dimension.
+		 *
+		 * @param found The indices of the points found, in increasing order.
+		 */
+		void query(const double* centre, std::vector<unsigned>& found) const;
+
+		/**
+		 * @brief Remove point i from the index.
+		 */
+		void remove(const unsigned i);
+
+		/**
+		 * @brief The number of remaining points.
+		 */
+		unsigned size() const { return nodes_.empty() ? 0 : nodes_[0].alive; }
+
+	private:
+		/**
+		 * @brief Recursively build the subtree over order_[begin, end).
+		 *
+		 * @return The node's index.
+		 */
+		unsigned build(const unsigned begin, const unsigned end, const unsigned parent);
+
+		/**
+		 * @brief Recursively query a subtree.
+		 */
+		void query(const unsigned node, const double* centre, std::vector<unsigned>& found) const;
+
+	private:
+		struct Node {
+			unsigned begin, end;
+			unsigned left, right;
+			unsigned parent;
+			unsigned alive;
+			double radius;
+		}; // Node
+
+	// Data Members
+	private:
+		unsigned dim_;
+		const std::vector<double>& points_;
+		const std::vector<double>& radii_;
+
+		std::vector<Node> nodes_;
+		std::vector<double> lower_;
+		std::vector<double> upper_;
+
+		std::vector<unsigned> order_;
+		std::vector<unsigned> leaf_;
+		std::vector<bool> removed_;
+
+}; // ComponentIndex
+
+#endif // COMPONENTINDEX_HPP
@@ -0,0 +1,568 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the packed component storage used by the Canonical
+ * Gaussian Mixture. See the notes above the class declaration.
+ *************************************************************************/
+#ifndef COMPONENTSTORE_HPP
+#define COMPONENTSTORE_HPP
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+
+/**
+ * @brief A minimal aligned allocator.
+ *
+ * Allocates memory aligned to the given boundary, so that the packed
+ * component blocks start on a cache line.
+ */
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator {
+	public:
+		typedef T value_type;
+
+		template<typename U>
+		struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+		AlignedAllocator() {}
+
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+		T* allocate(size_t n) {
+			void* ptr = 0;
+			if (posix_memalign(&ptr, Alignment, n*sizeof(T))) throw std::bad_alloc();
+			return static_cast<T*>(ptr);
+		} // allocate()
+
+		void deallocate(T* ptr, size_t) { free(ptr); }
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+}; // AlignedAllocator
+
+/**
+ * @brief Packed storage for the components of a canonical Gaussian mixture.
+ *
+ * Every component shares the same scope, so the precision matrices,
+ * information vectors and normalising constants are stored back to back
+ * in three contiguous arrays. Component i's precision matrix occupies
+ * the d*d doubles starting at K(i) (row major), its information vector
+ * the d doubles starting at h(i) and its normalising constant is g(i).
+ *
+ * The store knows nothing about random variables, scopes are
+ * managed by CanonicalGaussianMixture.
+ *
+ * @author SCJ Robertson
+ * @since 02/06/17
+ */
+class ComponentStore {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param dimension The dimension of each component.
+		 *
+		 * @param capacity The number of components to reserve space for.
+		 */
+		ComponentStore(const unsigned dimension = 0, const unsigned capacity = 0);
+
+	public:
+		/**
+		 * @brief The dimension of each component.
+		 */
+		unsigned getDimension() const { return dim_; }
+
+		/**
+		 * @brief The number of components.
+		 */
+		unsigned size() const { return N_; }
+
+		/**
+		 * @brief Are there any components?
+		 */
+		bool empty() const { return N_ == 0; }
+
+		/**
+		 * @brief Reserve space for a number of components.
+		 */
+		void reserve(const unsigned capacity);
+
+		/**
+		 * @brief Resize the store, new components are left uninitialised.
+		 */
+		void resize(const unsigned N);
+
+		/**
+		 * @brief Remove all components, keeping the dimension and capacity.
+		 */
+		void clear() { N_ = 0; }
+
+		/**
+		 * @brief Remove all components and change the dimension.
+		 */
+		void reset(const unsigned dimension);
+
+		/**
+		 * @brief Swap the contents of two stores.
+		 */
+		void swap(ComponentStore& other);
+
+	public:
+		/**
+		 * @brief Append a component.
+		 *
+		 * @param K A pointer to a row major d*d precision matrix.
+		 *
+		 * @param h A pointer to a d dimensional information vector.
+		 *
+		 * @param g The normalising constant.
+		 *
+		 * @return The index of the new component.
+		 */
+		unsigned append(const double* K, const double* h, const double g);
+
+		/**
+		 * @brief Append a component given in gLinear form.
+		 */
+		unsigned append(const Matrix<double>& K, const ColVector<double>& h, const double g);
+
+		/**
+		 * @brief Append component i of another store of the same dimension.
+		 *
+		 * The store may append one of its own components.
+		 */
+		unsigned append(const ComponentStore& other, const unsigned i);
+
+		/**
+		 * @brief Keep only the selected components, in the given order.
+		 *
+		 * @param indices The components to keep. Unless a component is
+		 * repeated the store is rearranged in place.
+		 */
+		void select(const std::vector<unsigned>& indices);
+
+	public:
+		/**
+		 * @brief Pointer to component i's precision matrix.
+		 */
+		double* K(const unsigned i) { return K_.data() + i*dim_*dim_; }
+		const double* K(const unsigned i) const { return K_.data() + i*dim_*dim_; }
+
+		/**
+		 * @brief Pointer to component i's information vector.
+		 */
+		double* h(const unsigned i) { return h_.data() + i*dim_; }
+		const double* h(const unsigned i) const { return h_.data() + i*dim_; }
+
+		/**
+		 * @brief Component i's normalising constant.
+		 */
+		double& g(const unsigned i) { return g_[i]; }
+		double g(const unsigned i) const { return g_[i]; }
+
+		/**
+		 * @brief Copy component i's precision matrix into gLinear form.
+		 */
+		Matrix<double> getK(const unsigned i) const;
+
+		/**
+		 * @brief Copy component i's information vector into gLinear form.
+		 */
+		ColVector<double> getH(const unsigned i) const;
+
+	public:
+		/**
+		 * @brief Write the dimension, the number of components and
+		 * the packed K, h and g arrays in binary.
+		 */
+		std::ostream& write(std::ostream& file) const;
+
+		/**
+		 * @brief Replace the contents with components read in binary.
+		 */
+		std::istream& read(std::istream& file);
+
+	// Data Members
+	private:
+		unsigned dim_;
+		unsigned N_;
+
+		std::vector<double, AlignedAllocator<double>> K_;
+		std::vector<double, AlignedAllocator<double>> h_;
+		std::vector<double> g_;
+
+}; // ComponentStore
+
+/**
+ * @brief Lazily determined moment form of a store's components.
+ *
+ * Most of the mixture operations need a component's mean, covariance
+ * or mass rather than its canonical parameters, and every one of these
+ * requires the Cholesky decomposition of K. The cache computes them the
+ * first time component i is asked for and keeps them until the component
+ * is invalidated.
+ *
+ * The cache does not observe the store, whoever changes a component's
+ * K or h has to invalidate it. Changing only g leaves the moments intact.
+ *
+ * Optionally the cache keeps the moments in square root form: absorbing
+ * into or cancelling from the store then updates the cached Cholesky
+ * factors in place, see combine, rather than discarding them.
+ *
+ * @author SCJ Robertson
+ * @since 04/06/17
+ */
+class ComponentMoments {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 */
+		ComponentMoments() : dim_(0), squareRoot_(false) {}
+
+	public:
+		/**
+		 * @brief Forget every component's moments.
+		 */
+		void invalidate() { state_.clear(); }
+
+		/**
+		 * @brief Forget component i's moments.
+		 */
+		void invalidate(const unsigned i) { if (i < state_.size()) state_[i] = kUnknown; }
+
+		/**
+		 * @brief Keep only the selected components' moments, in the
+		 * given order. Mirrors ComponentStore::select.
+		 */
+		void select(const std::vector<unsigned>& indices);
+
+		/**
+		 * @brief Determine component i's moments, unless they are already known.
+		 *
+		 * @return False if the component's precision matrix is not positive
+		 * definite, the component then has no moments.
+		 */
+		bool update(const ComponentStore& components, const unsigned i);
+
+		/**
+		 * @brief Component i's logarithmic mass, infinite if it has no moments.
+		 */
+		double logMass(const ComponentStore& components, const unsigned i);
+
+		/**
+		 * @brief Follow combineComponentsInplace without refactoring.
+		 *
+		 * In square root form the Cholesky factors of the first M
+		 * components are carried over to the M*N combined components:
+		 * each of rhs' precisions is split into outer products, see
+		 * semidefiniteFactor, and applied as rank one updates (products)
+		 * or downdates (quotients). The covariances of products follow
+		 * through the Sherman-Morrison formula, so nothing is factored
+		 * or inverted afresh. Components whose downdate fails are left
+		 * to be refactored on their next update.
+		 *
+		 * Otherwise, or if the scope has changed, everything is invalidated.
+		 *
+		 * @param components The combined store, after combineComponentsInplace.
+		 *
+		 * @param M The number of components before they were combined.
+		 */
+		void combine(const ComponentStore& components, const unsigned M, const ComponentStore& rhs,
+				const std::vector<unsigned>& rhsMap, const double sign);
+
+		/**
+		 * @brief Switch the square root form on or off.
+		 *
+		 * In square root form the Cholesky factors are kept up to date
+		 * through combine and nearly singular precisions are factored
+		 * with choleskyDecomposeRegularised.
+		 */
+		void setSquareRoot(const bool squareRoot) { squareRoot_ = squareRoot; }
+
+		/**
+		 * @brief Are the moments kept in square root form?
+		 */
+		bool isSquareRoot() const { return squareRoot_; }
+
+	public:
+		/**
+		 * @brief Pointer to component i's mean. Only valid after
+		 * a successful update and until the next update.
+		 */
+		const double* mean(const unsigned i) const { return mean_.data() + i*dim_; }
+
+		/**
+		 * @brief Pointer to component i's row major covariance.
+		 */
+		const double* cov(const unsigned i) const { return cov_.data() + i*dim_*dim_; }
+
+		/**
+		 * @brief Pointer to the lower triangular Cholesky factor of
+		 * component i's precision matrix.
+		 */
+		const double* chol(const unsigned i) const { return chol_.data() + i*dim_*dim_; }
+
+		/**
+		 * @brief Log-determinant of component i's precision matrix.
+		 */
+		double logDet(const unsigned i) const { return logDet_[i]; }
+
+	private:
+		enum State : char { kUnknown = 0, kValid, kSingular };
+
+		/**
+		 * @brief Make room for N components, new ones are unknown.
+		 */
+		void grow(const unsigned N);
+
+	// Data Members
+	private:
+		unsigned dim_;
+		bool squareRoot_;
+		std::vector<char> state_;
+
+		std::vector<double> mean_;
+		std::vector<double> cov_;
+		std::vector<double> chol_;
+		std::vector<double> logDet_;
+
+}; // ComponentMoments
+
+//------------------ Dense kernels
+//
+// All matrices are row major. The kernels never allocate, any scratch
+// space is passed in by the caller. Dimensions 2, 6 and 8 are handed
+// to FixedGaussian, see fixed_gaussian.hpp.
+
+/**
+ * @brief Cholesky decomposition.
+ *
+ * Determines the lower triangular L such that A = LL'.
+ *
+ * @param A A d*d symmetric matrix.
+ *
+ * @param L The d*d lower triangular factor, may not alias A.
+ *
+ * @return False if A is not positive definite.
+ */
+bool choleskyDecompose(const double* A, double* L, const unsigned d);
+
+/**
+ * @brief Solve LL'x = b given a Cholesky factor. x may alias b.
+ */
+void choleskySolve(const double* L, const double* b, double* x, const unsigned d);
+
+/**
+ * @brief Determine the inverse LL' given its Cholesky factor.
+ */
+void choleskyInverse(const double* L, double* inverse, const unsigned d);
+
+/**
+ * @brief Log-determinant of LL' given its Cholesky factor.
+ */
+double choleskyLogDet(const double* L, const unsigned d);
+
+/**
+ * @brief Solve Lx = b given a Cholesky factor, forward substitution
+ * only. x may alias b.
+ */
+void choleskyForward(const double* L, const double* b, double* x, const unsigned d);
+
+/**
+ * @brief Cholesky decomposition that tolerates loss of precision.
+ *
+ * As choleskyDecompose, but a pivot that cancellation has left below
+ * tolerance times its diagonal entry is raised to that level instead
+ * of failing the decomposition. The factor is then that of A plus a
+ * small diagonal correction.
+ *
+ * @param tolerance The relative pivot floor, e.g. 1e-10.
+ *
+ * @return False if a diagonal entry of A is not positive, or if a pivot
+ * is negative by more than the tolerance, i.e. A is clearly indefinite.
+ */
+bool choleskyDecomposeRegularised(const double* A, double* L, const unsigned d, const double tolerance);
+
+/**
+ * @brief Rank one update or downdate of a Cholesky factor.
+ *
+ * Replaces L with the factor of LL' + sign*xx' in O(d^2) operations.
+ *
+ * @param x The d dimensional update vector, it is overwritten.
+ *
+ * @param sign 1 for an update, -1 for a downdate.
+ *
+ * @return False if a downdate would leave the matrix indefinite, L
+ * is then no longer meaningful.
+ */
+bool choleskyRankOne(double* L, double* x, const unsigned d, const double sign);
+
+/**
+ * @brief Write a positive semidefinite matrix as a sum of outer products.
+ *
+ * Diagonally pivoted Cholesky decomposition, A = sum_k v_k v_k' where v_k
+ * is the k-th row of V. It stops once the remaining pivots are negligible,
+ * so singular matrices are handled.
+ *
+ * @param V Space for d*d doubles.
+ *
+ * @param work Scratch space of at least d*d doubles.
+ *
+ * @return The number of outer products, the numerical rank of A.
+ */
+unsigned semidefiniteFactor(const double* A, double* V, const unsigned d, double* work);
+
+/**
+ * @brief Logarithmic mass of a canonical Gaussian.
+ *
+ * Integrates exp(-0.5x'Kx + h'x + g). If K is not positive definite
+ * the integral diverges and infinity is returned.
+ *
+ * @param work Scratch space of at least d*(d + 1) doubles.
+ */
+double canonicalLogMass(const double* K, const double* h, const double g, const unsigned d, double* work);
+
+/**
+ * @brief Moments of a canonical Gaussian.
+ *
+ * @param mean The d dimensional mean.
+ *
+ * @param cov The d*d covariance, ignored if null.
+ *
+ * @param work Scratch space of at least d*d doubles.
+ *
+ * @return False if K is not positive definite.
+ */
+bool canonicalMoments(const double* K, const double* h, const unsigned d,
+		double* mean, double* cov, double* work);
+
+/**
+ * @brief Convert a weighted Gaussian from covariance form to canonical form.
+ *
+ * @param logMass The logarithmic mass of the result.
+ *
+ * @param work Scratch space of at least d*d doubles.
+ *
+ * @return False if the covariance is not positive definite.
+ */
+bool momentsToCanonical(const double* mean, const double* cov, const double logMass, const unsigned d,
+		double* K, double* h, double& g, double* work);
+
+//------------------ Store operations
+
+/**
+ * @brief Pairwise product or quotient of two sets of components.
+ *
+ * Every component of lhs is combined with every component of rhs and
+ * the results are appended to result, lhs major. The scopes of both
+ * stores are embedded in the result's scope through the given maps.
+ *
+ * @param lhsMap lhsMap[i] is the position of lhs' i-th variable in the result.
+ *
+ * @param rhsMap rhsMap[i] is the position of rhs' i-th variable in the result.
+ *
+ * @param sign 1 for multiplication, -1 for division.
+ *
+ * @param result The store receiving the combined components, its dimension
+ * must already be set.
+ */
+void combineComponents(const ComponentStore& lhs, const std::vector<unsigned>& lhsMap,
+		const ComponentStore& rhs, const std::vector<unsigned>& rhsMap,
+		const double sign, ComponentStore& result);
+
+/**
+ * @brief Pairwise product or quotient of two sets of components, in place.
+ *
+ * Identical to combineComponents, except that the result replaces the
+ * components of lhs. The existing capacity is reused.
+ *
+ * @param components The lhs components, they must already span the
+ * result's scope, see embedComponents.
+ *
+ * @param rhs The rhs components, may not be the same store.
+ *
+ * @param rhsMap rhsMap[i] is the position of rhs' i-th variable in the result.
+ *
+ * @param sign 1 for multiplication, -1 for division.
+ */
+void combineComponentsInplace(ComponentStore& components, const ComponentStore& rhs,
+		const std::vector<unsigned>& rhsMap, const double sign);
+
+/**
+ * @brief Embed every component in a larger scope, in place.
+ *
+ * The new variables have zero precision and information.
+ *
+ * @param dimension The dimension of the larger scope.
+ *
+ * @param map map[i] is the position of the i-th variable in the larger
+ * scope, it must be increasing.
+ */
+void embedComponents(ComponentStore& components, const unsigned dimension, const std::vector<unsigned>& map);
+
+/**
+ * @brief Marginalize each component.
+ *
+ * @param keep Indices of the variables to keep, in the order of the result.
+ *
+ * @param discard Indices of the variables to integrate out.
+ *
+ * @param result The store receiving the marginals.
+ */
+void marginalizeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& discard, ComponentStore& result);
+
+/**
+ * @brief Introduce evidence into each component.
+ *
+ * @param keep Indices of the unobserved variables, in the order of the result.
+ *
+ * @param observed Indices of the observed variables.
+ *
+ * @param values The observed values, in the same order as observed.
+ *
+ * @param result The store receiving the reduced components.
+ */
+void observeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& observed, const std::vector<double>& values,
+		ComponentStore& result);
+
+/**
+ * @brief Introduce several sets of evidence into each component.
+ *
+ * Equivalent to calling observeComponents once per set of values, but
+ * the retained and cross blocks of each component are gathered once and
+ * only the information vectors and normalisation constants are
+ * determined for every set of values.
+ *
+ * @param values values[t] is the t-th set of observed values, in the
+ * same order as observed.
+ *
+ * @param results results[t] receives the components reduced by values[t],
+ * their dimensions must already be set.
+ */
+void observeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& observed, const std::vector<std::vector<double>>& values,
+		std::vector<ComponentStore>& results);
+
+/**
+ * @brief Reorder the variables of every component.
+ *
+ * @param order The new i-th variable is the old order[i]-th variable.
+ */
+void permuteComponents(ComponentStore& components, const std::vector<unsigned>& order);
+
+#endif // COMPONENTSTORE_HPP
@@ -17,6 +17,8 @@
 #include "discretetable.hpp"
 #include "gausscanonical.hpp"
 #include "canonical_gaussian_mixture.hpp"
+#include "operator_policy.hpp"
+#include "step_arena.hpp"
 #include "v2vtransform.hpp"
 
 // Forward declaration.
@@ -89,6 +91,14 @@ class MarginalizeCG : public Operator1<ConditionalGaussian> {
 		Factor* process(const ConditionalGaussian* lhsPtr,
 				const emdw::RVIds& variablesToKeep,
 				bool presorted = false);
+
+		/**
+		 * @brief Append each conditional's marginal to the mixture,
+		 * weighted by the discrete prior.
+		 */
+		static void appendMarginals(const Factor& discretePrior,
+				const std::map<unsigned, rcptr<Factor>>& marginals,
+				CanonicalGaussianMixture* mixture);
 }; // MarginalizeCG
 
 /**
@@ -130,7 +140,8 @@ class InplaceWeakDampingCG : public Operator1<ConditionalGaussian> {
  *
  * Not all required Factor methods are properly implemented, those
  * which aren't are noted in the documentation. inplaceWeakDamping,
- * txtRead and txtWrite are not implemented.
+ * txtRead and txtWrite are not implemented, binRead and binWrite
+ * are the supported encoding.
  *
  * To play it safe, there is a ridiculous amount of
  * copying of the conditional Factors it is probably
@@ -207,7 +218,13 @@ class ConditionalGaussian : public Factor {
 				const rcptr<FactorOperator>& inplaceDamper = 0
 				);
 
-		ConditionalGaussian(const ConditionalGaussian& st) = default;
+		/**
+		 * @brief Copy constructor.
+		 *
+		 * The discrete prior and every conditional are deep copied, so the
+		 * inplace operators never touch another ConditionalGaussian's factors.
+		 */
+		ConditionalGaussian(const ConditionalGaussian& st);
 		
 		ConditionalGaussian(ConditionalGaussian&& st) = default;
 
@@ -217,7 +234,7 @@ class ConditionalGaussian : public Factor {
 		virtual ~ConditionalGaussian();
 
 	public:
-		ConditionalGaussian& operator=(const ConditionalGaussian& d) = default;
+		ConditionalGaussian& operator=(const ConditionalGaussian& d);
 
 		ConditionalGaussian& operator=(ConditionalGaussian&& d) = default;
 
@@ -229,8 +246,8 @@ class ConditionalGaussian : public Factor {
 		 * @brief Class specific configuration
 		 *
 		 * Reconfigures the exsiting clas, replacing old members with new 
-		 * ones. It may seem pointless, but it greatly simplifies the 
-		 * inplaceProcesses.
+		 * ones. The inplace operators no longer use this, they change
+		 * the existing components directly.
 		 *
 		 * @param discreteRV A pointer to a distribution held over a
 		 * single discrete random variable, it must be a DiscreteTable. 
@@ -354,6 +371,27 @@ class ConditionalGaussian : public Factor {
 		inline uniqptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
 				bool presorted = false, FactorOperator* procPtr = 0) const;
 
+		/**
+		 * @brief Marginalization onto continuous variables, made in
+		 * the given arena.
+		 *
+		 * The mixture left once the discrete variable is marginalized
+		 * out is made in the arena, as for an outgoing message which
+		 * is absorbed in the same time step. Falls back to marginalize
+		 * if the discrete variable is kept or the marginalizer is not
+		 * the default one.
+		 *
+		 * @param variablesToKeep The variables which will not be marginalized out.
+		 *
+		 * @param arena The arena of the current time step.
+		 *
+		 * @param presorted Is variablesToKeep sorted already?
+		 *
+		 * @return The scoped reduced Factor.
+		 */
+		rcptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
+				StepArena& arena, bool presorted = false) const;
+
 		/**
 		 * @brief Observe and Reduce
 		 *
@@ -454,6 +492,29 @@ class ConditionalGaussian : public Factor {
 		 */
 		virtual std::ostream& txtWrite(std::ostream& file) const;
 
+		/**
+		 * @brief Write the conditional Gaussian in binary.
+		 *
+		 * Writes the discrete variable, then each domain value's prior
+		 * probability and conditional Factor, see binary_io.hpp. The
+		 * conditional Factors must be GaussCanonical or CanonicalGaussianMixture.
+		 * The operators are not written.
+		 */
+		std::ostream& binWrite(std::ostream& file) const;
+
+		/**
+		 * @brief Replace the conditional Gaussian with one read in binary,
+		 * keeping the current operators.
+		 */
+		std::istream& binRead(std::istream& file);
+
+	private:
+		/**
+		 * @brief Redetermine the scope from the discrete prior and the
+		 * conditionals, after they have been changed in place.
+		 */
+		void updateScope();
+
 	// Data Members
 	private:
 		// Scope and components
@@ -464,16 +525,8 @@ class ConditionalGaussian : public Factor {
 		rcptr<Factor> discreteRV_;
 		mutable std::map<unsigned, rcptr<Factor>> conditionalList_;
 
-		// Operators
-		rcptr<FactorOperator> inplaceNormalizer_;
-		rcptr<FactorOperator> normalizer_;
-		rcptr<FactorOperator> inplaceAbsorber_;
-		rcptr<FactorOperator> absorber_;
-		rcptr<FactorOperator> inplaceCanceller_;
-		rcptr<FactorOperator> canceller_;
-		rcptr<FactorOperator> marginalizer_;
-		rcptr<FactorOperator> observeAndReducer_;
-		rcptr<FactorOperator> inplaceDamper_;
+		// Operators, shared with every factor using the same operators
+		rcptr<const OperatorPolicy> ops_;
 
 }; // ConditionalGaussian
 
@@ -0,0 +1,142 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the fixed dimension Gaussian kernels. See the notes
+ * above the class declaration.
+ *************************************************************************/
+#ifndef FIXEDGAUSSIAN_HPP
+#define FIXEDGAUSSIAN_HPP
+
+#include <math.h>
+#include <limits>
+
+/**
+ * @brief Dense Gaussian kernels for a dimension known at compile time.
+ *
+ * The tracker only ever works with the 2 dimensional measurement space,
+ * the 6 dimensional state space and their 8 dimensional joints. For
+ * these the loop bounds are constants, so the compiler can unroll the
+ * loops and all scratch space lives on the stack.
+ *
+ * The arithmetic is exactly that of the run time sized kernels in
+ * component_store.hpp, which dispatch to these for D = 2, 6 and 8.
+ * All matrices are row major.
+ *
+ * @author SCJ Robertson
+ * @since 03/06/17
+ */
+template<unsigned D>
+class FixedGaussian {
+
+	public:
+		/**
+		 * @brief Cholesky decomposition, see choleskyDecompose.
+		 */
+		static bool choleskyDecompose(const double* A, double* L) {
+			for (unsigned j = 0; j < D; j++) {
+				double s = A[j*D + j];
+				for (unsigned k = 0; k < j; k++) s -= L[j*D + k]*L[j*D + k];
+				if (!(s > 0)) return false;
+
+				double Ljj = sqrt(s);
+				L[j*D + j] = Ljj;
+				for (unsigned i = j + 1; i < D; i++) {
+					double t = A[i*D + j];
+					for (unsigned k = 0; k < j; k++) t -= L[i*D + k]*L[j*D + k];
+					L[i*D + j] = t/Ljj;
+					L[j*D + i] = 0.0;
+				} // for
+			} // for
+			return true;
+		} // choleskyDecompose()
+
+		/**
+		 * @brief Solve LL'x = b, see choleskySolve.
+		 */
+		static void choleskySolve(const double* L, const double* b, double* x) {
+			for (unsigned i = 0; i < D; i++) {
+				double s = b[i];
+				for (unsigned k = 0; k < i; k++) s -= L[i*D + k]*x[k];
+				x[i] = s/L[i*D + i];
+			} // for
+
+			for (unsigned i = D; i-- > 0; ) {
+				double s = x[i];
+				for (unsigned k = i + 1; k < D; k++) s -= L[k*D + i]*x[k];
+				x[i] = s/L[i*D + i];
+			} // for
+		} // choleskySolve()
+
+		/**
+		 * @brief Inverse of LL', see choleskyInverse.
+		 */
+		static void choleskyInverse(const double* L, double* inverse) {
+			for (unsigned j = 0; j < D; j++) {
+				double* col = inverse + j*D;
+				for (unsigned i = 0; i < D; i++) col[i] = (i == j) ? 1.0 : 0.0;
+				choleskySolve(L, col, col);
+			} // for
+		} // choleskyInverse()
+
+		/**
+		 * @brief Log-determinant of LL', see choleskyLogDet.
+		 */
+		static double choleskyLogDet(const double* L) {
+			double logDet = 0;
+			for (unsigned i = 0; i < D; i++) logDet += log(L[i*D + i]);
+			return 2*logDet;
+		} // choleskyLogDet()
+
+		/**
+		 * @brief Logarithmic mass of a canonical Gaussian, see canonicalLogMass.
+		 */
+		static double canonicalLogMass(const double* K, const double* h, const double g) {
+			double L[D*D], x[D];
+			if (!choleskyDecompose(K, L)) return std::numeric_limits<double>::infinity();
+
+			choleskySolve(L, h, x);
+			double quad = 0;
+			for (unsigned i = 0; i < D; i++) quad += h[i]*x[i];
+
+			return g + 0.5*( D*log(2*M_PI) - choleskyLogDet(L) + quad );
+		} // canonicalLogMass()
+
+		/**
+		 * @brief Moments of a canonical Gaussian, see canonicalMoments.
+		 */
+		static bool canonicalMoments(const double* K, const double* h, double* mean, double* cov) {
+			double L[D*D];
+			if (!choleskyDecompose(K, L)) return false;
+
+			choleskySolve(L, h, mean);
+			if (cov) choleskyInverse(L, cov);
+
+			return true;
+		} // canonicalMoments()
+
+		/**
+		 * @brief Covariance to canonical form, see momentsToCanonical.
+		 */
+		static bool momentsToCanonical(const double* mean, const double* cov, const double logMass,
+				double* K, double* h, double& g) {
+			double L[D*D];
+			if (!choleskyDecompose(cov, L)) return false;
+
+			choleskyInverse(L, K);
+			double quad = 0;
+			for (unsigned i = 0; i < D; i++) {
+				double s = 0;
+				for (unsigned j = 0; j < D; j++) s += K[i*D + j]*mean[j];
+				h[i] = s;
+				quad += mean[i]*s;
+			} // for
+			g = logMass - 0.5*( D*log(2*M_PI) + choleskyLogDet(L) + quad );
+
+			return true;
+		} // momentsToCanonical()
+
+}; // FixedGaussian
+
+#endif // FIXEDGAUSSIAN_HPP
@@ -0,0 +1,86 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the batched validation gate. See the notes above the
+ * class declaration.
+ *************************************************************************/
+#ifndef MEASUREMENTGATE_HPP
+#define MEASUREMENTGATE_HPP
+
+#include <vector>
+#include "genvec.hpp"
+#include "emdw.hpp"
+#include "factor.hpp"
+
+/**
+ * @brief Gates every measurement of a sensor against every target.
+ *
+ * Each target's predicted measurement distribution is factored once when
+ * it is added: its mean is solved for and the Cholesky factor L of its
+ * precision K = LL' is kept, so the squared Mahalanobis distance of a
+ * measurement x is |L'(x - mu)|^2. The means and factors of all targets are
+ * stored component by component, so the distances of one measurement to
+ * every target are evaluated in a single loop over the targets.
+ *
+ * @author SCJ Robertson
+ * @since 08/06/17
+ */
+class MeasurementGate {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param dimension The dimension of the measurement space.
+		 */
+		MeasurementGate(const unsigned dimension);
+
+	public:
+		/**
+		 * @brief Add a target's predicted measurement distribution.
+		 *
+		 * @param target The target's index, as it appears in the
+		 * association hypotheses.
+		 *
+		 * @param predicted A GaussCanonical over the measurement space.
+		 *
+		 * @return False if the distribution's precision is not positive
+		 * definite, the target is then never gated in.
+		 */
+		bool addTarget(const unsigned target, const Factor* predicted);
+
+		/**
+		 * @brief Determine which targets could have caused each measurement.
+		 *
+		 * @param measurements The sensor's measurements, empty measurements
+		 * are skipped.
+		 *
+		 * @param threshold A target is a candidate if the squared Mahalanobis
+		 * distance is strictly less than the threshold.
+		 *
+		 * @param hypotheses One association domain per measurement, each
+		 * candidate target is appended in the order the targets were added.
+		 * Null domains are skipped.
+		 */
+		void gate(const std::vector<ColVector<double>>& measurements, const double threshold,
+				std::vector<rcptr<std::vector<unsigned short>>>& hypotheses) const;
+
+		/**
+		 * @brief The number of gated targets.
+		 */
+		unsigned size() const { return targets_.size(); }
+
+	// Data Members
+	private:
+		unsigned dim_;
+		std::vector<unsigned> targets_;
+
+		// Component r of every target's mean, and entry (r, c) of every L
+		std::vector<std::vector<double>> means_;
+		std::vector<std::vector<double>> factors_;
+
+}; // MeasurementGate
+
+#endif // MEASUREMENTGATE_HPP
@@ -13,6 +13,7 @@
 #include "factoroperator.hpp"
 #include "emdw.hpp"
 #include "anytype.hpp"
+#include "step_arena.hpp"
 
 // Forward Declaration
 class Node;
@@ -227,6 +228,23 @@ class Node {
 		uniqptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
 				bool presorted = false, FactorOperator* procPtr = 0) const;
 
+		/**
+		 * @brief Marginalization, made in the given arena.
+		 *
+		 * Conditional Gaussians leave their marginal in the arena,
+		 * any other factor is marginalized as usual.
+		 *
+		 * @param variablesToKeep The variables which will not be marginalized out.
+		 *
+		 * @param arena The arena of the current time step.
+		 *
+		 * @param presorted Is variablesToKeep sorted already?
+		 *
+		 * @return The scoped reduced Factor.
+		 */
+		rcptr<Factor> marginalize(const emdw::RVIds& variablesToKeep, 
+				StepArena& arena, bool presorted = false) const;
+
 		/**
 		 * @brief Inplace Observe and Reduce
 		 *
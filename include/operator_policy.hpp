@@ -0,0 +1,90 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the operators shared by factors of the same type. See
+ * the notes above the class declaration.
+ *************************************************************************/
+#ifndef OPERATORPOLICY_HPP
+#define OPERATORPOLICY_HPP
+
+#include "emdw.hpp"
+#include "factoroperator.hpp"
+
+/**
+ * @brief The set of operators used by a factor.
+ *
+ * A factor used to hold each of its operators separately, so every copy,
+ * marginal and observed factor copied nine or ten shared pointers. Instead
+ * each factor holds a single pointer to an immutable policy, which is
+ * shared by every factor using the same operators. Factors constructed
+ * with the default operators all share their type's default policy.
+ *
+ * A policy is never modified, to change an operator a new policy is
+ * derived from an existing one.
+ *
+ * @author SCJ Robertson
+ * @since 06/06/17
+ */
+class OperatorPolicy {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param inplaceReducer The inplace reduction operator,
+		 * may be null if the factor type has none.
+		 */
+		OperatorPolicy(
+				const rcptr<FactorOperator>& inplaceNormalizer,
+				const rcptr<FactorOperator>& normalizer,
+				const rcptr<FactorOperator>& inplaceAbsorber,
+				const rcptr<FactorOperator>& absorber,
+				const rcptr<FactorOperator>& inplaceCanceller,
+				const rcptr<FactorOperator>& canceller,
+				const rcptr<FactorOperator>& marginalizer,
+				const rcptr<FactorOperator>& observeAndReducer,
+				const rcptr<FactorOperator>& inplaceDamper,
+				const rcptr<FactorOperator>& inplaceReducer = 0);
+
+	public:
+		/**
+		 * @brief Derive a policy from an existing one.
+		 *
+		 * Every null operator is taken from base. If every operator
+		 * is null, base itself is returned and nothing is allocated.
+		 *
+		 * @param base The policy from which operators are taken.
+		 *
+		 * @return A policy containing the given operators.
+		 */
+		static rcptr<const OperatorPolicy> derive(
+				const rcptr<const OperatorPolicy>& base,
+				const rcptr<FactorOperator>& inplaceNormalizer,
+				const rcptr<FactorOperator>& normalizer,
+				const rcptr<FactorOperator>& inplaceAbsorber,
+				const rcptr<FactorOperator>& absorber,
+				const rcptr<FactorOperator>& inplaceCanceller,
+				const rcptr<FactorOperator>& canceller,
+				const rcptr<FactorOperator>& marginalizer,
+				const rcptr<FactorOperator>& observeAndReducer,
+				const rcptr<FactorOperator>& inplaceDamper,
+				const rcptr<FactorOperator>& inplaceReducer = 0);
+
+	// Data Members
+	public:
+		const rcptr<FactorOperator> inplaceNormalizer;
+		const rcptr<FactorOperator> normalizer;
+		const rcptr<FactorOperator> inplaceAbsorber;
+		const rcptr<FactorOperator> absorber;
+		const rcptr<FactorOperator> inplaceCanceller;
+		const rcptr<FactorOperator> canceller;
+		const rcptr<FactorOperator> marginalizer;
+		const rcptr<FactorOperator> observeAndReducer;
+		const rcptr<FactorOperator> inplaceDamper;
+		const rcptr<FactorOperator> inplaceReducer;
+
+}; // OperatorPolicy
+
+#endif // OPERATORPOLICY_HPP
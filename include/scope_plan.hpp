@@ -0,0 +1,130 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the cached scope plans. See the notes above the class
+ * declaration.
+ *************************************************************************/
+#ifndef SCOPEPLAN_HPP
+#define SCOPEPLAN_HPP
+
+#include <map>
+#include <vector>
+#include "emdw.hpp"
+
+/**
+ * @brief The index bookkeeping of a marginalization or an observation.
+ *
+ * Splitting a scope into the selected variables and the rest used to
+ * search the selection for every variable of the scope, for every
+ * mixture and every time step. The variables' identities change with
+ * every target and time step, but the tracker only ever uses a handful
+ * of distinct layouts, e.g. the state within a state and measurement
+ * joint. A plan holds the index bookkeeping of one layout and plans are
+ * cached on it: the scope's size and the position in the scope of each
+ * selected variable. The split's variables are read from the caller's
+ * scope, see selectedVars.
+ *
+ * The selection's order is part of the key. Plans are never modified
+ * once created.
+ *
+ * @author SCJ Robertson
+ * @since 09/06/17
+ */
+class ScopePlan {
+
+	public:
+		/**
+		 * @brief The layout of a split, the scope's size followed by
+		 * the position in the scope of each selected variable, -1 for
+		 * variables outside the scope.
+		 */
+		typedef std::vector<int> Layout;
+
+		/**
+		 * @brief Default constructor, splits a scope with the given
+		 * layout.
+		 *
+		 * @param layout The split's layout, see layout.
+		 */
+		ScopePlan(const Layout& layout);
+
+		/**
+		 * @brief Determine the layout of a split.
+		 *
+		 * @param scope The factor's scope.
+		 *
+		 * @param selection The variables to marginalize onto or to observe,
+		 * variables outside the scope are ignored.
+		 */
+		static Layout layout(const emdw::RVIds& scope, const emdw::RVIds& selection);
+
+	public:
+		/**
+		 * @brief Look up the plan of a split, creating it if necessary.
+		 *
+		 * Plans are shared by every split with the same layout. The
+		 * cache is cleared once it holds kMaxPlans plans, the plans
+		 * already handed out remain valid.
+		 */
+		static rcptr<const ScopePlan> get(const emdw::RVIds& scope, const emdw::RVIds& selection);
+
+		/**
+		 * @brief Empty the cache.
+		 */
+		static void clear();
+
+		/**
+		 * @brief The number of cached plans.
+		 */
+		static unsigned size();
+
+	public:
+		/**
+		 * @brief Positions in the scope of the selected variables, in
+		 * scope order.
+		 */
+		const std::vector<unsigned>& selected() const { return selected_; }
+
+		/**
+		 * @brief Positions in the scope of the remaining variables, in
+		 * scope order.
+		 */
+		const std::vector<unsigned>& remaining() const { return remaining_; }
+
+		/**
+		 * @brief The selected variables, in scope order.
+		 *
+		 * @param scope The scope the plan was looked up with.
+		 */
+		emdw::RVIds selectedVars(const emdw::RVIds& scope) const;
+
+		/**
+		 * @brief The remaining variables, in scope order.
+		 *
+		 * @param scope The scope the plan was looked up with.
+		 */
+		emdw::RVIds remainingVars(const emdw::RVIds& scope) const;
+
+		/**
+		 * @brief source()[k] is the position in the selection of
+		 * the k-th selected variable, e.g. to find its observed value.
+		 */
+		const std::vector<unsigned>& source() const { return source_; }
+
+	public:
+		static const unsigned kMaxPlans = 256;
+
+	// Data Members
+	private:
+		std::vector<unsigned> selected_;
+		std::vector<unsigned> remaining_;
+		std::vector<unsigned> source_;
+
+		typedef std::map<Layout, rcptr<const ScopePlan>> Cache;
+		static Cache cache_;
+
+}; // ScopePlan
+
+#endif // SCOPEPLAN_HPP
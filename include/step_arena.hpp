@@ -0,0 +1,181 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the per time step arena. See the notes above the
+ * class declarations.
+ *************************************************************************/
+#ifndef STEPARENA_HPP
+#define STEPARENA_HPP
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include "emdw.hpp"
+#include "factor.hpp"
+
+/**
+ * @brief A set of memory blocks handed out by bumping an offset.
+ *
+ * Memory is never returned individually, the blocks are rewound as a
+ * whole and reused. Allocations larger than the block size get a block
+ * of their own.
+ *
+ * @author SCJ Robertson
+ * @since 07/06/17
+ */
+class ArenaBlocks {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param blockSize The size of each block in bytes.
+		 */
+		explicit ArenaBlocks(const size_t blockSize);
+
+		/**
+		 * @brief Default destructor, frees every block.
+		 */
+		~ArenaBlocks();
+
+		ArenaBlocks(const ArenaBlocks&) = delete;
+		ArenaBlocks& operator=(const ArenaBlocks&) = delete;
+
+	public:
+		/**
+		 * @brief Allocate aligned memory from the blocks.
+		 */
+		void* allocate(const size_t bytes, const size_t alignment);
+
+		/**
+		 * @brief Make every block available again, everything
+		 * allocated from them must already be destroyed.
+		 */
+		void rewind();
+
+		/**
+		 * @brief The total size of the blocks in bytes.
+		 */
+		size_t capacity() const;
+
+	// Data Members
+	private:
+		size_t blockSize_;
+		std::vector<char*> blocks_;
+		std::vector<size_t> sizes_;
+		size_t block_;
+		size_t offset_;
+
+}; // ArenaBlocks
+
+/**
+ * @brief A standard allocator drawing from ArenaBlocks.
+ *
+ * Deallocation does nothing. Each allocator shares ownership of its blocks,
+ * and std::allocate_shared keeps a copy of the allocator in the control
+ * block, so the blocks outlive every object allocated from them.
+ */
+template <class T>
+class ArenaAllocator {
+
+	public:
+		typedef T value_type;
+
+		explicit ArenaAllocator(const rcptr<ArenaBlocks>& blocks) : blocks_(blocks) {}
+
+		template <class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : blocks_(other.blocks_) {}
+
+		T* allocate(const size_t n) {
+			return static_cast<T*>(blocks_->allocate(n*sizeof(T), alignof(T)));
+		} // allocate()
+
+		void deallocate(T*, const size_t) {}
+
+		template <class U>
+		bool operator==(const ArenaAllocator<U>& other) const { return blocks_ == other.blocks_; }
+
+		template <class U>
+		bool operator!=(const ArenaAllocator<U>& other) const { return blocks_ != other.blocks_; }
+
+	private:
+		template <class U> friend class ArenaAllocator;
+		rcptr<ArenaBlocks> blocks_;
+
+}; // ArenaAllocator
+
+/**
+ * @brief Arena for the short lived objects of a single time step.
+ *
+ * The predicted marginals, predicted measurements and validation regions,
+ * the observed joints and the conditional lists they are reduced to, the
+ * conditional Gaussians and the outgoing measurement messages are all
+ * discarded before the next time step. These are allocated with make,
+ * which places the object and its reference count in the arena, and the
+ * arena is reset at the end of each time step.
+ *
+ * Nothing made in the arena may be shared with a longer lived object.
+ * Nodes copy the factors and messages they are given, and the association
+ * domains, which the DiscreteTable copies share, are kept on the heap.
+ * Long lived factors, the state node factors, should not be made in the
+ * arena, promote copies a factor into normal ownership.
+ *
+ * Objects still alive at a reset are not invalidated, their blocks are
+ * released once the last of them is destroyed and the arena continues in
+ * fresh blocks. Only the objects themselves are placed in the arena,
+ * their own buffers are allocated as usual. Not thread safe.
+ *
+ * @author SCJ Robertson
+ * @since 07/06/17
+ */
+class StepArena {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param blockSize The size of each block in bytes.
+		 */
+		explicit StepArena(const size_t blockSize = 1 << 16);
+
+	public:
+		/**
+		 * @brief Construct an object in the arena.
+		 */
+		template <class T, class... Args>
+		rcptr<T> make(Args&&... args) {
+			return std::allocate_shared<T>(ArenaAllocator<T>(blocks_), std::forward<Args>(args)...);
+		} // make()
+
+		/**
+		 * @brief Copy a factor into normal ownership, so it may outlive
+		 * the time step.
+		 */
+		static rcptr<Factor> promote(const rcptr<Factor>& factor);
+
+		/**
+		 * @brief End the time step.
+		 *
+		 * Rewinds the blocks if nothing allocated from them is still
+		 * alive, otherwise leaves them to the survivors.
+		 *
+		 * @return True if the blocks were rewound.
+		 */
+		bool reset();
+
+		/**
+		 * @brief The total size of the current blocks in bytes.
+		 */
+		size_t capacity() const { return blocks_->capacity(); }
+
+	// Data Members
+	private:
+		size_t blockSize_;
+		rcptr<ArenaBlocks> blocks_;
+
+}; // StepArena
+
+#endif // STEPARENA_HPP
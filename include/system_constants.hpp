@@ -19,6 +19,8 @@
 #include "graph_builder.hpp"
 #include "measurement_manager.hpp"
 #include "transforms.hpp"
+#include "transition_factor.hpp"
+#include "step_arena.hpp"
 
 // Function prototypes
 Matrix<double> initialiseRCovMat();
@@ -27,6 +29,8 @@ std::vector<ColVector<double>> initialiseClutterMean();
 std::vector<Matrix<double>> initialiseClutterCovMat();
 std::vector<ColVector<double>> initialiseSensorLocations();
 rcptr<V2VTransform> initialiseMotionModel();
+rcptr<const TransitionFactor> initialiseTransition();
+std::vector<bool> initialiseLinearisedSensors();
 std::vector<rcptr<V2VTransform>> initialiseMeasurementModels();
 std::vector<ColVector<double>> initialiseLaunchStateMean();
 std::vector<Matrix<double>> initialiseLaunchStateCov();
@@ -58,12 +62,14 @@ namespace mht {
 	// Motion model
 	extern rcptr<V2VTransform> kMotionModel;
 	extern Matrix<double> kRCovMat;
+	extern rcptr<const TransitionFactor> kTransition;
 
 	// Measurement model
 	extern const double kC; // Speed of light
 	extern const double kFc; // Carrier frequency
 	extern const double kTp; // Sweep period
 	extern const double kBw; // Bandwidth
+	extern std::vector<bool> kLinearisedSensors; // Sensors whose models are linearised, see SensorModel
 
 	extern std::vector<rcptr<V2VTransform>> kMeasurementModel;
 	extern std::vector<Matrix<double>> kQCovMat;
@@ -120,6 +126,9 @@ extern unsigned kNumberOfTimeSteps;
 // GraphBuilder
 extern rcptr<GraphBuilder> graphBuilder;
 
+// Short lived factors of the current time step
+extern StepArena stepArena;
+
 // Graph representation
 extern std::map<unsigned, std::vector<rcptr<Node>>> stateNodes;
 extern std::map<unsigned, std::vector<rcptr<Node>>> measurementNodes;
@@ -11,21 +11,143 @@
 #define TRANSFORMS_HPP
 
 /**
- * This class implements the non-linear motion model function 
- * used in predicting a target's state at the next time step 
- * within a UKF. 
+ * Interface for transformations that map a whole block of points at
+ * once. Pushing every sigma point of every mixture component through
+ * V2VTransform::operator() allocates a vector for each point, a batched
+ * transform writes straight into the caller's storage instead.
+ *
+ * @author SCJ Robertson
+ * @since 09/06/17
+ */
+class BatchTransform {
+	public:
+		virtual ~BatchTransform() {}
+
+		/**
+		 * @return The dimension of the transformation's input.
+		 */
+		virtual unsigned inputDimension() const = 0;
+
+		/**
+		 * @return The dimension of the transformation's output.
+		 */
+		virtual unsigned outputDimension() const = 0;
+
+		/**
+		 * Transforms a block of points.
+		 *
+		 * @param X The count input points, each inputDimension() consecutive doubles.
+		 * @param count The number of points.
+		 * @param Y Preallocated storage for the count output points, each
+		 * outputDimension() consecutive doubles.
+		 */
+		virtual void transform(const double* X, const unsigned count, double* Y) const = 0;
+}; // BatchTransform
+
+/**
+ * Interface for transformations with an analytic Jacobian. V2VTransform
+ * itself cannot be extended, so transforms opt in by also deriving from
+ * this. CanonicalGaussianMixture then linearises the transform about each
+ * component's mean, as an EKF does, instead of evaluating 2n + 1 sigma
+ * points.
+ *
+ * @author SCJ Robertson
+ * @since 10/06/17
+ */
+class DifferentiableTransform {
+	public:
+		virtual ~DifferentiableTransform() {}
+
+		/**
+		 * @return True if the linearisation should be used at all.
+		 */
+		virtual bool isLinearised() const = 0;
+
+		/**
+		 * Evaluates the transform and its Jacobian at a component's mean.
+		 *
+		 * @param mean The mean, inputDimension() doubles.
+		 * @param cov The row-major covariance about the mean, used to judge
+		 * whether the linearisation holds over the component's spread.
+		 * @param y The transformed mean, outputDimension() doubles.
+		 * @param J The row-major outputDimension() x inputDimension() Jacobian.
+		 * @return False if the linearisation is not trustworthy, the caller
+		 * should fall back to the Unscented Transform.
+		 */
+		virtual bool linearise(const double* mean, const double* cov, double* y, double* J) const = 0;
+}; // DifferentiableTransform
+
+/**
+ * An affine transformation y = Ax + b. Gaussians remain Gaussian
+ * under it, so the CanonicalGaussianMixture constructors form the
+ * joint over x and y in closed form instead of fitting it with the
+ * Unscented Transform.
+ *
+ * @author SCJ Robertson
+ * @since 09/06/17
+ */
+class AffineTransform : public V2VTransform, public BatchTransform {
+	public:
+		/**
+		 * Constructor for AffineTransform.
+		 *
+		 * @param A The outputDimension x inputDimension matrix.
+		 *
+		 * @param b The offset, it determines the output dimension.
+		 *
+		 * @param inputDimension The dimension of x.
+		 */
+		AffineTransform(const Matrix<double>& A, const ColVector<double>& b, const unsigned inputDimension);
+
+		/**
+		 * Implements y = Ax + b.
+		 *
+		 * @param x The vector to be transformed.
+		 * @return The transformed vector.
+		 */
+		std::vector< ColVector<double> > operator()(const ColVector<double>& x) const;
+
+		unsigned inputDimension() const { return n_; }
+		unsigned outputDimension() const { return m_; }
+
+		/**
+		 * Implements y = Ax + b for a block of vectors, see BatchTransform.
+		 */
+		void transform(const double* X, const unsigned count, double* Y) const;
+
+		/**
+		 * @return The matrix A.
+		 */
+		const Matrix<double>& getA() const { return A_; }
+
+		/**
+		 * @return The offset b.
+		 */
+		const ColVector<double>& getB() const { return b_; }
+
+	private:
+		Matrix<double> A_;
+		ColVector<double> b_;
+		unsigned n_;
+		unsigned m_;
+}; // AffineTransform
+
+/**
+ * This class implements the motion model function used in
+ * predicting a target's state at the next time step. The target
+ * moves ballistically, so the model is affine.
  *
  * @author SCJ Robertson
  * @since 11/10/16
  */
-class MotionModel : public V2VTransform{
+class MotionModel : public AffineTransform {
 	public:
 		/**
 		 * Constructor for MotionModel.
 		 *
 		 * @param timeStep The discrete time step over which the target is advanced.
 		 */
-		MotionModel(const double timeStep) : deltaT_(timeStep) {}
+		MotionModel(const double timeStep);
 
 		/**
 		 * Implements the motion model, \f$ \pmb{g} (\pmb{x}_{t-1}) \f$, in the prediction step
@@ -37,6 +159,21 @@ class MotionModel : public V2VTransform{
 		 * @return The predicted state vector \f$ \pmb{x}_{t} \f$.
 		 */
 		std::vector< ColVector<double> > operator()(const ColVector<double>& x) const;
+
+		/**
+		 * Implements the motion model for a block of state vectors, see BatchTransform.
+		 */
+		void transform(const double* X, const unsigned count, double* Y) const;
+
+		/**
+		 * @return The motion model's matrix A.
+		 */
+		static Matrix<double> transitionMatrix(const double timeStep);
+
+		/**
+		 * @return The motion model's offset b, due to gravity.
+		 */
+		static ColVector<double> gravityOffset(const double timeStep);
 	
 	private:
 		double deltaT_;
@@ -49,7 +186,7 @@ class MotionModel : public V2VTransform{
  * @author SCJ Robertson
  * @since 11/10/16
  */
-class SensorModel : public V2VTransform{
+class SensorModel : public V2VTransform, public BatchTransform, public DifferentiableTransform {
 	public:
 		/**
 		 * Default constructor.
@@ -63,11 +200,14 @@ class SensorModel : public V2VTransform{
 		 * @param tp The sweep period.
 		 *
 		 * @param bw The bandwidth.
+		 *
+		 * @param linearised Set to true to linearise the model with its
+		 * Jacobian where possible, see DifferentiableTransform.
 		 */
 		SensorModel(const ColVector<double>& sensorLocation, const double c, const double fc, 
-				const double tp, const double bw) 
+				const double tp, const double bw, const bool linearised = false) 
 				: c_(c), fc_(fc),
-				tp_(tp), bw_(bw) {
+				tp_(tp), bw_(bw), linearised_(linearised) {
 			ASSERT(sensorLocation.size() == 3, "The sensor location must be defined in 3D space.");
 			sensorPosition_ = sensorLocation;
 			vMax_ = (c/(4*fc*tp));
@@ -84,6 +224,28 @@ class SensorModel : public V2VTransform{
 		 */
 		std::vector< ColVector<double> > operator()(const ColVector<double>& x) const;
 
+		unsigned inputDimension() const { return 6; }
+		unsigned outputDimension() const { return 2; }
+
+		/**
+		 * Implements the sensor model for a block of state vectors, see BatchTransform.
+		 */
+		void transform(const double* X, const unsigned count, double* Y) const;
+
+		bool isLinearised() const { return linearised_; }
+		void setLinearised(const bool linearised) { linearised_ = linearised; }
+
+		/**
+		 * Linearises the sensor model, see DifferentiableTransform. Fails
+		 * if the Doppler is within kWrapMargin standard deviations of
+		 * the wrap at vMax_, or the target is on top of the sensor.
+		 */
+		bool linearise(const double* mean, const double* cov, double* y, double* J) const;
+
+	public:
+		// Standard deviations of Doppler kept clear of the wrap when linearising
+		static const double kWrapMargin;
+
 	private:
 		ColVector<double> sensorPosition_;
 		double c_;
@@ -91,6 +253,7 @@ class SensorModel : public V2VTransform{
 		double tp_;
 		double bw_;
 		double vMax_;
+		bool linearised_;
 }; // SensorModel
 
 #endif // TRANSFORMS_HPP
@@ -0,0 +1,142 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the precomputed transition factor. See the notes above
+ * the class declaration.
+ *************************************************************************/
+#ifndef TRANSITIONFACTOR_HPP
+#define TRANSITIONFACTOR_HPP
+
+#include <vector>
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "v2vtransform.hpp"
+#include "transforms.hpp"
+#include "component_store.hpp"
+
+/**
+ * @brief The canonical form of p(y | x) for y = Ax + b + e, e ~ N(0, Q).
+ *
+ * With W = Q^-1 the transition contributes
+ *
+ *   K = [A'WA, -A'W; -WA, W], h = [-A'Wb; Wb], g = -b'Wb/2 - log|2 pi Q|/2
+ *
+ * to the joint over (x, y), none of which depends on the prior over x.
+ * The motion model and its noise are fixed for a whole run, so these
+ * blocks are determined once and every predicted component is the prior
+ * component plus the transition, a few block additions.
+ *
+ * @author SCJ Robertson
+ * @since 10/06/17
+ */
+class TransitionFactor {
+
+	public:
+		/**
+		 * @brief Default constructor.
+		 *
+		 * @param transform The transform y = Ax + b.
+		 *
+		 * @param Q The noise covariance, must be positive definite.
+		 */
+		TransitionFactor(const AffineTransform& transform, const Matrix<double>& Q);
+
+		/**
+		 * @brief Packed constructor.
+		 *
+		 * @param A The row-major m x n matrix.
+		 *
+		 * @param b The offset of length m.
+		 *
+		 * @param Q The m x m noise covariance, must be positive definite.
+		 *
+		 * @param n The dimension of x.
+		 *
+		 * @param m The dimension of y.
+		 */
+		TransitionFactor(const double* A, const double* b, const Matrix<double>& Q,
+				const unsigned n, const unsigned m);
+
+		/**
+		 * @brief Noise only constructor, the transform is set with
+		 * linearise.
+		 *
+		 * @param Q The m x m noise covariance, must be positive definite.
+		 *
+		 * @param n The dimension of x.
+		 *
+		 * @param m The dimension of y.
+		 */
+		TransitionFactor(const Matrix<double>& Q, const unsigned n, const unsigned m);
+
+	public:
+		/**
+		 * @brief Form the joint over (x, y) of each component over x.
+		 *
+		 * @param prior Components over x.
+		 *
+		 * @param joint Replaced by the components over (x, y), x first.
+		 */
+		void predict(const ComponentStore& prior, ComponentStore& joint) const;
+
+		/**
+		 * @brief Form the joint over (x, y) of a single component.
+		 *
+		 * @param prior Components over x.
+		 *
+		 * @param i The component to predict.
+		 *
+		 * @param K, h, g The joint component, x first.
+		 */
+		void predict(const ComponentStore& prior, const unsigned i, double* K, double* h, double& g) const;
+
+		/**
+		 * @brief Replace the transform, keeping the factored noise.
+		 *
+		 * Used to relinearise a non-linear transform about each
+		 * component's mean, y ~ Jx + (f(mu) - J mu).
+		 *
+		 * @param A The row-major m x n matrix.
+		 *
+		 * @param b The offset of length m.
+		 */
+		void linearise(const double* A, const double* b);
+
+		/**
+		 * @return The dimension of x.
+		 */
+		unsigned inputDimension() const { return n_; }
+
+		/**
+		 * @return The dimension of y.
+		 */
+		unsigned outputDimension() const { return m_; }
+
+		/**
+		 * @return The row-major Cholesky factor of Q.
+		 */
+		const double* noiseFactor() const { return L_.data(); }
+
+	private:
+		/**
+		 * @brief Factor Q and invert it.
+		 */
+		void factorNoise(const Matrix<double>& Q);
+
+	// Data Members
+	private:
+		unsigned n_;
+		unsigned m_;
+		std::vector<double> L_;
+		std::vector<double> W_;
+		double logNormaliser_;
+		std::vector<double> K_;
+		std::vector<double> h_;
+		double g_;
+
+}; // TransitionFactor
+
+#endif // TRANSITIONFACTOR_HPP
@@ -0,0 +1,51 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Header file for the kernels operating on packed arrays of logarithmic
+ * component weights. See the notes above the function declarations.
+ *************************************************************************/
+#ifndef WEIGHTKERNELS_HPP
+#define WEIGHTKERNELS_HPP
+
+/**
+ * Every weight computation in the mixture code reduces to exponentiating
+ * an array of logarithmic weights, possibly after subtracting the total.
+ * These kernels do so four at a time when compiled with AVX2 and FMA
+ * (e.g. -march=native, see the NATIVE_ARCH CMake option), otherwise they
+ * fall back to scalar exp and log.
+ *
+ * The vector exponential agrees with std::exp to within a few ulps,
+ * except that results below the smallest normal double are flushed to
+ * zero. Arrays containing NaNs or arguments which overflow are handled
+ * by std::exp.
+ */
+
+/**
+ * @brief Log-sum-exp of an array of logarithmic weights.
+ *
+ * Infinite and NaN weights are ignored.
+ *
+ * @return The logarithm of the total weight, -inf if there are no
+ * finite weights.
+ */
+double logSumExp(const double* logWeights, const unsigned n);
+
+/**
+ * @brief Relative weights, weights[i] = exp(logWeights[i] - logTotal).
+ *
+ * With logTotal the result of logSumExp these are the normalised weights.
+ *
+ * @param weights The output array, may be logWeights.
+ */
+void relativeWeights(const double* logWeights, const unsigned n, const double logTotal, double* weights);
+
+/**
+ * @brief Linear weights, weights[i] = exp(logWeights[i]).
+ *
+ * @param weights The output array, may be logWeights.
+ */
+void expWeights(const double* logWeights, const unsigned n, double* weights);
+
+#endif // WEIGHTKERNELS_HPP
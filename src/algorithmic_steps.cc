@@ -52,9 +52,8 @@ void predictStatesSU(const unsigned N,
 			
 			// Create a new factor over current variables
 			stateJoint = uniqptr<Factor>(new CGM( prevMarginal, 
-						mht::kMotionModel, 
-						elementsOfX[currentStates[N][i]], 
-						mht::kRCovMat  ));
+						mht::kTransition, 
+						elementsOfX[currentStates[N][i]] ));
 			stateNodes[N][i] = uniqptr<Node> (new Node(stateJoint, stateNodes[N-1][i]->getIdentity() ) );
 
 			// Link Node to preceding node
@@ -64,7 +63,7 @@ void predictStatesSU(const unsigned N,
 
 		// Determine the marginal
 		predMarginals[i] = stateJoint->marginalize(elementsOfX[currentStates[N][i]]);
-		predMarginals[i] = std::dynamic_pointer_cast<CGM>(predMarginals[i])->momentMatchCGM();
+		predMarginals[i] = std::dynamic_pointer_cast<CGM>(predMarginals[i])->momentMatchCGM(stepArena);
 
 		// Assign new virtual measurement nodes
 		virtualMeasurementVars[i] = addVariables(variables, vecZ, elementsOfZ, mht::kMeasSpaceDim);
@@ -72,13 +71,13 @@ void predictStatesSU(const unsigned N,
 		// Create measurement distributions for each measurement space
 		predMeasurements[i].resize(mht::kNumSensors); validationRegion[i].resize(mht::kNumSensors);
 		for (unsigned j = 0; j < mht::kNumSensors; j++) {
-			predMeasurements[i][j] = uniqptr<Factor>(new CGM( predMarginals[i], 
+			predMeasurements[i][j] = stepArena.make<CGM>( predMarginals[i], 
 						mht::kMeasurementModel[j], 
 						elementsOfZ[virtualMeasurementVars[i]],
-						mht::kQCovMat[j] ) );
+						mht::kQCovMat[j] );
 
 			rcptr<Factor> measMarginal = (predMeasurements[i][j])->marginalize(elementsOfZ[virtualMeasurementVars[i]]);
-			validationRegion[i][j]  = (std::dynamic_pointer_cast<CGM>(measMarginal))->momentMatch();
+			validationRegion[i][j]  = (std::dynamic_pointer_cast<CGM>(measMarginal))->momentMatch(stepArena);
 		} // for
 	} // for
 } // predictStatesSU()
@@ -123,9 +122,8 @@ void predictStatesAU(const unsigned N,
 
 			// Create a new factor over current variables
 			stateJoint = uniqptr<Factor>(new CGM( prevMarginal, 
-						mht::kMotionModel, 
-						elementsOfX[currentStates[N][i]], 
-						mht::kRCovMat  ));
+						mht::kTransition, 
+						elementsOfX[currentStates[N][i]] ));
 			stateNodes[N][i] = uniqptr<Node> (new Node(stateJoint, stateNodes[N-1][i]->getIdentity() ) );
 
 			// Link Node to preceding node
@@ -164,6 +162,7 @@ void createMeasurementDistributionsSU(const unsigned N,
 		// Local maps
 		std::map<emdw::RVIdType, rcptr<DASS>> assocHypotheses; assocHypotheses.clear();
 		std::map<emdw::RVIdType, ColVector<double>> colMeasurements; colMeasurements.clear();
+		std::vector<rcptr<DASS>> hypotheses(measurements.size());
 
 		// For each measurement
 		for (unsigned j = 0; j < measurements.size(); j++) { 
@@ -178,66 +177,48 @@ void createMeasurementDistributionsSU(const unsigned N,
 				sensorMeasurements.push_back(z);
 				currentMeasurements[N].push_back(z);
 
-				assocHypotheses[a] = uniqptr<DASS>(new DASS{ (unsigned short) i  });
+				assocHypotheses[a] = hypotheses[j] = uniqptr<DASS>(new DASS{ (unsigned short) i });
 				colMeasurements[z] = measurements[j];
-
-				// Form hypotheses over each measurement
-				for (unsigned k = mht::kNumSensors; k < M; k++) {
-					if (validationRegion[k].size() == 0) continue;
-					
-					//std::cout << "k : " << k << std::endl;
-					double distance = 
-						(std::dynamic_pointer_cast<GC>(validationRegion[k][i]))->mahalanobis(measurements[j]);
-					//std::cout << "Distance : " << distance  << std::endl;
-
-					if (distance < mht::kValidationThreshold) {
-						assocHypotheses[a]->push_back(k); 
-					} // if
-				} // for
 			} // if
 		} // for
 
+		// Form hypotheses over each measurement
+		MeasurementGate gate(mht::kMeasSpaceDim);
+		for (unsigned k = mht::kNumSensors; k < M; k++) {
+			if (validationRegion[k].size() == 0) continue;
+			gate.addTarget(k, validationRegion[k][i].get());
+		} // for
+		gate.gate(measurements, mht::kValidationThreshold, hypotheses);
+
 		if (assocHypotheses.size()) {
 			// Determine the 'prior' over association hypotheses
 			std::map<emdw::RVIdType, rcptr<Factor>> distributions = graphBuilder->getMarginals(assocHypotheses);
+
+			// Measurements with the same association domain condition the same joints
+			std::map<DASS, std::vector<unsigned>> groups;
+			std::vector<ColVector<double>> values(sensorMeasurements.size());
+			for (unsigned j = 0; j < sensorMeasurements.size(); j++) {
+				values[j] = colMeasurements[sensorMeasurements[j]];
+				const DASS& domain = *assocHypotheses[associations[j]];
+				if (domain.size() > 0) groups[domain].push_back(j);
+			} // for
+
+			std::vector<std::map<emdw::RVIdType, rcptr<Factor>>> conditionalLists(sensorMeasurements.size());
+			for (auto& group : groups) {
+				conditionOnMeasurements(group.first, group.second, values, i, virtualMeasurementVars,
+						predMarginals, predMeasurements, conditionalLists);
+			} // for
 	
 			for (unsigned j = 0; j < sensorMeasurements.size(); j++) {
 				emdw::RVIdType a = associations[j];
-				emdw::RVIdType z = sensorMeasurements[j];
 
 				DASS domain = *assocHypotheses[a];
 				unsigned domSize = domain.size();
 
 				//std::cout << "domains: " << domain << std::endl;
 				if (domSize > 0) {
-					// Create a conditional map for the ConditionalGaussian
-					std::map<emdw::RVIdType, rcptr<Factor>> conditionalList; conditionalList.clear();
-
-					for (unsigned k = 0; k < domSize; k++) {
-						unsigned p = domain[k];
-
-						// Create a new scope
-						emdw::RVIds newScope = predMarginals[p]->getVars();
-						newScope.insert(newScope.end(), elementsOfZ[z].begin(), elementsOfZ[z].end());
-
-						// Product of predicted marginals
-						conditionalList[p] = uniqptr<Factor>( predMeasurements[p][i]->copy(newScope, false) );
-
-						// Multiply the predicted states by the likelihood function
-						for (unsigned l = 0; l < domSize; l++) {
-							unsigned q = domain[l];
-							if ( q != p ) conditionalList[p]->inplaceAbsorb(predMarginals[q]);
-						} // for
-
-						// Introduce evidence into CGM
-						conditionalList[p] = conditionalList[p]->observeAndReduce(
-								elementsOfZ[z],
-								emdw::RVVals{colMeasurements[z][0], colMeasurements[z][1]},
-								true);
-					} // for
-			
 					// Create ConditionalGauss - observeAndReduce does work, but for scope reasons this is easier.
-					rcptr<Factor> clg = uniqptr<Factor>(new CLG(distributions[a], conditionalList));
+					rcptr<Factor> clg = stepArena.make<CLG>(distributions[a], conditionalLists[j]);
 
 					// Create a measurement node and connect it to state nodes
 					rcptr<Node> measNode = uniqptr<Node>(new Node(clg));
@@ -255,6 +236,7 @@ void createMeasurementDistributionsSU(const unsigned N,
 	// Clear temporary values
 	predMarginals.clear();
 	virtualMeasurementVars.clear();
+	predMeasurements.clear();
 	validationRegion.clear();
 } // createMeasurementDistributionsSU()
 
@@ -284,21 +266,21 @@ void createMeasurementDistributionsAU(const unsigned N,
 
 		// Determine the predicted marginal
 		predMarginals[i] = stateNodes[N][i]->marginalize(elementsOfX[currentStates[N][i]]);
-		predMarginals[i] = std::dynamic_pointer_cast<CGM>(predMarginals[i])->momentMatchCGM();
+		predMarginals[i] = std::dynamic_pointer_cast<CGM>(predMarginals[i])->momentMatchCGM(stepArena);
 		
 		// Add in place holder values for measurement vars
 		virtualMeasurementVars[i] = addVariables(variables, vecZ, elementsOfZ, mht::kMeasSpaceDim);
 
 		// Create the predicted measurement distribution
 		predMeasurements[i].resize(1); validationRegion[i].resize(1);
-		predMeasurements[i][0] = uniqptr<Factor>(new CGM( predMarginals[i], 
+		predMeasurements[i][0] = stepArena.make<CGM>( predMarginals[i], 
 					mht::kMeasurementModel[sensorNumber], 
 					elementsOfZ[virtualMeasurementVars[i]],
-					mht::kQCovMat[sensorNumber] ) );
+					mht::kQCovMat[sensorNumber] );
 
 		// Cast the predicted distribution to a GaussCannical so Mahalanobis distance can be used.
 		rcptr<Factor> measMarginal = (predMeasurements[i][0])->marginalize(elementsOfZ[virtualMeasurementVars[i]]);
-		validationRegion[i][0]  = (std::dynamic_pointer_cast<CGM>(measMarginal))->momentMatch();
+		validationRegion[i][0]  = (std::dynamic_pointer_cast<CGM>(measMarginal))->momentMatch(stepArena);
 	} // for
 
 	// Get the measurement for this particular sensor
@@ -311,6 +293,7 @@ void createMeasurementDistributionsAU(const unsigned N,
 	// Local maps
 	std::map<emdw::RVIdType, rcptr<DASS>> assocHypotheses; assocHypotheses.clear();
 	std::map<emdw::RVIdType, ColVector<double>> colMeasurements; colMeasurements.clear();
+	std::vector<rcptr<DASS>> hypotheses(measurements.size());
 
 	// For each measurement
 	for (unsigned j = 0; j < measurements.size(); j++) { 
@@ -325,64 +308,47 @@ void createMeasurementDistributionsAU(const unsigned N,
 			sensorMeasurements.push_back(z);
 			currentMeasurements[N].push_back(z);
 
-			assocHypotheses[a] = uniqptr<DASS>(new DASS{ (unsigned short) sensorNumber  });
+			assocHypotheses[a] = hypotheses[j] = uniqptr<DASS>(new DASS{ (unsigned short) sensorNumber });
 			colMeasurements[z] = measurements[j];
-
-			// Form hypotheses over each measurement
-			for (unsigned k = mht::kNumSensors; k < M; k++) {
-				if (validationRegion[k].size() == 0) continue;
-
-				double distance = 
-					(std::dynamic_pointer_cast<GC>(validationRegion[k][0]))->mahalanobis(measurements[j]);
-
-				if (distance < mht::kValidationThreshold) {
-					assocHypotheses[a]->push_back(k); 
-				} // if
-			} // for
 		} // if
 	} // for
 
+	// Form hypotheses over each measurement
+	MeasurementGate gate(mht::kMeasSpaceDim);
+	for (unsigned k = mht::kNumSensors; k < M; k++) {
+		if (validationRegion[k].size() == 0) continue;
+		gate.addTarget(k, validationRegion[k][0].get());
+	} // for
+	gate.gate(measurements, mht::kValidationThreshold, hypotheses);
+
 	if (assocHypotheses.size()) {
 		// Determine the 'prior' over association hypotheses
 		std::map<emdw::RVIdType, rcptr<Factor>> distributions = graphBuilder->getMarginals(assocHypotheses);
 
+		// Measurements with the same association domain condition the same joints
+		std::map<DASS, std::vector<unsigned>> groups;
+		std::vector<ColVector<double>> values(sensorMeasurements.size());
+		for (unsigned j = 0; j < sensorMeasurements.size(); j++) {
+			values[j] = colMeasurements[sensorMeasurements[j]];
+			const DASS& domain = *assocHypotheses[associations[j]];
+			if (domain.size() > 0) groups[domain].push_back(j);
+		} // for
+
+		std::vector<std::map<emdw::RVIdType, rcptr<Factor>>> conditionalLists(sensorMeasurements.size());
+		for (auto& group : groups) {
+			conditionOnMeasurements(group.first, group.second, values, 0, virtualMeasurementVars,
+					predMarginals, predMeasurements, conditionalLists);
+		} // for
+
 		for (unsigned j = 0; j < sensorMeasurements.size(); j++) {
 			emdw::RVIdType a = associations[j];
-			emdw::RVIdType z = sensorMeasurements[j];
 
 			DASS domain = *assocHypotheses[a];
 			unsigned domSize = domain.size();
 
 			if (domSize > 0) {
-				// Create a conditional map for the ConditionalGaussian
-				std::map<emdw::RVIdType, rcptr<Factor>> conditionalList; conditionalList.clear();
-
-				for (unsigned k = 0; k < domSize; k++) {
-					unsigned p = domain[k];
-
-					// Create a new scope
-					emdw::RVIds newScope = predMarginals[p]->getVars();
-					newScope.insert(newScope.end(), elementsOfZ[z].begin(), elementsOfZ[z].end());
-
-					// Product of predicted marginals
-					conditionalList[p] = uniqptr<Factor>( predMeasurements[p][0]->copy(newScope, false) );
-
-					// Multiply the predicted states by the likelihood function
-					for (unsigned l = 0; l < domSize; l++) {
-						unsigned q = domain[l];
-						if ( q != p ) conditionalList[p]->inplaceAbsorb(predMarginals[q]);
-					} // for
-
-
-					// Introduce evidence into CGM
-					conditionalList[p] = conditionalList[p]->observeAndReduce(
-							elementsOfZ[z],
-							emdw::RVVals{colMeasurements[z][0], colMeasurements[z][1]},
-							true);
-				} // for
-		
 				// Create ConditionalGauss - observeAndReduce does work, but for scope reasons this is easier.
-				rcptr<Factor> clg = uniqptr<Factor>(new CLG(distributions[a], conditionalList));
+				rcptr<Factor> clg = stepArena.make<CLG>(distributions[a], conditionalLists[j]);
 
 				// Create a measurement node and connect it to state nodes
 				rcptr<Node> measNode = uniqptr<Node>(new Node(clg));
@@ -399,39 +365,73 @@ void createMeasurementDistributionsAU(const unsigned N,
 	// Clear temporary values
 	predMarginals.clear();
 	virtualMeasurementVars.clear();
+	predMeasurements.clear();
 	validationRegion.clear();
 } // createMeasurementDistributionsAU()
 
-void measurementUpdateSU(const unsigned N,
-		std::map<unsigned, std::vector<rcptr<Node>>>& stateNodes,
-		std::map<unsigned, std::vector<rcptr<Node>>>& measurementNodes
-		) {
-	unsigned M = measurementNodes[N].size();
+void conditionOnMeasurements(const DASS& domain,
+		const std::vector<unsigned>& members,
+		const std::vector<ColVector<double>>& values,
+		const unsigned sensor,
+		const emdw::RVIds& virtualMeasurementVars, 
+		const std::vector<rcptr<Factor>>& predMarginals,
+		std::map<unsigned, std::vector<rcptr<Factor>>>& predMeasurements,
+		std::vector<std::map<emdw::RVIdType, rcptr<Factor>>>& conditionalLists) {
+	std::vector<ColVector<double>> measurements(members.size());
+	for (unsigned t = 0; t < members.size(); t++) measurements[t] = values[members[t]];
 
-	for (unsigned i = 0; i < M; i++) {
-		std::vector<std::weak_ptr<Node>> adjacent = measurementNodes[N][i]->getAdjacentNodes();
+	for (unsigned k = 0; k < domain.size(); k++) {
+		unsigned p = domain[k];
+
+		// Product of predicted marginals, over the candidate's virtual measurement variables
+		rcptr<Factor> joint = stepArena.make<CGM>( *std::dynamic_pointer_cast<CGM>(predMeasurements[p][sensor]) );
+
+		// Multiply the predicted states by the likelihood function
+		for (unsigned l = 0; l < domain.size(); l++) {
+			unsigned q = domain[l];
+			if ( q != p ) joint->inplaceAbsorb(predMarginals[q]);
+		} // for
+
+		// Introduce each measurement's evidence into the CGM, the measurement variables are observed away
+		std::vector<rcptr<Factor>> conditioned = std::dynamic_pointer_cast<CGM>(joint)->observeAndReduce(
+				elementsOfZ[virtualMeasurementVars[p]], measurements, &stepArena);
+		for (unsigned t = 0; t < members.size(); t++) conditionalLists[members[t]][p] = conditioned[t];
+	} // for
+} // conditionOnMeasurements()
+
+void absorbMeasurementMessages(std::vector<rcptr<Node>>& measurementNodes) {
+	// Collect the messages destined for each state node, in order of first contact
+	std::vector<rcptr<Node>> updated;
+	std::map<rcptr<Node>, std::vector<rcptr<Factor>>> absorbed, cancelled;
+
+	for (unsigned i = 0; i < measurementNodes.size(); i++) {
+		std::vector<std::weak_ptr<Node>> adjacent = measurementNodes[i]->getAdjacentNodes();
 
 		for (unsigned j = 0; j < adjacent.size(); j++) {
 			// Get the neighbouring state node and message it sent to the measurement clique
 			rcptr<Node> stateNode = adjacent[j].lock();
-			rcptr<Factor> receivedMessage = measurementNodes[N][i]->getReceivedMessage( stateNode );
+			if (!absorbed.count(stateNode)) updated.push_back(stateNode);
+			cancelled[stateNode].push_back( measurementNodes[i]->getReceivedMessage( stateNode ) );
 
 			// Determine the outgoing message
-			emdw::RVIds sepset = measurementNodes[N][i]->getSepset( stateNode );
-			rcptr<Factor> outgoingMessage =  (measurementNodes[N][i]->marginalize( sepset, true));
-
-			// Update the factor
-			rcptr<Factor> factor = stateNode->getFactor();
-			factor->inplaceAbsorb(outgoingMessage);
-			factor->inplaceCancel(receivedMessage);
-
-			// Prune and/or merge factor
-			std::dynamic_pointer_cast<CGM>(factor)->pruneAndMerge();
-
-			// Update the factor
-			stateNode->setFactor(factor);
+			emdw::RVIds sepset = measurementNodes[i]->getSepset( stateNode );
+			absorbed[stateNode].push_back( measurementNodes[i]->marginalize( sepset, stepArena, true) );
 		} // for
 	} // for
+
+	// Update each factor, pruning and merging once
+	for (rcptr<Node> stateNode : updated) {
+		rcptr<Factor> factor = stateNode->getFactor();
+		std::dynamic_pointer_cast<CGM>(factor)->inplaceAbsorbAndReduce(absorbed[stateNode], cancelled[stateNode]);
+		stateNode->setFactor(factor);
+	} // for
+} // absorbMeasurementMessages()
+
+void measurementUpdateSU(const unsigned N,
+		std::map<unsigned, std::vector<rcptr<Node>>>& stateNodes,
+		std::map<unsigned, std::vector<rcptr<Node>>>& measurementNodes
+		) {
+	absorbMeasurementMessages(measurementNodes[N]);
 } // measurementUpdateSU()
 
 void measurementUpdateAU(const unsigned N,
@@ -455,32 +455,7 @@ void measurementUpdateAU(const unsigned N,
 				predMeasurements, 
 				validationRegion);
 
-		unsigned M = measurementNodes[N].size();
-
-		for (unsigned j = 0; j < M; j++) {
-			std::vector<std::weak_ptr<Node>> adjacent = measurementNodes[N][j]->getAdjacentNodes();
-
-			for (unsigned k = 0; k < adjacent.size(); k++) {
-				// Get the neighbouring state node and message it sent to the measurement clique
-				rcptr<Node> stateNode = adjacent[k].lock();
-				rcptr<Factor> receivedMessage = measurementNodes[N][j]->getReceivedMessage( stateNode );
-
-				// Determine the outgoing message
-				emdw::RVIds sepset = measurementNodes[N][j]->getSepset( stateNode );
-				rcptr<Factor> outgoingMessage =  (measurementNodes[N][j]->marginalize( sepset, true));
-
-				// Update the factor
-				rcptr<Factor> factor = stateNode->getFactor();
-				factor->inplaceAbsorb(outgoingMessage);
-				factor->inplaceCancel(receivedMessage);
-
-				// Prune and/or merge factor
-				std::dynamic_pointer_cast<CGM>(factor)->pruneAndMerge();
-
-				// Update the factor
-				stateNode->setFactor(factor);
-			} // for
-		} // for
+		absorbMeasurementMessages(measurementNodes[N]);
 	} // for
 } // createMeasurementDistributionsAU()
 
@@ -10,6 +10,9 @@
 #include <iostream>
 #include <math.h>
 #include <limits>
+#include <algorithm>
+#include <queue>
+#include <functional>
 #include "sortindices.hpp"
 #include "genvec.hpp"
 #include "genmat.hpp"
@@ -17,7 +20,15 @@
 #include "matops.hpp"
 #include "vecset.hpp"
 #include "gausscanonical.hpp"
+#include "component_store.hpp"
+#include "component_index.hpp"
+#include "operator_policy.hpp"
+#include "scope_plan.hpp"
+#include "binary_io.hpp"
+#include "weight_kernels.hpp"
 #include "canonical_gaussian_mixture.hpp"
+#include "transforms.hpp"
+#include "transition_factor.hpp"
 
 // Default operators
 rcptr<FactorOperator> defaultInplaceNormalizerCGM = uniqptr<FactorOperator>(new InplaceNormalizeCGM());
@@ -29,6 +40,213 @@ rcptr<FactorOperator> defaultCancellerCGM = uniqptr<FactorOperator>(new CancelCG
 rcptr<FactorOperator> defaultMarginalizerCGM = uniqptr<FactorOperator>(new MarginalizeCGM());
 rcptr<FactorOperator> defaultObserveReducerCGM = uniqptr<FactorOperator>(new ObserveAndReduceCGM());
 rcptr<FactorOperator> defaultInplaceWeakDamperCGM = uniqptr<FactorOperator>(new InplaceWeakDampingCGM());
+rcptr<FactorOperator> defaultInplaceReducerCGM = uniqptr<FactorOperator>(new InplacePruneAndMergeCGM());
+
+// Shared by every mixture constructed with the default operators
+rcptr<const OperatorPolicy> defaultOperatorsCGM(new OperatorPolicy(
+			defaultInplaceNormalizerCGM,
+			defaultNormalizerCGM,
+			defaultInplaceAbsorberCGM,
+			defaultAbsorberCGM,
+			defaultInplaceCancellerCGM,
+			defaultCancellerCGM,
+			defaultMarginalizerCGM,
+			defaultObserveReducerCGM,
+			defaultInplaceWeakDamperCGM,
+			defaultInplaceReducerCGM));
+
+// The Unscented Transform's central sigma point has weight kappa/(n + kappa)
+static const double kUnscentedKappa = 1.0;
+
+// Collapse cache statistics
+unsigned long CanonicalGaussianMixture::collapseHits_ = 0;
+unsigned long CanonicalGaussianMixture::collapseMisses_ = 0;
+
+//------------------ Packed component helpers
+
+// Largest dimension whose matched moments are accumulated on the stack
+static const unsigned kFixedMoments = 8;
+
+/**
+ * Accumulates the mixture's normalised first and raw second moments in a
+ * single pass over the components' cached moments. The weights are taken
+ * relative to the heaviest component seen so far, the sums are rescaled
+ * whenever a heavier one appears. D is the dimension if it is known at
+ * compile time, otherwise zero.
+ *
+ * If cached is null each component's logarithmic mass is determined and
+ * written to logMasses, otherwise cached is used. Components without
+ * finite mass have no moments and are skipped.
+ *
+ * @return The mixture's logarithmic mass, as logSumExp.
+ */
+template<unsigned D>
+static double accumulateMoments(const ComponentStore& components, ComponentMoments& moments,
+		const double* cached, double* logMasses, const unsigned dimension, double* mean, double* second) {
+	const unsigned d = D ? D : dimension;
+	unsigned M = components.size();
+
+	std::fill(mean, mean + d, 0.0);
+	std::fill(second, second + d*d, 0.0);
+	double shift = -std::numeric_limits<double>::infinity(), total = 0;
+
+	for (unsigned i = 0; i < M; i++) {
+		double logMass = cached ? cached[i] : moments.logMass(components, i);
+		logMasses[i] = logMass;
+		if (!std::isfinite(logMass)) continue;
+
+		// Cached masses may outlive the moments, refresh them first
+		if (!moments.update(components, i)) continue;
+
+		if (logMass > shift) {
+			double scale = exp(shift - logMass);
+			total *= scale;
+			for (unsigned r = 0; r < d; r++) mean[r] *= scale;
+			for (unsigned r = 0; r < d*d; r++) second[r] *= scale;
+			shift = logMass;
+		} // if
+
+		const double* mu = moments.mean(i);
+		const double* S = moments.cov(i);
+		double weight = exp(logMass - shift);
+		total += weight;
+
+		for (unsigned r = 0; r < d; r++) {
+			const double wr = weight*mu[r];
+			mean[r] += wr;
+			for (unsigned c = 0; c < d; c++) second[r*d + c] += weight*S[r*d + c] + wr*mu[c];
+		} // for
+	} // for
+
+	if (!(total > 0)) return -std::numeric_limits<double>::infinity();
+
+	for (unsigned r = 0; r < d; r++) mean[r] /= total;
+	for (unsigned r = 0; r < d*d; r++) second[r] /= total;
+
+	return shift + log(total);
+} // accumulateMoments()
+
+/**
+ * A candidate merge of components i and j, at the given versions.
+ */
+struct PairwiseMerge {
+	double cost;
+	unsigned i, j, vi, vj;
+	bool operator>(const PairwiseMerge& rhs) const { return cost > rhs.cost; }
+}; // PairwiseMerge
+
+/**
+ * Orders component indices by decreasing logarithmic mass.
+ */
+struct HeavierComponent {
+	HeavierComponent(const std::vector<double>& logMasses) : logMasses_(logMasses) {}
+	bool operator()(const unsigned i, const unsigned j) const { return logMasses_[i] > logMasses_[j]; }
+	const std::vector<double>& logMasses_;
+}; // HeavierComponent
+
+/**
+ * Forms the product of lhs component i and rhs component j, lhs must
+ * already span the product's scope.
+ */
+static void formProduct(const ComponentStore& lhs, const unsigned i,
+		const ComponentStore& rhs, const unsigned j, const std::vector<unsigned>& rhsMap,
+		double* K, double* h, double& g) {
+	unsigned D = lhs.getDimension(), Q = rhs.getDimension();
+	std::copy(lhs.K(i), lhs.K(i) + D*D, K);
+	std::copy(lhs.h(i), lhs.h(i) + D, h);
+
+	const double* Kj = rhs.K(j);
+	const double* hj = rhs.h(j);
+	for (unsigned r = 0; r < Q; r++) {
+		h[rhsMap[r]] += hj[r];
+		for (unsigned c = 0; c < Q; c++) K[rhsMap[r]*D + rhsMap[c]] += Kj[r*Q + c];
+	} // for
+	g = lhs.g(i) + rhs.g(j);
+} // formProduct()
+
+/**
+ * Sorts the scope, permuting the packed components to match.
+ */
+static emdw::RVIds sortScope(const emdw::RVIds& vars, ComponentStore& components) {
+	std::vector<size_t> sorted = sortIndices(vars, std::less<unsigned>() );
+	std::vector<unsigned> order(sorted.begin(), sorted.end());
+
+	bool identity = true;
+	for (unsigned i = 0; i < order.size() && identity; i++) identity = (order[i] == i);
+	if (!identity) permuteComponents(components, order);
+
+	return extract<unsigned>(vars, sorted);
+} // sortScope()
+
+/**
+ * The sorted scope of a joint over x and y whose components were formed
+ * with x first, as in GaussCanonical.
+ */
+static emdw::RVIds jointScope(const emdw::RVIds& xVars, const emdw::RVIds& yVars, ComponentStore& components) {
+	emdw::RVIds vars = xVars;
+	vars.insert(vars.end(), yVars.begin(), yVars.end());
+	return sortScope(vars, components);
+} // jointScope()
+
+/**
+ * Determines the union of two sorted scopes and the position
+ * of each scope's variables in the union.
+ */
+static emdw::RVIds scopeUnion(const emdw::RVIds& a, const emdw::RVIds& b,
+		std::vector<unsigned>& aMap, std::vector<unsigned>& bMap) {
+	emdw::RVIds vars; vars.reserve(a.size() + b.size());
+	aMap.resize(a.size()); bMap.resize(b.size());
+
+	unsigned i = 0, j = 0;
+	while (i < a.size() || j < b.size()) {
+		if (j == b.size() || (i < a.size() && a[i] < b[j])) {
+			aMap[i] = vars.size();
+			vars.push_back(a[i++]);
+		} else if (i == a.size() || b[j] < a[i]) {
+			bMap[j] = vars.size();
+			vars.push_back(b[j++]);
+		} else {
+			aMap[i] = bMap[j] = vars.size();
+			vars.push_back(a[i++]); j++;
+		} // if
+	} // while
+
+	return vars;
+} // scopeUnion()
+
+/**
+ * Unpacks component i into a new GaussCanonical.
+ */
+static uniqptr<Factor> unpackComponent(const emdw::RVIds& vars, const ComponentStore& components, const unsigned i) {
+	return uniqptr<Factor>( new GaussCanonical(vars, components.getK(i), components.getH(i), components.g(i), true) );
+} // unpackComponent()
+
+/**
+ * Appends a GaussCanonical to the packed components, returning its scope.
+ * An empty store takes on the GaussCanonical's dimension.
+ */
+static emdw::RVIds packGaussCanonical(const Factor* fPtr, ComponentStore& packed) {
+	const GaussCanonical* gc = dynamic_cast<const GaussCanonical*>(fPtr);
+	emdw::RVIds vars = gc->getVars();
+
+	if (packed.empty()) packed.reset(vars.size());
+	packed.append(gc->getK(), gc->getH(), gc->getG());
+
+	return vars;
+} // packGaussCanonical()
+
+/**
+ * Determines the logarithmic mass of each packed component.
+ */
+static void componentLogMasses(const ComponentStore& components, std::vector<double>& masses) {
+	unsigned D = components.getDimension();
+	std::vector<double> work(D*(D + 1));
+
+	masses.resize(components.size());
+	for (unsigned i = 0; i < components.size(); i++) {
+		masses[i] = canonicalLogMass(components.K(i), components.h(i), components.g(i), D, work.data());
+	} // for
+} // componentLogMasses()
 
 CanonicalGaussianMixture::CanonicalGaussianMixture(
 		const emdw::RVIds& vars,
@@ -49,27 +267,13 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 			maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
-
 	// Ensure the higher level description is sorted.
 	if (presorted || !vars.size()) {
 		vars_ = vars;
@@ -79,9 +283,10 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 	}
 
 	// Create a mixture with a single vacuous component.
-	comps_.clear();
-	comps_.push_back( uniqptr<Factor> ( new GaussCanonical(vars_, true ) ) );
-	N_ = 1;
+	unsigned dimension = vars_.size();
+	std::vector<double> K(dimension*dimension, 0.0), h(dimension, 0.0);
+	comps_.reset(dimension);
+	comps_.append(K.data(), h.data(), 0.0);
 } // Default Constructor
 
 CanonicalGaussianMixture::CanonicalGaussianMixture(
@@ -103,40 +308,27 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 		const rcptr<FactorOperator>& observerAndReducer,
 		const rcptr<FactorOperator>& inplaceDamper)
 			: vars_(vars.size()),
-			comps_(weights.size()),
-			N_(weights.size()),
+			comps_(vars.size(), weights.size()),
 			maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
 
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
-
 	// A quick check
-	ASSERT( (means.size() == N_) && (covs.size() == N_),
+	unsigned N = weights.size();
+	ASSERT( (means.size() == N) && (covs.size() == N),
 			"weights.size() = " << weights.size() << ", but means.size() = " <<
 			means.size() << "and covs.size() = " << covs.size() );
 
 	// Convert from Covariance to Canonical form, this is done upfront
 	// as using adjustMass after initialisation is more expensive.
-	for (unsigned i = 0; i < N_; i++) {
+	for (unsigned i = 0; i < N; i++) {
 		int fail = 0;
 		double detK = 0.0;
 		Matrix<double> K = inv(covs[i], detK, fail);
@@ -148,11 +340,11 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 			- log(detK) ) + log(weights[i]);
 		*/
 
-		comps_[i] = uniqptr<Factor> ( new GaussCanonical(vars, K, h, log(weights[i]), false) );
+		comps_.append(K, h, log(weights[i]));
 	}
 
 	// Make the sure high level description is sorted.
-	vars_ = comps_[0]->getVars();
+	vars_ = sortScope(vars, comps_);
 } // Covariance constructor
 
 CanonicalGaussianMixture::CanonicalGaussianMixture(
@@ -174,44 +366,28 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 		const rcptr<FactorOperator>& observerAndReducer,
 		const rcptr<FactorOperator>& inplaceDamper)
 			: vars_(vars.size()),
-			comps_(g.size()),
-			N_(g.size()),
+			comps_(vars.size(), g.size()),
 			maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
 
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
-
 	// A quick check
-	ASSERT( (info.size() == N_) && (prec.size() == N_),
-			"g.size() = " << N_ << ", but info.size() = " <<
+	unsigned N = g.size();
+	ASSERT( (info.size() == N) && (prec.size() == N),
+			"g.size() = " << N << ", but info.size() = " <<
 			info.size() << "and prec.size() = " << prec.size() );
 
-	for (unsigned i = 0; i < N_; i++) {
-		comps_[i] = uniqptr<Factor> ( new GaussCanonical(vars, prec[i], info[i], g[i], false ) );
-	}
+	for (unsigned i = 0; i < N; i++) comps_.append(prec[i], info[i], g[i]);
 
 	// Make the sure high level description is sorted.
-	vars_ = comps_[0]->getVars();
+	vars_ = sortScope(vars, comps_);
 } // Canonical constructor
 
 CanonicalGaussianMixture::CanonicalGaussianMixture(
@@ -232,33 +408,18 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 		const rcptr<FactorOperator>& inplaceDamper
 		) 
 			: vars_(vars.size()),
-			comps_(components.size()),
-			N_(components.size()),
+			comps_(vars.size(), components.size()),
 			maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
-	
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
-	
+
 	// Make the sure high level description is sorted.
 	if (presorted || !vars.size()) {
 		vars_ = vars;	
@@ -267,11 +428,12 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 		vars_ = extract<unsigned>(vars, sorted);
 	}
 
-	for (unsigned i = 0; i < N_; i++) {
+	for (unsigned i = 0; i < components.size(); i++) {
 		ASSERT( vars == components[i]->getVars(), vars << " != " << components[i]->getVars()
 				<< ". All components must be distributions in " << vars);
 		
-		comps_[i] = uniqptr<Factor>(components[i]->copy());
+		rcptr<GaussCanonical> gc = std::dynamic_pointer_cast<GaussCanonical>(components[i]);
+		comps_.append(gc->getK(), gc->getH(), gc->getG());
 	}
 } // Component constructor
 
@@ -297,44 +459,102 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 			: maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)		
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
 
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
+	// Get the old mixture components.
+	rcptr<CanonicalGaussianMixture> cgm = std::dynamic_pointer_cast<CanonicalGaussianMixture>(xFPtr);
+	unsigned n = cgm->vars_.size(), m = newVars.size();
+
+	std::vector<double> packedA(m*n), packedB(m, 0.0);
+	for (unsigned r = 0; r < m; r++) {
+		for (unsigned c = 0; c < n; c++) packedA[r*n + c] = A(r, c);
+	} // for
+	predict(*cgm, TransitionFactor(packedA.data(), packedB.data(), Q, n, m), newVars);
+} // Linear Gaussian constructor
+
+CanonicalGaussianMixture::CanonicalGaussianMixture(
+		const rcptr<Factor>& xFPtr,
+		const Matrix<double>& A,
+		const ColVector<double>& b,
+		const emdw::RVIds& newVars,
+		const Matrix<double>& Q,
+		bool presorted,
+		const unsigned maxComponents,
+		const double threshold,
+		const double unionDistance,
+		const rcptr<FactorOperator>& inplaceNormalizer,
+		const rcptr<FactorOperator>& normalizer,
+		const rcptr<FactorOperator>& inplaceAbsorber,
+		const rcptr<FactorOperator>& absorber,
+		const rcptr<FactorOperator>& inplaceCanceller,
+		const rcptr<FactorOperator>& canceller,
+		const rcptr<FactorOperator>& marginalizer,
+		const rcptr<FactorOperator>& observerAndReducer,
+		const rcptr<FactorOperator>& inplaceDamper
+		) 
+			: maxComp_(maxComponents),
+			threshold_(threshold),
+			unionDistance_(unionDistance),
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
+		{
 
 	// Get the old mixture components.
 	rcptr<CanonicalGaussianMixture> cgm = std::dynamic_pointer_cast<CanonicalGaussianMixture>(xFPtr);
-	std::vector<rcptr<Factor>> oldComps = cgm->getComponents();
-	
-	// Allocate the new mixture.
-	N_ = oldComps.size();
-	comps_ = std::vector<rcptr<Factor>>(N_);
+	unsigned n = cgm->vars_.size(), m = newVars.size();
+	ASSERT( b.size() == m, "The offset has " << b.size() << " elements, not " << m );
 
-	// Put each component through the linear transform.
-	for (unsigned i = 0; i < N_; i++) {
-		comps_[i] = uniqptr<Factor>(new GaussCanonical(oldComps[i].get(), A, newVars, Q, false ) );
-	}
+	std::vector<double> packedA(m*n), packedB(m);
+	for (unsigned r = 0; r < m; r++) {
+		packedB[r] = b[r];
+		for (unsigned c = 0; c < n; c++) packedA[r*n + c] = A(r, c);
+	} // for
+	predict(*cgm, TransitionFactor(packedA.data(), packedB.data(), Q, n, m), newVars);
+} // Affine Gaussian constructor
 
-	// Make the new variables are sorted in CanonicalGaussianMixture
-	vars_ = comps_[0]->getVars();
-} // Linear Gaussian constructor
+CanonicalGaussianMixture::CanonicalGaussianMixture(
+		const rcptr<Factor>& xFPtr,
+		const rcptr<const TransitionFactor>& transition,
+		const emdw::RVIds& newVars,
+		bool presorted,
+		const unsigned maxComponents,
+		const double threshold,
+		const double unionDistance,
+		const rcptr<FactorOperator>& inplaceNormalizer,
+		const rcptr<FactorOperator>& normalizer,
+		const rcptr<FactorOperator>& inplaceAbsorber,
+		const rcptr<FactorOperator>& absorber,
+		const rcptr<FactorOperator>& inplaceCanceller,
+		const rcptr<FactorOperator>& canceller,
+		const rcptr<FactorOperator>& marginalizer,
+		const rcptr<FactorOperator>& observerAndReducer,
+		const rcptr<FactorOperator>& inplaceDamper
+		) 
+			: maxComp_(maxComponents),
+			threshold_(threshold),
+			unionDistance_(unionDistance),
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
+		{
+
+	// Get the old mixture components.
+	rcptr<CanonicalGaussianMixture> cgm = std::dynamic_pointer_cast<CanonicalGaussianMixture>(xFPtr);
+	predict(*cgm, *transition, newVars);
+} // Transition constructor
 
 CanonicalGaussianMixture::CanonicalGaussianMixture(
 		const rcptr<Factor>& xFPtr,
@@ -358,45 +578,198 @@ CanonicalGaussianMixture::CanonicalGaussianMixture(
 			: maxComp_(maxComponents),
 			threshold_(threshold),
 			unionDistance_(unionDistance),
-			inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			ops_(OperatorPolicy::derive(defaultOperatorsCGM,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 		{
 
-	// Default operator intialisation
-	if (!inplaceNormalizer_) { inplaceNormalizer_ = defaultInplaceNormalizerCGM; }
-	if (!normalizer_) { normalizer_ = defaultNormalizerCGM; }
-	if (!inplaceAbsorber_) { inplaceAbsorber_ = defaultInplaceAbsorberCGM; }
-	if (!absorber_) { absorber_ = defaultAbsorberCGM; }
-	if (!inplaceCanceller_) { inplaceCanceller_ = defaultInplaceCancellerCGM; }
-	if (!canceller_) { canceller_ = defaultCancellerCGM; }
-	if (!marginalizer_) { marginalizer_ = defaultMarginalizerCGM; }
-	if (!observeAndReducer_) { observeAndReducer_ = defaultObserveReducerCGM; }
-	if (!inplaceDamper_) { inplaceDamper_ = defaultInplaceWeakDamperCGM; }
-
 	// Get the old mixture components.
 	rcptr<CanonicalGaussianMixture> cgm = std::dynamic_pointer_cast<CanonicalGaussianMixture>(xFPtr);
-	std::vector<rcptr<Factor>> oldComps = cgm->getComponents();
-	
-	// Allocate the new mixture.
-	N_ = oldComps.size();
-	comps_ = std::vector<rcptr<Factor>>(N_);
+	unsigned N = cgm->comps_.size();
+
+	// Affine transforms have an exact joint, no sigma points are needed
+	const AffineTransform* affine = dynamic_cast<const AffineTransform*>(transform.get());
+	if (affine) {
+		predict(*cgm, TransitionFactor(*affine, Q), newVars);
+		return;
+	} // if
+
+	// Linearise where the transform allows it, the rest fall back to sigma points
+	const BatchTransform* batch = dynamic_cast<const BatchTransform*>(transform.get());
+	const DifferentiableTransform* differentiable = dynamic_cast<const DifferentiableTransform*>(transform.get());
+	if (differentiable && differentiable->isLinearised()) {
+		ASSERT( batch, "A linearised transform must also be a BatchTransform, for the Unscented Transform fallback" );
+
+		std::vector<unsigned> rejected;
+		comps_ = ComponentStore(cgm->vars_.size() + newVars.size(), N);
+		linearisedTransform(*cgm, *differentiable, newVars, Q, rejected);
+		if (rejected.size()) unscentedTransform(*cgm, *batch, newVars, Q, rejected);
+		vars_ = jointScope(cgm->vars_, newVars, comps_);
+		return;
+	} // if
+
+	// Transforms supporting it propagate every component's sigma points at once
+	if (batch) {
+		std::vector<unsigned> indices(N);
+		for (unsigned i = 0; i < N; i++) indices[i] = i;
+
+		comps_ = ComponentStore(cgm->vars_.size() + newVars.size(), N);
+		unscentedTransform(*cgm, *batch, newVars, Q, indices);
+		vars_ = jointScope(cgm->vars_, newVars, comps_);
+		return;
+	} // if
 
 	// Put each component through the transform.
-	for (unsigned i = 0; i < N_; i++) {
-		comps_[i] = uniqptr<Factor>(new GaussCanonical(oldComps[i].get(), *transform, newVars, Q, false ) );
+	for (unsigned i = 0; i < N; i++) {
+		uniqptr<Factor> oldComp = cgm->getComponent(i).clone();
+		GaussCanonical joint(oldComp.get(), *transform, newVars, Q, false);
+
+		// Make the new variables are sorted in CanonicalGaussianMixture
+		if (i == 0) {
+			vars_ = joint.getVars();
+			comps_ = ComponentStore(vars_.size(), N);
+		} // if
+		comps_.append(joint.getK(), joint.getH(), joint.getG());
 	}
-
-	// Make the new variables are sorted in CanonicalGaussianMixture
-	vars_ = comps_[0]->getVars();	
 } // Non-linear Gaussian constructor
 
+void CanonicalGaussianMixture::predict(const CanonicalGaussianMixture& x, const TransitionFactor& transition,
+		const emdw::RVIds& newVars) {
+	ASSERT( transition.inputDimension() == x.vars_.size() && transition.outputDimension() == newVars.size(),
+			"The transition maps " << transition.inputDimension() << " to " << transition.outputDimension()
+			<< " dimensions, not " << x.vars_.size() << " to " << newVars.size() );
+	transition.predict(x.comps_, comps_);
+	vars_ = jointScope(x.vars_, newVars, comps_);
+} // predict()
+
+void CanonicalGaussianMixture::linearisedTransform(const CanonicalGaussianMixture& x, const DifferentiableTransform& transform,
+		const emdw::RVIds& newVars, const Matrix<double>& Q, std::vector<unsigned>& rejected) {
+	unsigned n = x.vars_.size(), m = newVars.size(), M = x.comps_.size();
+	TransitionFactor transition(Q, n, m);
+	std::vector<double> y(m), J(m*n), b(m);
+
+	for (unsigned i = 0; i < M; i++) {
+		if (!x.moments_.update(x.comps_, i)) {
+			printf("Skipped a component without moments at line number %d in file %s\n", __LINE__, __FILE__);
+			continue;
+		} // if
+
+		const double* mu = x.moments_.mean(i);
+		if (!transform.linearise(mu, x.moments_.cov(i), y.data(), J.data())) {
+			rejected.push_back(i);
+			continue;
+		} // if
+
+		// y ~ J x + (f(mu) - J mu) about the component's mean
+		for (unsigned r = 0; r < m; r++) {
+			double s = y[r];
+			for (unsigned c = 0; c < n; c++) s -= J[r*n + c]*mu[c];
+			b[r] = s;
+		} // for
+		transition.linearise(J.data(), b.data());
+
+		unsigned j = comps_.size();
+		comps_.resize(j + 1);
+		transition.predict(x.comps_, i, comps_.K(j), comps_.h(j), comps_.g(j));
+	} // for
+} // linearisedTransform()
+
+void CanonicalGaussianMixture::unscentedTransform(const CanonicalGaussianMixture& x, const BatchTransform& transform,
+		const emdw::RVIds& newVars, const Matrix<double>& Q, const std::vector<unsigned>& indices) {
+	unsigned n = x.vars_.size(), m = newVars.size(), D = n + m;
+	unsigned P = 2*n + 1, M = indices.size();
+	ASSERT( transform.inputDimension() == n && transform.outputDimension() == m, "The transform maps "
+			<< transform.inputDimension() << " to " << transform.outputDimension() << " dimensions, not "
+			<< n << " to " << m );
+
+	// Sigma points of every component, point major
+	std::vector<unsigned> sources; sources.reserve(M);
+	std::vector<double> X; X.reserve(M*P*n);
+	std::vector<double> L(n*n);
+	double spread = sqrt(n + kUnscentedKappa);
+
+	for (unsigned k = 0; k < M; k++) {
+		unsigned i = indices[k];
+		if (!x.moments_.update(x.comps_, i) || !choleskyDecompose(x.moments_.cov(i), L.data(), n)) {
+			printf("Skipped a component without moments at line number %d in file %s\n", __LINE__, __FILE__);
+			continue;
+		} // if
+		sources.push_back(i);
+
+		const double* mu = x.moments_.mean(i);
+		unsigned base = X.size();
+		X.resize(base + P*n);
+		double* points = &X[base];
+
+		for (unsigned r = 0; r < n; r++) points[r] = mu[r];
+		for (unsigned c = 0; c < n; c++) {
+			double* plus = points + (1 + c)*n;
+			double* minus = points + (1 + n + c)*n;
+			for (unsigned r = 0; r < n; r++) {
+				plus[r] = mu[r] + spread*L[r*n + c];
+				minus[r] = mu[r] - spread*L[r*n + c];
+			} // for
+		} // for
+	} // for
+
+	unsigned N = sources.size();
+	std::vector<double> Y(N*P*m);
+	if (N) transform.transform(X.data(), N*P, Y.data());
+
+	// Joint moments over x and y, in that order
+	double w0 = kUnscentedKappa/(n + kUnscentedKappa), wi = 0.5/(n + kUnscentedKappa);
+	std::vector<double> mean(D), cov(D*D), work(D*D);
+
+	for (unsigned k = 0; k < N; k++) {
+		unsigned i = sources[k];
+		const double* mu = x.moments_.mean(i);
+		const double* S = x.moments_.cov(i);
+		const double* points = &X[k*P*n];
+		const double* images = &Y[k*P*m];
+
+		for (unsigned r = 0; r < n; r++) mean[r] = mu[r];
+		for (unsigned r = 0; r < m; r++) {
+			double s = 0;
+			for (unsigned p = 0; p < P; p++) s += (p ? wi : w0)*images[p*m + r];
+			mean[n + r] = s;
+		} // for
+
+		for (unsigned r = 0; r < n; r++) {
+			for (unsigned c = 0; c < n; c++) cov[r*D + c] = S[r*n + c];
+		} // for
+		for (unsigned r = 0; r < m; r++) {
+			for (unsigned c = 0; c < m; c++) cov[(n + r)*D + n + c] = Q(r, c);
+			for (unsigned c = 0; c < n; c++) cov[(n + r)*D + c] = 0.0;
+		} // for
+
+		// Cross and output covariances from the deviations of the sigma points
+		for (unsigned p = 0; p < P; p++) {
+			double w = p ? wi : w0;
+			const double* xp = points + p*n;
+			const double* yp = images + p*m;
+			for (unsigned r = 0; r < m; r++) {
+				double dy = w*(yp[r] - mean[n + r]);
+				for (unsigned c = 0; c < m; c++) cov[(n + r)*D + n + c] += dy*(yp[c] - mean[n + c]);
+				for (unsigned c = 0; c < n; c++) cov[(n + r)*D + c] += dy*(xp[c] - mu[c]);
+			} // for
+		} // for
+		for (unsigned r = 0; r < m; r++) {
+			for (unsigned c = 0; c < n; c++) cov[c*D + n + r] = cov[(n + r)*D + c];
+		} // for
+
+		unsigned j = comps_.size();
+		comps_.resize(j + 1);
+		if (!momentsToCanonical(mean.data(), cov.data(), x.moments_.logMass(x.comps_, i), D,
+					comps_.K(j), comps_.h(j), comps_.g(j), work.data())) {
+			printf("Skipped a component with an improper joint at line number %d in file %s\n", __LINE__, __FILE__);
+			comps_.resize(j);
+		} // if
+	} // for
+} // unscentedTransform()
+
 CanonicalGaussianMixture::~CanonicalGaussianMixture() {} // Default Destructor
 
 unsigned CanonicalGaussianMixture::configure(unsigned) {
@@ -450,42 +823,42 @@ unsigned CanonicalGaussianMixture::classSpecificConfigure(
 
 inline void CanonicalGaussianMixture::inplaceNormalize(FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this);
-	else dynamicInplaceApply(inplaceNormalizer_.get(), this);
+	else dynamicInplaceApply(ops_->inplaceNormalizer.get(), this);
 } // inplaceNormalize()
 
 inline uniqptr<Factor> CanonicalGaussianMixture::normalize(FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor>(dynamicApply(procPtr, this));
-	else return uniqptr<Factor>(dynamicApply(normalizer_.get(), this));
+	else return uniqptr<Factor>(dynamicApply(ops_->normalizer.get(), this));
 } // normalize()
 
 //------------------Family 2: Absorbtion, Cancellation
 
 inline void CanonicalGaussianMixture::inplaceAbsorb(const Factor* rhsPtr, FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this, rhsPtr);
-	else dynamicInplaceApply(inplaceAbsorber_.get(), this, rhsPtr);
+	else dynamicInplaceApply(ops_->inplaceAbsorber.get(), this, rhsPtr);
 } // inplaceAbsorb()
 
 inline uniqptr<Factor> CanonicalGaussianMixture::absorb(const Factor* rhsPtr, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, rhsPtr));
-	else return uniqptr<Factor> (dynamicApply(absorber_.get(), this, rhsPtr));
+	else return uniqptr<Factor> (dynamicApply(ops_->absorber.get(), this, rhsPtr));
 } // absorb()
 
 inline void CanonicalGaussianMixture::inplaceCancel(const Factor* rhsPtr, FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this, rhsPtr);
-	else dynamicInplaceApply(inplaceCanceller_.get(), this, rhsPtr);
+	else dynamicInplaceApply(ops_->inplaceCanceller.get(), this, rhsPtr);
 } // inplaceCancel()
 
 inline uniqptr<Factor> CanonicalGaussianMixture::cancel(const Factor* rhsPtr, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, rhsPtr));
-	else return uniqptr<Factor> (dynamicApply(canceller_.get(), this, rhsPtr));
+	else return uniqptr<Factor> (dynamicApply(ops_->canceller.get(), this, rhsPtr));
 } // cancel()
 
 //------------------Family 4: Marginalization
 
-inline uniqptr<Factor> CanonicalGaussianMixture::marginalize(const emdw::RVIds& variablesToKeep, 
+uniqptr<Factor> CanonicalGaussianMixture::marginalize(const emdw::RVIds& variablesToKeep, 
 		bool presorted, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, variablesToKeep, presorted));
-	else return uniqptr<Factor> (dynamicApply(marginalizer_.get(), this, variablesToKeep, presorted));
+	else return uniqptr<Factor> (dynamicApply(ops_->marginalizer.get(), this, variablesToKeep, presorted));
 } // marginalize()
 
 //------------------Family 4: ObserveAndReduce
@@ -493,7 +866,7 @@ inline uniqptr<Factor> CanonicalGaussianMixture::marginalize(const emdw::RVIds&
 inline uniqptr<Factor> CanonicalGaussianMixture::observeAndReduce( const emdw::RVIds& variables,
 		const emdw::RVVals& assignedVals, bool presorted, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, variables, assignedVals, presorted));
-	else return uniqptr<Factor> (dynamicApply(observeAndReducer_.get(), this, variables, assignedVals, presorted));
+	else return uniqptr<Factor> (dynamicApply(ops_->observeAndReducer.get(), this, variables, assignedVals, presorted));
 } // observeAndReduce()
 
 
@@ -502,35 +875,25 @@ inline uniqptr<Factor> CanonicalGaussianMixture::observeAndReduce( const emdw::R
 // TODO: Complete this!!!
 double CanonicalGaussianMixture::inplaceDampen(const Factor* oldMsg, double df, FactorOperator* procPtr) {
 	if (procPtr) return dynamicInplaceApply(procPtr, this, oldMsg, df);
-	else return dynamicInplaceApply(inplaceDamper_.get(), this, oldMsg, df); 
+	else return dynamicInplaceApply(ops_->inplaceDamper.get(), this, oldMsg, df); 
 } // inplaceDampen()
 
 //------------------Other required virtual methods
 
 CanonicalGaussianMixture* CanonicalGaussianMixture::copy(const emdw::RVIds& newVars, bool presorted) const {
+	CanonicalGaussianMixture* cgm = new CanonicalGaussianMixture(*this);
+	
+	// Copy components onto new scope, the i-th old variable becomes newVars[i]
 	if (newVars.size()) {
-		std::vector<rcptr<Factor>> components;
-		for (rcptr<Factor> i : comps_) components.push_back( uniqptr<Factor> (i->copy(newVars, presorted) ) );
+		ASSERT( newVars.size() == vars_.size(), "Cannot copy " << vars_ << " onto " << newVars );
 
-		// Copy components onto new scope
-		return new CanonicalGaussianMixture(
-				newVars,
-				components,
-				true,
-				maxComp_,
-				threshold_,
-				unionDistance_,
-				inplaceNormalizer_,
-				normalizer_,
-				inplaceAbsorber_,
-				absorber_,
-				inplaceCanceller_,
-				canceller_,
-				marginalizer_,
-				observeAndReducer_,
-				inplaceDamper_);
-	} 
-	return new CanonicalGaussianMixture(*this);
+		if (presorted) cgm->vars_ = newVars;
+		else cgm->vars_ = sortScope(newVars, cgm->comps_);
+		cgm->moments_.invalidate();
+		cgm->generation_++;
+	}
+	
+	return cgm;
 } // copy()
 
 CanonicalGaussianMixture* CanonicalGaussianMixture::vacuousCopy(const emdw::RVIds& selectedVars, bool presorted) const {
@@ -550,179 +913,449 @@ std::istream& CanonicalGaussianMixture::txtRead(std::istream& file) { return fil
 
 //TODO: Complete this!!
 std::ostream& CanonicalGaussianMixture::txtWrite(std::ostream& file) const { 
-	std::vector<rcptr<Factor>> components = getComponents();
-	
-	for (unsigned i = 0; i < N_; i++) {
+	for (unsigned i = 0; i < comps_.size(); i++) {
 		file << "\n=========================\n";
 		file << "Component " << i << "\n";
-		file << *components[i] << "\n\n";
+		file << *getComponent(i).clone() << "\n\n";
 		file << "=========================\n";
 	}
 	
 	return file; 
 } // txtWrite()
 
+std::ostream& CanonicalGaussianMixture::binWrite(std::ostream& file) const {
+	writeBinaryHeader(file, "CGM ");
+	writeBinary(file, vars_);
+	writeBinary(file, (uint32_t) maxComp_);
+	writeBinary(file, threshold_);
+	writeBinary(file, unionDistance_);
+
+	return comps_.write(file);
+} // binWrite()
+
+std::istream& CanonicalGaussianMixture::binRead(std::istream& file) {
+	if (!readBinaryHeader(file, "CGM ")) return file;
+
+	// Read everything before changing the mixture.
+	emdw::RVIds vars;
+	uint32_t maxComp;
+	double threshold, unionDistance;
+	ComponentStore comps;
+	if (!readBinary(file, vars) || !readBinary(file, maxComp) || !readBinary(file, threshold)
+			|| !readBinary(file, unionDistance) || !comps.read(file)) {
+		return file;
+	} // if
+	ASSERT( comps.getDimension() == vars.size(), "The components are " << comps.getDimension()
+			<< " dimensional, the scope has " << vars.size() << " variables" );
+
+	vars_ = vars;
+	maxComp_ = maxComp;
+	threshold_ = threshold;
+	unionDistance_ = unionDistance;
+	comps_.swap(comps);
+	generation_++;
+
+	massesValid_ = false;
+	moments_.invalidate();
+
+	return file;
+} // binRead()
+
 //------------------ M-Projection
 
 uniqptr<Factor> CanonicalGaussianMixture::momentMatch() const {
-	unsigned M = comps_.size();
-	ASSERT( M != 0, "There must be at least one mixand" );
+	ASSERT( comps_.size() != 0, "There must be at least one mixand" );
 
-	if (M == 1) return uniqptr<Factor>( comps_[0]->copy() );
+	if (comps_.size() == 1) return getComponent(0).clone();
 
-	// Scope and dimension
-	unsigned dimension = vars_.size();
-	emdw::RVIds newVars(dimension);
-	for(unsigned i = 0; i < dimension; i++) newVars[i] = vars_[i];
+	const ComponentStore& matched = collapsed();
+	return uniqptr<Factor>(new GaussCanonical(vars_, matched.getK(0), matched.getH(0), matched.g(0), true));
+} // momentMatch()
 
-	// Determine the GM's total mass
-	double totalMass = getLogMass();
+uniqptr<Factor> CanonicalGaussianMixture::momentMatchCGM() const {
+	ASSERT( comps_.size() != 0, "There must be at least one mixand" );
 
-	// First and second central moments
-	ColVector<double> mean(dimension); mean.assignToAll(0.0);
-	Matrix<double> cov = gLinear::zeros<double>(dimension, dimension);
+	CanonicalGaussianMixture* cgm = new CanonicalGaussianMixture(vars_, true);
+	cgm->comps_.clear();
 
-	// Get the non-vacuous Gaussians' weights, means and covariances - Not very efficient, but whatever.
-	for (unsigned i = 0; i < M; i++) {
-		rcptr<Factor> factor = uniqptr<Factor>( comps_[i]->copy()  );
-		rcptr<GaussCanonical> gc = std::dynamic_pointer_cast<GaussCanonical>(factor);
+	if (comps_.size() == 1) cgm->comps_.append(comps_, 0);
+	else cgm->comps_.append(collapsed(), 0);
 
-		// Determine relative weight
-		double weight = exp( (gc->getLogMass()) - totalMass );
+	return uniqptr<Factor>(cgm);
+} // momentMatchCGM()
 
-		//std::cout << "momentMatch(), weight : " << weight << std::endl;
+rcptr<Factor> CanonicalGaussianMixture::momentMatch(StepArena& arena) const {
+	ASSERT( comps_.size() != 0, "There must be at least one mixand" );
 
-		// Get the mean and covariance
-		ColVector<double> mu = 1.0*(gc->getMean());
-		Matrix<double> S = 1.0*(gc->getCov());
+	const ComponentStore& matched = (comps_.size() == 1) ? comps_ : collapsed();
+	return arena.make<GaussCanonical>(vars_, matched.getK(0), matched.getH(0), matched.g(0), true);
+} // momentMatch()
 
-		mean += (weight)*(mu);
-		cov += (weight)*( S + (mu)*(mu.transpose()) );
-	} // for
-	cov -= (mean)*(mean.transpose());
+rcptr<Factor> CanonicalGaussianMixture::momentMatchCGM(StepArena& arena) const {
+	ASSERT( comps_.size() != 0, "There must be at least one mixand" );
 
-	rcptr<Factor> matched = uniqptr<Factor>(new GaussCanonical(newVars, mean, cov));
-	std::dynamic_pointer_cast<GaussCanonical>(matched)->adjustLogMass(totalMass);
+	rcptr<CanonicalGaussianMixture> cgm = arena.make<CanonicalGaussianMixture>(vars_, true);
+	cgm->comps_.clear();
 
-	return uniqptr<Factor>( matched->copy() );
-} // momentMatch()
+	if (comps_.size() == 1) cgm->comps_.append(comps_, 0);
+	else cgm->comps_.append(collapsed(), 0);
 
-uniqptr<Factor> CanonicalGaussianMixture::momentMatchCGM() const {
-	rcptr<Factor> matched = momentMatch();
-	return uniqptr<Factor> (new CanonicalGaussianMixture(matched->getVars(), {matched}, true));
+	return cgm;
 } // momentMatchCGM()
 
+const ComponentStore& CanonicalGaussianMixture::collapsed() const {
+	if (collapsed_.size() == 1 && collapsedGeneration_ == generation_) {
+		collapseHits_++;
+		return collapsed_;
+	} // if
+
+	collapseMisses_++;
+	collapsed_.reset(vars_.size());
+	matchMoments(collapsed_);
+	collapsedGeneration_ = generation_;
+
+	return collapsed_;
+} // collapsed()
+
+unsigned long CanonicalGaussianMixture::collapseHits() { return collapseHits_; } // collapseHits()
+
+unsigned long CanonicalGaussianMixture::collapseMisses() { return collapseMisses_; } // collapseMisses()
+
+void CanonicalGaussianMixture::resetCollapseCounters() {
+	collapseHits_ = 0;
+	collapseMisses_ = 0;
+} // resetCollapseCounters()
+
+void CanonicalGaussianMixture::matchMoments(ComponentStore& matched) const {
+	unsigned M = comps_.size();
+	unsigned dimension = vars_.size();
+
+	// First and raw second moments, on the stack for the tracker's dimensions
+	double fixedMean[kFixedMoments], fixedSecond[kFixedMoments*kFixedMoments], fixedWork[kFixedMoments*kFixedMoments];
+	std::vector<double> heap;
+	double* mean = fixedMean;
+	double* second = fixedSecond;
+	double* work = fixedWork;
+	if (dimension > kFixedMoments) {
+		heap.resize(dimension + 2*dimension*dimension);
+		mean = heap.data();
+		second = mean + dimension;
+		work = second + dimension*dimension;
+	} // if
+
+	// Reuse the cached masses, or determine them in the same pass
+	const double* cached = massesValid_ ? logMasses_.data() : 0;
+	logMasses_.resize(M);
+
+	double totalMass;
+	switch (dimension) {
+		case 2: totalMass = accumulateMoments<2>(comps_, moments_, cached, logMasses_.data(), dimension, mean, second); break;
+		case 6: totalMass = accumulateMoments<6>(comps_, moments_, cached, logMasses_.data(), dimension, mean, second); break;
+		case 8: totalMass = accumulateMoments<8>(comps_, moments_, cached, logMasses_.data(), dimension, mean, second); break;
+		default: totalMass = accumulateMoments<0>(comps_, moments_, cached, logMasses_.data(), dimension, mean, second);
+	} // switch
+
+	if (!cached) {
+		logMass_ = totalMass;
+		massesValid_ = true;
+	} // if
+
+	// Central second moment
+	for (unsigned r = 0; r < dimension; r++) {
+		for (unsigned c = 0; c < dimension; c++) second[r*dimension + c] -= mean[r]*mean[c];
+	} // for
+
+	unsigned k = matched.size();
+	matched.resize(k + 1);
+	if (!momentsToCanonical(mean, second, totalMass, dimension, 
+				matched.K(k), matched.h(k), matched.g(k), work)) {
+		printf("Could not invert the matched covariance at line number %d in file %s\n", __LINE__, __FILE__);
+	} // if
+} // matchMoments()
+
 void CanonicalGaussianMixture::pruneAndMerge() {
-	if (N_ > maxComp_) {
-		std::vector<rcptr<Factor>> reduced = pruneComponents(comps_, maxComp_, threshold_, false);
-		std::vector<rcptr<Factor>> merged =  mergeComponents(reduced, maxComp_, threshold_, unionDistance_);
-		
-		// Deep copy of vars
-		emdw::RVIds vars(vars_.size());
-		for (unsigned i = 0; i < vars_.size(); i++) vars[i] = vars_[i];
+	if (comps_.size() > maxComp_) {
+		updateMasses();
+		pruneComponents(comps_, logMasses_, maxComp_, threshold_, false, &moments_);
+		mergeComponents(comps_, logMasses_, maxComp_, threshold_, unionDistance_, &moments_);
+		logMass_ = logSumExp(logMasses_.data(), logMasses_.size());
+		generation_++;
+	} // if
+} //pruneAndMerge()
+
+void CanonicalGaussianMixture::reduce(FactorOperator* procPtr) {
+	if (procPtr) dynamicInplaceApply(procPtr, this);
+	else dynamicInplaceApply(ops_->inplaceReducer.get(), this);
+} // reduce()
+
+void CanonicalGaussianMixture::setReducer(const rcptr<FactorOperator>& reducer) {
+	ops_ = OperatorPolicy::derive(ops_, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			reducer ? reducer : defaultInplaceReducerCGM);
+} // setReducer()
+
+void CanonicalGaussianMixture::setSquareRoot(const bool squareRoot) {
+	moments_.setSquareRoot(squareRoot);
+	generation_++;
+} // setSquareRoot()
+
+bool CanonicalGaussianMixture::isSquareRoot() const {
+	return moments_.isSquareRoot();
+} // isSquareRoot()
+
+void CanonicalGaussianMixture::inplaceAbsorbAndReduce(const Factor* rhsPtr) {
+	const CanonicalGaussianMixture* rhsCGMPtr = dynamic_cast<const CanonicalGaussianMixture*>(rhsPtr);
+	unsigned N = rhsCGMPtr ? rhsCGMPtr->comps_.size() : 1;
+
+	// Nothing would be pruned or merged
+	if (comps_.size()*N <= maxComp_) {
+		inplaceAbsorb(rhsPtr);
+		return;
+	} // if
+
+	// Only pruning and merging can be fused with the product
+	if (!dynamic_cast<InplacePruneAndMergeCGM*>(ops_->inplaceReducer.get())) {
+		inplaceAbsorb(rhsPtr);
+		reduce();
+		return;
+	} // if
+
+	// If it isn't a CanonicalGaussianMixture it must be a GaussCanonical, pack it as a single component.
+	ComponentStore packed;
+	const ComponentStore* rhsComps = &packed;
+	emdw::RVIds rhsVars;
+
+	if (rhsCGMPtr) {
+		rhsVars = rhsCGMPtr->vars_;
+		if (rhsCGMPtr == this) packed = comps_;
+		else rhsComps = &(rhsCGMPtr->comps_);
+	} else {
+		rhsVars = packGaussCanonical(rhsPtr, packed);
+	} // if
+
+	std::vector<unsigned> lhsMap, rhsMap;
+	vars_ = scopeUnion(vars_, rhsVars, lhsMap, rhsMap);
+	embedComponents(comps_, vars_.size(), lhsMap);
+
+	absorbAndReduceComponents(comps_, *rhsComps, rhsMap, maxComp_, threshold_, unionDistance_, logMasses_);
+	moments_.invalidate();
+	generation_++;
+
+	// The full product is only formed if nothing had finite mass
+	massesValid_ = (logMasses_.size() == comps_.size());
+	if (massesValid_) logMass_ = logSumExp(logMasses_.data(), logMasses_.size());
+} // inplaceAbsorbAndReduce()
 
-		classSpecificConfigure( vars, 
-					merged, 
+void CanonicalGaussianMixture::inplaceAbsorbAndReduce(const std::vector<rcptr<Factor>>& absorbed,
+		const std::vector<rcptr<Factor>>& cancelled) {
+	for (const rcptr<Factor>& message : cancelled) inplaceCancel(message.get());
+	if (absorbed.empty()) return;
+
+	// Multiply the messages together, then reduce only once
+	uniqptr<Factor> product(absorbed[0]->copy());
+	for (unsigned i = 1; i < absorbed.size(); i++) product->inplaceAbsorb(absorbed[i].get());
+
+	inplaceAbsorbAndReduce(product.get());
+} // inplaceAbsorbAndReduce()
+
+std::vector<rcptr<Factor>> CanonicalGaussianMixture::observeAndReduce(const emdw::RVIds& variables,
+		const std::vector<ColVector<double>>& values, StepArena* arena) const {
+	std::vector<rcptr<Factor>> reduced(values.size());
+
+	// Split the scope into the unobserved and observed variables.
+	rcptr<const ScopePlan> plan = ScopePlan::get(vars_, variables);
+	emdw::RVIds vars = plan->remainingVars(vars_);
+
+	std::vector<std::vector<double>> observed(values.size(), std::vector<double>(plan->source().size()));
+	for (unsigned t = 0; t < values.size(); t++) {
+		for (unsigned k = 0; k < plan->source().size(); k++) observed[t][k] = values[t][plan->source()[k]];
+	} // for
+
+	// Introduce the evidence into each component, for each measurement
+	std::vector<ComponentStore> stores(values.size(), ComponentStore(vars.size()));
+	observeComponents(comps_, plan->remaining(), plan->selected(), observed, stores);
+
+	for (unsigned t = 0; t < values.size(); t++) {
+		rcptr<CanonicalGaussianMixture> cgm;
+		if (arena) cgm = arena->make<CanonicalGaussianMixture>(vars, true, maxComp_, threshold_, unionDistance_);
+		else cgm = uniqptr<CanonicalGaussianMixture>(new CanonicalGaussianMixture(vars, 
 					true,
 					maxComp_,
 					threshold_,
-					unionDistance_,
-					inplaceNormalizer_,
-					normalizer_,
-					inplaceAbsorber_,
-					absorber_,
-					inplaceCanceller_,
-					canceller_,
-					marginalizer_,
-					observeAndReducer_,
-					inplaceDamper_);
-	} // if
-} //pruneAndMerge()
+					unionDistance_));
+		cgm->ops_ = ops_;
+		cgm->moments_.setSquareRoot(moments_.isSquareRoot());
+		cgm->comps_.swap(stores[t]);
+		reduced[t] = cgm;
+	} // for
+
+	return reduced;
+} // observeAndReduce()
 
 //---------------- Adjust Mass
 
 void CanonicalGaussianMixture::adjustMass(const double mass) {
-	for (rcptr<Factor> c : comps_) std::dynamic_pointer_cast<GaussCanonical>(c)->adjustMass(mass);
+	double logMass = log(mass);
+	for (unsigned i = 0; i < comps_.size(); i++) comps_.g(i) += logMass;
+	generation_++;
+
+	// Shift the cached masses along
+	if (std::isinf(logMass)) {
+		massesValid_ = false;
+	} else if (massesValid_) {
+		for (double& m : logMasses_) m += logMass;
+		logMass_ += logMass;
+	} // if
 } // adjustMass()
 
+void CanonicalGaussianMixture::appendComponent(const ComponentView& component, const double logMass) {
+	ASSERT( vars_ == component.getVars(), vars_ << " != " << component.getVars()
+			<< ". All components must be distributions in " << vars_);
+
+	unsigned k = comps_.append(component.getStore(), component.getIndex());
+	comps_.g(k) += logMass;
+	moments_.invalidate(k);
+	massesValid_ = false;
+	generation_++;
+} // appendComponent()
+
+void CanonicalGaussianMixture::appendComponent(const Factor* component, const double logMass) {
+	ASSERT( vars_ == component->getVars(), vars_ << " != " << component->getVars()
+			<< ". All components must be distributions in " << vars_);
+
+	packGaussCanonical(component, comps_);
+	comps_.g(comps_.size() - 1) += logMass;
+	moments_.invalidate(comps_.size() - 1);
+	massesValid_ = false;
+	generation_++;
+} // appendComponent()
+
 //---------------- Useful get methods
 
-std::vector<rcptr<Factor>> CanonicalGaussianMixture::getComponents() const { 
+void CanonicalGaussianMixture::updateMasses() const {
+	if (massesValid_) return;
+
+	logMasses_.resize(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) logMasses_[i] = moments_.logMass(comps_, i);
+	logMass_ = logSumExp(logMasses_.data(), logMasses_.size());
+	massesValid_ = true;
+} // updateMasses()
+
+ComponentView CanonicalGaussianMixture::getComponent(const unsigned i) const {
+	return ComponentView(vars_, comps_, i, &moments_);
+} // getComponent()
+
+ComponentRange CanonicalGaussianMixture::components() const {
+	return ComponentRange(vars_, comps_, &moments_);
+} // components()
+
+std::vector<rcptr<Factor>> CanonicalGaussianMixture::cloneComponents() const { 
 	std::vector<rcptr<Factor>> components(comps_.size());
 
-	for (unsigned i = 0; i < comps_.size(); i++) components[i] = uniqptr<Factor>( comps_[i]->copy() );
+	for (unsigned i = 0; i < comps_.size(); i++) components[i] = unpackComponent(vars_, comps_, i);
 
 	return components; 
-} // getComponents()
+} // cloneComponents()
+
+std::vector<rcptr<Factor>> CanonicalGaussianMixture::getComponents() const { return cloneComponents(); } // getComponents()
 
-double CanonicalGaussianMixture::getNumberOfComponents() const { return N_; } // getNumberOfComponents()
+double CanonicalGaussianMixture::getNumberOfComponents() const { return comps_.size(); } // getNumberOfComponents()
 
 double CanonicalGaussianMixture::getMass() const {
 	double mass = getLogMass();
 	if (std::isinf(mass)) return 0;
-	return exp(getLogMass());
+	return exp(mass);
 } // getMass()
 
 double CanonicalGaussianMixture::getLogMass() const {
-	std::vector<double> masses;
-	
-	// Get the compnents logarithmic mass - ignoring all components with zero linear mass
-	for (unsigned i = 0; i < N_; i++) {
-		double mass= (std::dynamic_pointer_cast<GaussCanonical>(comps_[i]))->getLogMass();
-		if (!std::isinf(mass)) masses.push_back(mass);
-	} // for
-
-	// If the mixture has no mass - return 0
-	unsigned M = masses.size();
-	if (M == 0) return -std::numeric_limits<double>::infinity();
-	
-	// Else work out the mass
-	double maxMass= *std::max_element(masses.begin(), masses.end());
-	double linearSum = 0;
-
-	for (unsigned i = 0; i < M; i++) linearSum += exp(masses[i] - maxMass);
-	return maxMass + log(linearSum);
-} // getMass()
+	// Ignores all components with zero linear mass
+	updateMasses();
+	return logMass_;
+} // getLogMass()
 
+std::vector<double> CanonicalGaussianMixture::getLogWeights() const {
+	updateMasses();
+	return logMasses_;
+} // getLogWeights()
 
 std::vector<double> CanonicalGaussianMixture::getWeights() const {
-	std::vector<double> weights(comps_.size());
-	for (unsigned i = 0; i < comps_.size(); i++) {
-		weights[i]  = (std::dynamic_pointer_cast<GaussCanonical>(comps_[i]))->getMass() ;
-	} // for
+	updateMasses();
+	std::vector<double> weights(logMasses_.size());
+	expWeights(logMasses_.data(), weights.size(), weights.data());
 	return weights;
 } // getWeights()
 
 std::vector<ColVector<double>> CanonicalGaussianMixture::getMeans() const {
-	std::vector<ColVector<double>> means;
-	for (rcptr<Factor> c : comps_) means.push_back( (std::dynamic_pointer_cast<GaussCanonical>(c))->getMean() );
+	std::vector<ColVector<double>> means(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) means[i] = getComponent(i).getMean();
 	return means;
 } // getMeans()
 
 std::vector<Matrix<double>> CanonicalGaussianMixture::getCovs() const {
-	std::vector<Matrix<double>> covs;
-	for (rcptr<Factor> c : comps_) covs.push_back( (std::dynamic_pointer_cast<GaussCanonical>(c))->getCov() );
+	std::vector<Matrix<double>> covs(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) covs[i] = getComponent(i).getCov();
 	return covs;
 } // getCovs()
 
 std::vector<double> CanonicalGaussianMixture::getG() const {
-	std::vector<double> g;
-	for (rcptr<Factor> c : comps_) g.push_back( (std::dynamic_pointer_cast<GaussCanonical>(c))->getG() );
+	std::vector<double> g(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) g[i] = comps_.g(i);
 	return g;
 } // getG()
 
 std::vector<ColVector<double>> CanonicalGaussianMixture::getH() const {
-	std::vector<ColVector<double>> info;
-	for (rcptr<Factor> c : comps_) info.push_back( (std::dynamic_pointer_cast<GaussCanonical>(c))->getH() );
+	std::vector<ColVector<double>> info(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) info[i] = comps_.getH(i);
 	return info;
 } // getH()
 
 std::vector<Matrix<double>> CanonicalGaussianMixture::getK() const {
-	std::vector<Matrix<double>> prec;
-	for (rcptr<Factor> c : comps_) prec.push_back( (std::dynamic_pointer_cast<GaussCanonical>(c))->getK());
+	std::vector<Matrix<double>> prec(comps_.size());
+	for (unsigned i = 0; i < comps_.size(); i++) prec[i] = comps_.getK(i);
 	return prec;
 } // getK()
 
+//================================================== ComponentView
+
+double ComponentView::getLogMass() const {
+	if (moments_) return moments_->logMass(*comps_, i_);
+
+	unsigned dimension = vars_->size();
+	std::vector<double> work(dimension*(dimension + 1));
+	return canonicalLogMass(K(), h(), getG(), dimension, work.data());
+} // getLogMass()
+
+ColVector<double> ComponentView::getMean() const {
+	unsigned dimension = vars_->size();
+	std::vector<double> mu(dimension), work(dimension*dimension);
+
+	const double* muPtr = mu.data();
+	if (moments_ && moments_->update(*comps_, i_)) muPtr = moments_->mean(i_);
+	else canonicalMoments(K(), h(), dimension, mu.data(), 0, work.data());
+
+	ColVector<double> mean(dimension);
+	for (unsigned r = 0; r < dimension; r++) mean[r] = muPtr[r];
+	return mean;
+} // getMean()
+
+Matrix<double> ComponentView::getCov() const {
+	unsigned dimension = vars_->size();
+	std::vector<double> mu(dimension), S(dimension*dimension), work(dimension*dimension);
+
+	const double* SPtr = S.data();
+	if (moments_ && moments_->update(*comps_, i_)) SPtr = moments_->cov(i_);
+	else canonicalMoments(K(), h(), dimension, mu.data(), S.data(), work.data());
+
+	Matrix<double> cov = gLinear::zeros<double>(dimension, dimension);
+	for (unsigned r = 0; r < dimension; r++) {
+		for (unsigned c = 0; c < dimension; c++) cov(r, c) = SPtr[r*dimension + c];
+	} // for
+	return cov;
+} // getCov()
+
+uniqptr<Factor> ComponentView::clone() const {
+	return unpackComponent(*vars_, *comps_, i_);
+} // clone()
+
 //==================================================FactorOperators======================================
 
 //------------------Family 1: Normalization
@@ -734,30 +1367,20 @@ const std::string& InplaceNormalizeCGM::isA() const {
 
 void InplaceNormalizeCGM::inplaceProcess(CanonicalGaussianMixture* lhsPtr) {
 	CanonicalGaussianMixture& lhs(*lhsPtr);
-	std::vector<rcptr<Factor>> lhsComp = lhs.getComponents();
 
 	// Get the total mass
 	double totalMass = lhs.getLogMass();
 
 	// Divide through by the total mass
-	for (rcptr<Factor> c : lhsComp) std::dynamic_pointer_cast<GaussCanonical>(c)->adjustLogMass(-totalMass);
-
-	// Reconfigure
-	lhs.classSpecificConfigure(lhs.getVars(), 
-			lhsComp, 
-			true, 
-			lhs.maxComp_,
-			lhs.threshold_,
-			lhs.unionDistance_,
-			lhs.inplaceNormalizer_,
-			lhs.normalizer_,
-			lhs.inplaceAbsorber_,
-			lhs.absorber_,
-			lhs.inplaceCanceller_,
-			lhs.canceller_,
-			lhs.marginalizer_,
-			lhs.observeAndReducer_,
-			lhs.inplaceDamper_);
+	for (unsigned i = 0; i < lhs.comps_.size(); i++) lhs.comps_.g(i) -= totalMass;
+	lhs.generation_++;
+
+	if (std::isinf(totalMass)) {
+		lhs.massesValid_ = false;
+	} else {
+		for (double& m : lhs.logMasses_) m -= totalMass;
+		lhs.logMass_ = 0;
+	} // if
 } // inplaceProcess()
 
 const std::string& NormalizeCGM::isA() const {
@@ -792,46 +1415,53 @@ void InplaceAbsorbCGM::inplaceProcess(CanonicalGaussianMixture* lhsPtr, const Fa
 	CanonicalGaussianMixture& lhs(*lhsPtr);
 	const CanonicalGaussianMixture* rhsCGMPtr = dynamic_cast<const CanonicalGaussianMixture*>(rhsFPtr);
 	
-	// New components
-	std::vector<rcptr<Factor>> product; 
-	std::vector<rcptr<Factor>> lhsComps = lhs.getComponents();
-
-	// If it isn't a CanonicalGaussianMixture then GaussCanonical should do all the validation.
-	if (rhsCGMPtr){
-		const CanonicalGaussianMixture& rhs(*rhsCGMPtr);
-		std::vector<rcptr<Factor>> rhsComps = rhs.getComponents();
-
-		for (rcptr<Factor> i : lhsComps) {
-			for (rcptr<Factor> j : rhsComps) {
-				product.push_back(i->absorb(j));
-			}
-		}
-	} else { 
-		const GaussCanonical* rhsGCFPtr = dynamic_cast<const GaussCanonical*>(rhsFPtr);
-		const GaussCanonical& rhs(*rhsGCFPtr);
-		
-		product.resize(lhsComps.size());
-		for (unsigned i = 0; i < lhsComps.size(); i++)  product[i] = lhsComps[i]->absorb(uniqptr<Factor>( rhs.copy()  ));
+	// If it isn't a CanonicalGaussianMixture it must be a GaussCanonical, pack it as a single component.
+	ComponentStore packed;
+	const ComponentStore* rhsComps = &packed;
+	emdw::RVIds rhsVars;
+
+	if (rhsCGMPtr) {
+		rhsVars = rhsCGMPtr->vars_;
+		if (rhsCGMPtr == lhsPtr) packed = lhs.comps_; // Squaring, the multiplier has to be kept intact
+		else rhsComps = &(rhsCGMPtr->comps_);
+	} else {
+		rhsVars = packGaussCanonical(rhsFPtr, packed);
 	}
-	
-	emdw::RVIds vars = product[0]->getVars();
 
-	// Reconfigure the class
-	lhs.classSpecificConfigure(vars, 
-				product, 
-				true,
-				lhs.maxComp_,
-				lhs.threshold_,
-				lhs.unionDistance_,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_);
+	// The product's scope is the union of both scopes
+	std::vector<unsigned> lhsMap, rhsMap;
+	emdw::RVIds vars = scopeUnion(lhs.vars_, rhsVars, lhsMap, rhsMap);
+
+	// Over disjoint scopes the product's masses are simply the sums of the
+	// factors' masses, otherwise they are recomputed when next required.
+	bool disjoint = (vars.size() == lhs.vars_.size() + rhsVars.size());
+	if (disjoint && lhs.massesValid_) {
+		std::vector<double> rhsMasses;
+		if (rhsCGMPtr) {
+			rhsCGMPtr->updateMasses();
+			rhsMasses = rhsCGMPtr->logMasses_;
+		} else {
+			componentLogMasses(packed, rhsMasses);
+		} // if
+
+		std::vector<double> masses;
+		masses.reserve(lhs.logMasses_.size()*rhsMasses.size());
+		for (double l : lhs.logMasses_) for (double r : rhsMasses) masses.push_back(l + r);
+
+		lhs.logMasses_.swap(masses);
+		lhs.logMass_ = logSumExp(lhs.logMasses_.data(), lhs.logMasses_.size());
+		for (double m : lhs.logMasses_) if (std::isnan(m)) lhs.massesValid_ = false;
+	} else {
+		lhs.massesValid_ = false;
+	} // if
+
+	// Multiply every pair of components, reusing the existing storage
+	unsigned M = lhs.comps_.size();
+	lhs.vars_ = vars;
+	embedComponents(lhs.comps_, lhs.vars_.size(), lhsMap);
+	combineComponentsInplace(lhs.comps_, *rhsComps, rhsMap, 1.0);
+	lhs.moments_.combine(lhs.comps_, M, *rhsComps, rhsMap, 1.0);
+	lhs.generation_++;
 } // inplaceProcess()
 
 const std::string& AbsorbCGM::isA() const {
@@ -862,40 +1492,34 @@ void InplaceCancelCGM::inplaceProcess(CanonicalGaussianMixture* lhsPtr, const Fa
 	// Try cast the pointer to CanonicalGaussianMixture 
 	CanonicalGaussianMixture& lhs(*lhsPtr);
 	const CanonicalGaussianMixture* rhsCGMPtr = dynamic_cast<const CanonicalGaussianMixture*>(rhsFPtr);
-	const CanonicalGaussianMixture& rhs(*rhsCGMPtr); // Not very safe
 	
-	// New components
-	std::vector<rcptr<Factor>> lhsComps = lhs.getComponents();
-	rcptr<Factor> single;
+	// The divisor is approximated by a single Gaussian
+	ComponentStore single;
+	emdw::RVIds rhsVars;
 
-	//std::cout << "Dividend mixture: " << rhs << std::endl;
-	
-	// If it isn't a CanonicalGaussianMixture then GaussCanonical should do all the validation.
-	if (rhsCGMPtr) single = rhs.momentMatch();
-	else single = uniqptr<Factor>(rhsFPtr->copy());
-
-	//std::cout << "Dividend approximation: " << *single << std::endl;
+	// If it isn't a CanonicalGaussianMixture then it must be a GaussCanonical.
+	if (rhsCGMPtr) {
+		const CanonicalGaussianMixture& rhs(*rhsCGMPtr);
+		rhsVars = rhs.vars_;
+		single.reset(rhsVars.size());
 
-	// Divide through by a single GaussCanonical
-	std::vector<rcptr<Factor>> quotient; quotient.clear();
-	for (rcptr<Factor> i : lhsComps) { 
-		quotient.push_back( i->cancel(single)  ); 
-	} // for
+		if (rhs.comps_.size() == 1) single.append(rhs.comps_, 0);
+		else single.append(rhs.collapsed(), 0);
+	} else {
+		rhsVars = packGaussCanonical(rhsFPtr, single);
+	}
 
-	// Reconfigure the class
-	lhs.classSpecificConfigure(quotient[0]->getVars(), quotient, true,
-				lhs.maxComp_,
-				lhs.threshold_,
-				lhs.unionDistance_,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_);
+	// The quotient's scope is the union of both scopes
+	std::vector<unsigned> lhsMap, rhsMap;
+	lhs.vars_ = scopeUnion(lhs.vars_, rhsVars, lhsMap, rhsMap);
+
+	// Divide every component through by a single Gaussian
+	unsigned M = lhs.comps_.size();
+	embedComponents(lhs.comps_, lhs.vars_.size(), lhsMap);
+	combineComponentsInplace(lhs.comps_, single, rhsMap, -1.0);
+	lhs.massesValid_ = false;
+	lhs.moments_.combine(lhs.comps_, M, single, rhsMap, -1.0);
+	lhs.generation_++;
 } // inplaceCancel()
 
 const std::string& CancelCGM::isA() const {
@@ -929,31 +1553,27 @@ const std::string& MarginalizeCGM::isA() const {
 Factor* MarginalizeCGM::process(const CanonicalGaussianMixture* lhsPtr, const emdw::RVIds& variablesToKeep,
 		bool presorted) {
 	const CanonicalGaussianMixture& lhs(*lhsPtr);
-	std::vector<rcptr<Factor>> lhsComps = lhs.getComponents();
-	unsigned M = lhsComps.size();	
-	std::vector<rcptr<Factor>> result(M);
 
 	// If everything is marginalized out.
 	if (!variablesToKeep.size()) return new CanonicalGaussianMixture(variablesToKeep, true);
 
-	// Let GaussCanonical sort it all out for us.
-	for (unsigned i = 0; i < M; i++) result[i] = (lhsComps[i])->marginalize(variablesToKeep, presorted);
+	// Split the scope into the retained and discarded variables.
+	rcptr<const ScopePlan> plan = ScopePlan::get(lhs.vars_, variablesToKeep);
+	emdw::RVIds vars = plan->selectedVars(lhs.vars_);
 
-	return new CanonicalGaussianMixture(result[0]->getVars(), 
-				result, 
+	CanonicalGaussianMixture* cgm = new CanonicalGaussianMixture(vars, 
 				true,
 				lhs.maxComp_,
 				lhs.threshold_,
-				lhs.unionDistance_,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_ );
+				lhs.unionDistance_);
+	cgm->ops_ = lhs.ops_;
+	cgm->moments_.setSquareRoot(lhs.moments_.isSquareRoot());
+
+	// Marginalize each component.
+	cgm->comps_.reset(vars.size());
+	marginalizeComponents(lhs.comps_, plan->selected(), plan->remaining(), cgm->comps_);
+
+	return cgm;
 } // process()
 
 
@@ -967,30 +1587,30 @@ const std::string& ObserveAndReduceCGM::isA() const {
 Factor* ObserveAndReduceCGM::process(const CanonicalGaussianMixture* lhsPtr, const emdw::RVIds& variables,
 		const emdw::RVVals& assignedVals, bool presorted) {
 	const CanonicalGaussianMixture& lhs(*lhsPtr);
-	std::vector<rcptr<Factor>> lhsComps = lhs.getComponents();
-	std::vector<rcptr<Factor>> result; //result.clear();
 
 	// If nothing was observed.
 	if(!variables.size()) return lhs.copy(); 
 
-	// Let GaussCanonical sort it all out for us.
-	for (rcptr<Factor> c : lhsComps) result.push_back(c->observeAndReduce(variables, assignedVals, presorted));
+	// Split the scope into the unobserved and observed variables.
+	rcptr<const ScopePlan> plan = ScopePlan::get(lhs.vars_, variables);
+	emdw::RVIds vars = plan->remainingVars(lhs.vars_);
+
+	std::vector<double> values(plan->source().size());
+	for (unsigned k = 0; k < values.size(); k++) values[k] = static_cast<double>(assignedVals[plan->source()[k]]);
 
-	return new CanonicalGaussianMixture(result[0]->getVars(), 
-			        result, 
+	CanonicalGaussianMixture* cgm = new CanonicalGaussianMixture(vars, 
 				true,
 				lhs.maxComp_,
 				lhs.threshold_,
-				lhs.unionDistance_,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_ );
+				lhs.unionDistance_);
+	cgm->ops_ = lhs.ops_;
+	cgm->moments_.setSquareRoot(lhs.moments_.isSquareRoot());
+
+	// Introduce the evidence into each component.
+	cgm->comps_.reset(vars.size());
+	observeComponents(lhs.comps_, plan->remaining(), plan->selected(), values, cgm->comps_);
+
+	return cgm;
 } // process()
 
 
@@ -1006,6 +1626,32 @@ double InplaceWeakDampingCGM::inplaceProcess(const CanonicalGaussianMixture* lhs
 	return 0.0;
 } // inplaceProcess()
 
+//------------------Family 6: Reduction
+
+const std::string& InplacePruneAndMergeCGM::isA() const {
+	static const std::string CLASSNAME("InplacePruneAndMergeCGM");
+	return CLASSNAME;
+} // isA()
+
+void InplacePruneAndMergeCGM::inplaceProcess(CanonicalGaussianMixture* lhsPtr) {
+	lhsPtr->pruneAndMerge();
+} // inplaceProcess()
+
+const std::string& InplaceRunnallsReduceCGM::isA() const {
+	static const std::string CLASSNAME("InplaceRunnallsReduceCGM");
+	return CLASSNAME;
+} // isA()
+
+void InplaceRunnallsReduceCGM::inplaceProcess(CanonicalGaussianMixture* lhsPtr) {
+	CanonicalGaussianMixture& lhs(*lhsPtr);
+	if (lhs.comps_.size() <= lhs.maxComp_) return;
+
+	lhs.updateMasses();
+	runnallsReduceComponents(lhs.comps_, lhs.logMasses_, lhs.maxComp_, &lhs.moments_);
+	lhs.logMass_ = logSumExp(lhs.logMasses_.data(), lhs.logMasses_.size());
+	lhs.generation_++;
+} // inplaceProcess()
+
 //------------------ M-Projections
 
 uniqptr<Factor> mProject(const std::vector<rcptr<Factor>>& components) {
@@ -1064,172 +1710,429 @@ uniqptr<Factor> mProject(const std::vector<rcptr<Factor>>& components) {
 //------------------ Pruning and Merging
 
 std::vector<rcptr<Factor>> pruneComponents(const std::vector<rcptr<Factor>>& components, const unsigned maxComp, const double threshold, bool clip)  {
-	// Reduced components
-	std::vector<rcptr<Factor>> reduced; reduced.clear();
-	
-	// Mass
-	std::vector<double> originalMass; originalMass.clear();
-	std::vector<double> reducedMass; reducedMass.clear();
+	if (components.size() == 0) return components;
 
-	for (rcptr<Factor> c : components) {
-		double mass = std::dynamic_pointer_cast<GaussCanonical>(c)->getLogMass();
-		
-		originalMass.push_back(mass);
-		
-		if (mass > threshold && ~std::isinf(mass) && ~std::isnan(mass)) {
-			reduced.push_back( uniqptr<Factor>(c->copy()) );
-			reducedMass.push_back(mass);
-		} // if
-	} // for
+	// Pack, prune and unpack
+	emdw::RVIds vars = (components.back())->getVars();
+	ComponentStore packed(vars.size(), components.size());
+	for (rcptr<Factor> c : components) packGaussCanonical(c.get(), packed);
 
-	// If everything should is below threshold - just take the largest components
-	if (reduced.size() == 0) {
-		// Sort the original weights
+	std::vector<double> masses;
+	componentLogMasses(packed, masses);
+	pruneComponents(packed, masses, maxComp, threshold, clip);
 
-		std::vector<size_t> sortedIndices = sortIndices( originalMass, std::greater<double>() );
-		std::vector<rcptr<Factor>> newComps = extract<rcptr<Factor>>(components, sortedIndices);
+	std::vector<rcptr<Factor>> reduced(packed.size());
+	for (unsigned i = 0; i < packed.size(); i++) reduced[i] = unpackComponent(vars, packed, i);
 
-		// Only take the maxComp largest components
-		std::vector<rcptr<Factor>> clipped; clipped.clear();
-		for (unsigned i = 0; i < maxComp; i++) clipped.push_back( uniqptr<Factor> ( newComps[i]->copy() ) );
+	return reduced;
+} // pruneComponents()
 
-		// Return the reduced mixture
-		return clipped;
-	} // if
+void pruneComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, const double threshold, bool clip, ComponentMoments* moments) {
+	unsigned N = logMasses.size();
 
-	// If this is you only reduction technique and you still have too many components
-	if (clip && reduced.size() > maxComp) {
-		// Sort the original weights
-		std::vector<size_t> sortedIndices = sortIndices( reducedMass, std::greater<double>() );
-		std::vector<rcptr<Factor>> newComps = extract<rcptr<Factor>>(reduced, sortedIndices);
+	// Keep everything above the threshold, infinite masses are discarded by mergeComponents.
+	std::vector<unsigned> selected;
+	selected.reserve(N);
+	for (unsigned i = 0; i < N; i++) if (logMasses[i] > threshold) selected.push_back(i);
 
-		// Only take the maxComp largest components
-		std::vector<rcptr<Factor>> clipped; clipped.clear();
-		for (unsigned i = 0; i < maxComp; i++) clipped.push_back( uniqptr<Factor> ( newComps[i]->copy() ) );
+	// Nothing needs pruning
+	if (selected.size() == N && (!clip || N <= maxComp)) return;
 
-		// Return the reduced mixture
-		return clipped;
+	// If everything is below threshold - just take the largest components
+	if (selected.size() == 0) {
+		selected.resize(N);
+		for (unsigned i = 0; i < N; i++) selected[i] = i;
 	} // if
 
-	return reduced;
+	// If there are too many candidates only the largest are kept, largest first
+	unsigned L = selected.size();
+	if ( (L == N || clip) && L > maxComp ) {
+		std::partial_sort(selected.begin(), selected.begin() + maxComp, selected.end(), HeavierComponent(logMasses));
+		selected.resize(maxComp);
+	} // if
+
+	components.select(selected);
+	if (moments) moments->select(selected);
+
+	std::vector<double> keptMass(selected.size());
+	for (unsigned k = 0; k < selected.size(); k++) keptMass[k] = logMasses[selected[k]];
+	logMasses.swap(keptMass);
 } // pruneComponents()
 
 std::vector<rcptr<Factor>> mergeComponents(const std::vector<rcptr<Factor>>& components, const unsigned maxComp,
 		const double threshold, const double unionDistance) {
 	ASSERT( components.size() != 0, "There must be at least one mixand." );
 
-	// Deep copy of vars
-	emdw::RVIds oldVars = (components.back())->getVars();
-	unsigned Q = oldVars.size();
+	// Pack, merge and unpack
+	emdw::RVIds vars = (components.back())->getVars();
+	ComponentStore packed(vars.size(), components.size());
+	for (rcptr<Factor> c : components) packGaussCanonical(c.get(), packed);
+
+	std::vector<double> masses;
+	componentLogMasses(packed, masses);
+	mergeComponents(packed, masses, maxComp, threshold, unionDistance);
+
+	std::vector<rcptr<Factor>> merged(packed.size());
+	for (unsigned i = 0; i < packed.size(); i++) merged[i] = unpackComponent(vars, packed, i);
+
+	return merged;
+} // mergeComponents()
 
-	// Local variables
-	std::vector<rcptr<Factor>> merged; merged.clear();
-	std::vector<rcptr<Factor>> comps; comps.clear();
-	std::vector<double> masses; masses.clear();
+void mergeComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, const double threshold, const double unionDistance,
+		ComponentMoments* moments) {
+	ASSERT( components.size() != 0, "There must be at least one mixand." );
+	unsigned Q = components.getDimension();
+	const std::vector<double>& originalMass = logMasses;
 
-	// Get the mass and copy the factors
-	for (rcptr<Factor> c : components) {
-		rcptr<GaussCanonical> gc = std::dynamic_pointer_cast<GaussCanonical>(c);
-		if (!std::isinf(gc->getLogMass())) {
-			comps.push_back( uniqptr<Factor>( c->copy() ) );
-			masses.push_back( gc->getLogMass() );
-		}
-	} // for	
+	std::vector<unsigned> comps;
+	std::vector<double> masses;
+	for (unsigned i = 0; i < originalMass.size(); i++) {
+		if (!std::isinf(originalMass[i])) {
+			comps.push_back(i);
+			masses.push_back(originalMass[i]);
+		} // if
+	} // for
 
 	// If there is nothing of significant mass
-	if (comps.size() == 0) return components;
+	if (comps.size() == 0) return;
 
 	// Determine the total log mass of the mixture
-	double maxMass= *std::max_element(masses.begin(), masses.end());
-	double linearSum = 0;
-
-	for (unsigned i = 0; i < masses.size(); i++) linearSum += exp(masses[i] - maxMass);
-	double totalMass = maxMass + log(linearSum);
+	double totalMass = logSumExp(masses.data(), masses.size());
 
-	// Sort the components according to mass
+	// Sort the components according to mass and determine their moments
 	std::vector<size_t> sortedIndices = sortIndices( masses, std::greater<double>() );
-	std::vector<double> w = extract<double>( masses, sortedIndices );
-	std::vector<rcptr<Factor>> newComps = extract<rcptr<Factor>>(comps, sortedIndices);
-
-	// Merge closely spaced components
-	while ( !newComps.empty() ) {
-		// Dominant components mean
-		ColVector<double> mu_0 = 1.0*std::dynamic_pointer_cast<GaussCanonical>(newComps[0])->getMean();
-		unsigned L = w.size();
-
-		// Local variables
-		std::map<unsigned, bool> indices; 
-		ColVector<double> mu(Q); mu.assignToAll(0.0);
-		Matrix<double> S = gLinear::zeros<double>(Q, Q);
+	unsigned L = comps.size();
+
+	std::vector<unsigned> order(L);
+	std::vector<double> w(L), means(L*Q), covs(L*Q*Q), work(Q*Q);
+	for (unsigned i = 0; i < L; i++) {
+		order[i] = comps[sortedIndices[i]];
+		w[i] = masses[sortedIndices[i]];
+
+		if (moments && moments->update(components, order[i])) {
+			std::copy(moments->mean(order[i]), moments->mean(order[i]) + Q, means.begin() + i*Q);
+			std::copy(moments->cov(order[i]), moments->cov(order[i]) + Q*Q, covs.begin() + i*Q*Q);
+		} else {
+			canonicalMoments(components.K(order[i]), components.h(order[i]), Q, &means[i*Q], &covs[i*Q*Q], work.data());
+		} // if
+	} // for
+
+	// A component can only lie within the union distance if its mean lies within
+	// sqrt(unionDistance*lambda_max) <= sqrt(unionDistance*trace(S)) of the dominant mean.
+	std::vector<double> radii(L);
+	for (unsigned i = 0; i < L; i++) {
+		double trace = 0;
+		for (unsigned r = 0; r < Q; r++) trace += covs[i*Q*Q + r*Q + r];
+		radii[i] = sqrt(std::max(unionDistance*trace, 0.0))*(1 + 1e-9); // Rounding slack
+	} // for
+	ComponentIndex index(means, radii, Q);
+
+	// Relative masses
+	std::vector<double> weights(L);
+	relativeWeights(w.data(), L, totalMass, weights.data());
+
+	// Merge closely spaced components, the merged moments are only
+	// converted once the original components are no longer needed.
+	std::vector<double> mergedMeans, mergedCovs, mergedMass;
+	std::vector<bool> isMerged(L, false);
+	std::vector<double> mu(Q), S(Q*Q), diff(Q);
+	std::vector<unsigned> candidates;
+
+	for (unsigned k = 0; k < L; k++) {
+		if (isMerged[k]) continue;
+
+		// Dominant component's mean
+		const double* mu_0 = &means[k*Q];
+		std::fill(mu.begin(), mu.end(), 0.0);
+		std::fill(S.begin(), S.end(), 0.0);
 		double g = 0;
 
-		// Create a merged super Gaussian
-		for (unsigned i = 0; i < L; i++) {
-			rcptr<GaussCanonical> gc = std::dynamic_pointer_cast<GaussCanonical>( newComps[i]  );
-			if (gc->mahalanobis(mu_0) <= unionDistance) {
-				ColVector<double> mean = 1.0*(gc->getMean());
-				
-				double weight = exp(w[i] - totalMass); // Relative mass
+		// Create a merged super Gaussian from the nearby components, heaviest first
+		index.query(mu_0, candidates);
+		for (unsigned i : candidates) {
+			const double* mean = &means[i*Q];
+			const double* cov = &covs[i*Q*Q];
+			const double* K = components.K(order[i]);
+
+			// Mahalanobis distance of the dominant mean from this component
+			double distance = 0;
+			for (unsigned r = 0; r < Q; r++) diff[r] = mean[r] - mu_0[r];
+			for (unsigned r = 0; r < Q; r++) {
+				for (unsigned c = 0; c < Q; c++) distance += diff[r]*K[r*Q + c]*diff[c];
+			} // for
+
+			if (distance <= unionDistance) {
+				double weight = weights[i];
 				g += weight; // Linear sum of weights
-				mu += weight*(mean);
-				S += weight*( gc->getCov() + (mean - mu_0)*( (mean - mu_0).transpose() ) );
-				
-				indices[i] = true;
+
+				for (unsigned r = 0; r < Q; r++) {
+					mu[r] += weight*mean[r];
+					for (unsigned c = 0; c < Q; c++) S[r*Q + c] += weight*( cov[r*Q + c] + diff[r]*diff[c] );
+				} // for
+
+				isMerged[i] = true;
+				index.remove(i);
 			} // if
 		} // for
 
-		// Remove merged indices from the list -- Terrible method, but safe-ish.
-		std::vector<rcptr<Factor>> cTemp; cTemp.clear();
-		std::vector<double> wTemp; wTemp.clear();
-		for (unsigned i = 0; i < L; i++) {
-			if (!indices[i]) {
-				cTemp.push_back(uniqptr<Factor> (newComps[i]->copy()) );
-				wTemp.push_back(w[i]);
-			} // if
+		// Create a new Gaussian
+		for (unsigned r = 0; r < Q; r++) mu[r] /= g;
+		for (unsigned r = 0; r < Q*Q; r++) S[r] /= g;
+
+		mergedMeans.insert(mergedMeans.end(), mu.begin(), mu.end());
+		mergedCovs.insert(mergedCovs.end(), S.begin(), S.end());
+		mergedMass.push_back(totalMass + log(g)); // New log mass
+	} // for
+
+	// Overwrite the original components with the merged components
+	if (moments) moments->invalidate();
+	unsigned M = mergedMass.size();
+	components.resize(M);
+	work.resize(Q*(Q + 1));
+	for (unsigned m = 0; m < M; m++) {
+		if (!momentsToCanonical(&mergedMeans[m*Q], &mergedCovs[m*Q*Q], mergedMass[m], Q, 
+					components.K(m), components.h(m), components.g(m), work.data())) {
+			printf("Could not invert a merged covariance at line number %d in file %s\n", __LINE__, __FILE__);
+			mergedMass[m] = canonicalLogMass(components.K(m), components.h(m), components.g(m), Q, work.data());
+		} // if
+	} // for
+
+	// If there are still too many components select only the N largest components
+	if (M > maxComp) {
+		std::vector<size_t> sorted = sortIndices( mergedMass, std::greater<double>() );
+		std::vector<size_t> largest(sorted.begin(), sorted.begin() + maxComp);
+		components.select( std::vector<unsigned>(largest.begin(), largest.end()) );
+		mergedMass = extract<double>(mergedMass, largest);
+	} // if
+
+	logMasses.swap(mergedMass);
+} // mergeComponents()
+
+/**
+ * Runnalls' cost of merging two weighted Gaussians, given their covariances'
+ * log-determinants. Also returns the merged moments.
+ */
+static double runnallsCost(const double wi, const double* mui, const double* Si, const double logDeti,
+		const double wj, const double* muj, const double* Sj, const double logDetj,
+		const unsigned Q, double* mu, double* S, double* work) {
+	double w = wi + wj;
+	for (unsigned r = 0; r < Q; r++) mu[r] = (wi*mui[r] + wj*muj[r])/w;
+	for (unsigned r = 0; r < Q; r++) {
+		for (unsigned c = 0; c < Q; c++) {
+			S[r*Q + c] = (wi*Si[r*Q + c] + wj*Sj[r*Q + c])/w + wi*wj/(w*w)*(mui[r] - muj[r])*(mui[c] - muj[c]);
 		} // for
+	} // for
+
+	if (!choleskyDecompose(S, work, Q)) return std::numeric_limits<double>::infinity();
+	return 0.5*( w*choleskyLogDet(work, Q) - wi*logDeti - wj*logDetj );
+} // runnallsCost()
+
+void runnallsReduceComponents(ComponentStore& components, std::vector<double>& logMasses,
+		const unsigned maxComp, ComponentMoments* moments) {
+	unsigned Q = components.getDimension();
+
+	// Only components with finite mass take part
+	std::vector<unsigned> comps;
+	std::vector<double> masses;
+	for (unsigned i = 0; i < logMasses.size(); i++) {
+		if (!std::isinf(logMasses[i]) && !std::isnan(logMasses[i])) {
+			comps.push_back(i);
+			masses.push_back(logMasses[i]);
+		} // if
+	} // for
 
-		// Reassign temporary variables to local variables
-		newComps.clear(); w.clear();
-		for (unsigned i = 0 ; i < cTemp.size(); i++) {
-			newComps.push_back(uniqptr<Factor> (cTemp[i]->copy()) );
-			w.push_back(wTemp[i]);
+	unsigned L = comps.size();
+	if (L <= maxComp || L < 2) {
+		components.select(comps);
+		if (moments) moments->select(comps);
+		logMasses.swap(masses);
+		return;
+	} // if
+
+	// Relative weights, moments and covariance log-determinants
+	double totalMass = logSumExp(masses.data(), masses.size());
+	std::vector<double> w(L), means(L*Q), covs(L*Q*Q), logDets(L), work(Q*(Q + 1));
+	relativeWeights(masses.data(), L, totalMass, w.data());
+	for (unsigned i = 0; i < L; i++) {
+		unsigned k = comps[i];
+		if (moments && moments->update(components, k)) {
+			std::copy(moments->mean(k), moments->mean(k) + Q, means.begin() + i*Q);
+			std::copy(moments->cov(k), moments->cov(k) + Q*Q, covs.begin() + i*Q*Q);
+			logDets[i] = -moments->logDet(k);
+		} else {
+			canonicalMoments(components.K(k), components.h(k), Q, &means[i*Q], &covs[i*Q*Q], work.data());
+			choleskyDecompose(&covs[i*Q*Q], work.data(), Q);
+			logDets[i] = choleskyLogDet(work.data(), Q);
+		} // if
+	} // for
+
+	// Every pairwise cost, stale entries are recognised by the components' versions
+	typedef PairwiseMerge Merge;
+	std::priority_queue<Merge, std::vector<Merge>, std::greater<Merge>> queue;
+	std::vector<unsigned> version(L, 0);
+	std::vector<bool> alive(L, true);
+	std::vector<double> mu(Q), S(Q*Q);
+
+	for (unsigned i = 0; i < L; i++) {
+		for (unsigned j = i + 1; j < L; j++) {
+			double cost = runnallsCost(w[i], &means[i*Q], &covs[i*Q*Q], logDets[i],
+					w[j], &means[j*Q], &covs[j*Q*Q], logDets[j], Q, mu.data(), S.data(), work.data());
+			Merge merge = {cost, i, j, 0, 0};
+			queue.push(merge);
 		} // for
+	} // for
 
-		// Create a new Gaussian
-		emdw::RVIds newVars(Q);
-		for (unsigned i = 0; i < Q; i++) newVars[i] = oldVars[i];
-		ColVector<double> newMean = mu/g; Matrix<double> newS = S/g;
-		rcptr<Factor> scaled = uniqptr<Factor> (new GaussCanonical( newVars, newMean, newS, false ));
-
-		// Determine new log mass
-		double logMass = totalMass + log(g);
-		std::dynamic_pointer_cast<GaussCanonical>(scaled)->adjustLogMass(logMass);
-		
-		// Push the merged component back
-		merged.push_back( uniqptr<Factor>(scaled->copy()) );
-	} // while	
-
-	// If there are still too many components
-	if (merged.size() > maxComp) {
-		// Local variables
-		std::vector<rcptr<Factor>> sigComps; sigComps.clear();
-		std::vector<double> sigWeights; sigWeights.clear();
-		
-		// Extract weights and copy
-		for ( rcptr<Factor> c : merged ) {
-			sigComps.push_back( uniqptr<Factor> (c->copy() ) );
-			sigWeights.push_back( std::dynamic_pointer_cast<GaussCanonical>(c)->getLogMass() );
+	// Merge the cheapest pair into its first component until the budget is met
+	unsigned remaining = L;
+	while (remaining > maxComp && !queue.empty()) {
+		Merge merge = queue.top();
+		queue.pop();
+
+		unsigned i = merge.i, j = merge.j;
+		if (!alive[i] || !alive[j] || version[i] != merge.vi || version[j] != merge.vj) continue;
+		if (std::isinf(merge.cost)) break; // Only unmergeable pairs are left
+
+		runnallsCost(w[i], &means[i*Q], &covs[i*Q*Q], logDets[i],
+				w[j], &means[j*Q], &covs[j*Q*Q], logDets[j], Q, mu.data(), S.data(), work.data());
+		std::copy(mu.begin(), mu.end(), means.begin() + i*Q);
+		std::copy(S.begin(), S.end(), covs.begin() + i*Q*Q);
+		w[i] += w[j];
+		logDets[i] = choleskyLogDet(work.data(), Q);
+		version[i]++;
+		alive[j] = false;
+		remaining--;
+
+		// Only the merged component's costs change
+		for (unsigned k = 0; k < L; k++) {
+			if (!alive[k] || k == i) continue;
+
+			double cost = runnallsCost(w[i], &means[i*Q], &covs[i*Q*Q], logDets[i],
+					w[k], &means[k*Q], &covs[k*Q*Q], logDets[k], Q, mu.data(), S.data(), work.data());
+			Merge update = {cost, std::min(i, k), std::max(i, k), version[std::min(i, k)], version[std::max(i, k)]};
+			queue.push(update);
 		} // for
-		
-		// Sort according to weight
-		std::vector<size_t> sorted = sortIndices( sigWeights, std::greater<double>() );
-		std::vector<rcptr<Factor>> ordered = extract<rcptr<Factor>>(sigComps, sorted);
-		
-		// Select only the N largest components	
-		merged.clear();
-		for (unsigned i = 0; i < maxComp; i++) merged.push_back(ordered[i]);
+	} // while
+
+	// Overwrite the original components with the reduced components
+	if (moments) moments->invalidate();
+	components.resize(remaining);
+	logMasses.resize(remaining);
+
+	unsigned m = 0;
+	for (unsigned i = 0; i < L; i++) {
+		if (!alive[i]) continue;
+
+		logMasses[m] = totalMass + log(w[i]);
+		if (!momentsToCanonical(&means[i*Q], &covs[i*Q*Q], logMasses[m], Q,
+					components.K(m), components.h(m), components.g(m), work.data())) {
+			printf("Could not invert a merged covariance at line number %d in file %s\n", __LINE__, __FILE__);
+			logMasses[m] = canonicalLogMass(components.K(m), components.h(m), components.g(m), Q, work.data());
+		} // if
+		m++;
+	} // for
+} // runnallsReduceComponents()
+
+void absorbAndReduceComponents(ComponentStore& components, const ComponentStore& rhs,
+		const std::vector<unsigned>& rhsMap, const unsigned maxComp, const double threshold,
+		const double unionDistance, std::vector<double>& logMasses) {
+	ASSERT( &components != &rhs, "A store cannot be combined with itself in place" );
+	unsigned D = components.getDimension();
+	unsigned M = components.size(), N = rhs.size();
+
+	std::vector<double> K(D*D), h(D), work(D*(D + 1));
+	double g;
+
+	// Score every pair, only the maxComp heaviest are kept on a min-heap
+	typedef std::pair<double, unsigned> Candidate;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+	for (unsigned i = 0; i < M; i++) {
+		for (unsigned j = 0; j < N; j++) {
+			formProduct(components, i, rhs, j, rhsMap, K.data(), h.data(), g);
+			double mass = canonicalLogMass(K.data(), h.data(), g, D, work.data());
+			if (std::isinf(mass) || std::isnan(mass)) continue;
+
+			if (heap.size() < maxComp) {
+				heap.push(Candidate(mass, i*N + j));
+			} else if (mass > heap.top().first) {
+				heap.pop();
+				heap.push(Candidate(mass, i*N + j));
+			} // if
+		} // for
+	} // for
+
+	// If there is nothing of significant mass keep the full product
+	if (heap.empty()) {
+		combineComponentsInplace(components, rhs, rhsMap, 1.0);
+		logMasses.clear();
+		return;
 	} // if
 
-	return merged;
-} // mergeComponents()
+	// Heaviest first, everything below the threshold is pruned unless nothing is above it
+	std::vector<Candidate> kept(heap.size());
+	for (unsigned k = heap.size(); k-- > 0; heap.pop()) kept[k] = heap.top();
+
+	unsigned L = kept.size();
+	while (L > 1 && kept[L - 1].first <= threshold) L--;
+	double refMass = kept[0].first;
+
+	std::vector<double> weights(L);
+	for (unsigned k = 0; k < L; k++) weights[k] = kept[k].first;
+	relativeWeights(weights.data(), L, refMass, weights.data());
+
+	// Merge each product into the first merged Gaussian whose dominant mean is close enough
+	std::vector<double> dominant, mergedMeans, mergedCovs, mergedWeight;
+	std::vector<double> mean(D), cov(D*D), diff(D);
+	for (unsigned k = 0; k < L; k++) {
+		formProduct(components, kept[k].second/N, rhs, kept[k].second%N, rhsMap, K.data(), h.data(), g);
+		canonicalMoments(K.data(), h.data(), D, mean.data(), cov.data(), work.data());
+
+		unsigned C = mergedWeight.size(), m = C;
+		for (unsigned c = 0; c < C && m == C; c++) {
+			const double* mu_0 = &dominant[c*D];
+
+			// Mahalanobis distance of the dominant mean from this product
+			double distance = 0;
+			for (unsigned r = 0; r < D; r++) diff[r] = mean[r] - mu_0[r];
+			for (unsigned r = 0; r < D; r++) {
+				for (unsigned s = 0; s < D; s++) distance += diff[r]*K[r*D + s]*diff[s];
+			} // for
+
+			if (distance <= unionDistance) m = c;
+		} // for
+
+		// A new dominant component
+		if (m == C) {
+			dominant.insert(dominant.end(), mean.begin(), mean.end());
+			mergedMeans.resize((C + 1)*D, 0.0);
+			mergedCovs.resize((C + 1)*D*D, 0.0);
+			mergedWeight.push_back(0.0);
+			std::fill(diff.begin(), diff.end(), 0.0);
+		} // if
 
+		double weight = weights[k]; // Relative mass
+		mergedWeight[m] += weight;
+		for (unsigned r = 0; r < D; r++) {
+			mergedMeans[m*D + r] += weight*mean[r];
+			for (unsigned s = 0; s < D; s++) mergedCovs[(m*D + r)*D + s] += weight*( cov[r*D + s] + diff[r]*diff[s] );
+		} // for
+	} // for
+
+	// Only now are the lhs components no longer needed
+	unsigned C = mergedWeight.size();
+	components.resize(C);
+	logMasses.resize(C);
+	for (unsigned c = 0; c < C; c++) {
+		double w = mergedWeight[c];
+		for (unsigned r = 0; r < D; r++) mergedMeans[c*D + r] /= w;
+		for (unsigned r = 0; r < D*D; r++) mergedCovs[c*D*D + r] /= w;
+
+		logMasses[c] = refMass + log(w);
+		if (!momentsToCanonical(&mergedMeans[c*D], &mergedCovs[c*D*D], logMasses[c], D,
+					components.K(c), components.h(c), components.g(c), work.data())) {
+			printf("Could not invert a merged covariance at line number %d in file %s\n", __LINE__, __FILE__);
+			logMasses[c] = canonicalLogMass(components.K(c), components.h(c), components.g(c), D, work.data());
+		} // if
+	} // for
+} // absorbAndReduceComponents()
@@ -0,0 +1,132 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the spatial index over mixture component means.
+ *************************************************************************/
+#include <vector>
+#include <algorithm>
+#include "component_index.hpp"
+
+// Nodes with at most this many points are not split
+static const unsigned kLeafSize = 8;
+
+/**
+ * Orders point indices along one axis.
+ */
+struct CoordinateLess {
+	CoordinateLess(const std::vector<double>& points, const unsigned dim, const unsigned axis)
+		: points_(points), dim_(dim), axis_(axis) {}
+	bool operator()(const unsigned i, const unsigned j) const {
+		return points_[i*dim_ + axis_] < points_[j*dim_ + axis_];
+	}
+	const std::vector<double>& points_;
+	unsigned dim_, axis_;
+}; // CoordinateLess
+
+ComponentIndex::ComponentIndex(const std::vector<double>& points, const std::vector<double>& radii,
+		const unsigned dimension)
+	: dim_(dimension), points_(points), radii_(radii)
+{
+	unsigned N = radii.size();
+	order_.resize(N);
+	for (unsigned i = 0; i < N; i++) order_[i] = i;
+	leaf_.resize(N);
+	removed_.assign(N, false);
+
+	if (N) build(0, N, 0);
+} // Default constructor
+
+unsigned ComponentIndex::build(const unsigned begin, const unsigned end, const unsigned parent) {
+	unsigned n = nodes_.size();
+	Node node = {begin, end, 0, 0, parent, end - begin, 0.0};
+	nodes_.push_back(node);
+	lower_.resize((n + 1)*dim_);
+	upper_.resize((n + 1)*dim_);
+
+	// Bounding box and largest radius
+	double* lower = &lower_[n*dim_];
+	double* upper = &upper_[n*dim_];
+	for (unsigned r = 0; r < dim_; r++) lower[r] = upper[r] = points_[order_[begin]*dim_ + r];
+	for (unsigned k = begin; k < end; k++) {
+		unsigned i = order_[k];
+		for (unsigned r = 0; r < dim_; r++) {
+			lower[r] = std::min(lower[r], points_[i*dim_ + r]);
+			upper[r] = std::max(upper[r], points_[i*dim_ + r]);
+		} // for
+		nodes_[n].radius = std::max(nodes_[n].radius, radii_[i]);
+	} // for
+
+	if (end - begin <= kLeafSize) {
+		for (unsigned k = begin; k < end; k++) leaf_[order_[k]] = n;
+		return n;
+	} // if
+
+	// Split at the median of the widest axis
+	unsigned axis = 0;
+	for (unsigned r = 1; r < dim_; r++) {
+		if (upper[r] - lower[r] > upper_[n*dim_ + axis] - lower_[n*dim_ + axis]) axis = r;
+	} // for
+
+	unsigned mid = (begin + end)/2;
+	std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+			CoordinateLess(points_, dim_, axis));
+
+	unsigned left = build(begin, mid, n);
+	unsigned right = build(mid, end, n);
+	nodes_[n].left = left;
+	nodes_[n].right = right;
+
+	return n;
+} // build()
+
+void ComponentIndex::query(const double* centre, std::vector<unsigned>& found) const {
+	found.clear();
+	if (nodes_.empty()) return;
+
+	query(0, centre, found);
+	std::sort(found.begin(), found.end());
+} // query()
+
+void ComponentIndex::query(const unsigned n, const double* centre, std::vector<unsigned>& found) const {
+	const Node& node = nodes_[n];
+	if (node.alive == 0) return;
+
+	// Distance from the centre to the bounding box
+	double distance = 0;
+	for (unsigned r = 0; r < dim_; r++) {
+		double c = centre[r];
+		double d = std::max(std::max(lower_[n*dim_ + r] - c, c - upper_[n*dim_ + r]), 0.0);
+		distance += d*d;
+	} // for
+	if (distance > node.radius*node.radius) return;
+
+	if (node.left == 0) {
+		for (unsigned k = node.begin; k < node.end; k++) {
+			unsigned i = order_[k];
+			if (removed_[i]) continue;
+
+			distance = 0;
+			for (unsigned r = 0; r < dim_; r++) {
+				double d = points_[i*dim_ + r] - centre[r];
+				distance += d*d;
+			} // for
+			if (distance <= radii_[i]*radii_[i]) found.push_back(i);
+		} // for
+		return;
+	} // if
+
+	query(node.left, centre, found);
+	query(node.right, centre, found);
+} // query()
+
+void ComponentIndex::remove(const unsigned i) {
+	if (removed_[i]) return;
+	removed_[i] = true;
+
+	for (unsigned n = leaf_[i]; ; n = nodes_[n].parent) {
+		nodes_[n].alive--;
+		if (n == 0) break;
+	} // for
+} // remove()
@@ -0,0 +1,894 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the packed component storage and the dense kernels
+ * operating on it.
+ *************************************************************************/
+#include <vector>
+#include <iostream>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+#include <string.h>
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "fixed_gaussian.hpp"
+#include "binary_io.hpp"
+#include "component_store.hpp"
+
+// Relative pivot size below which a precision is treated as singular
+static const double kPivotTolerance = 1e-10;
+
+ComponentStore::ComponentStore(const unsigned dimension, const unsigned capacity)
+	: dim_(dimension), N_(0)
+{
+	reserve(capacity);
+} // Default constructor
+
+void ComponentStore::reserve(const unsigned capacity) {
+	K_.reserve(capacity*dim_*dim_);
+	h_.reserve(capacity*dim_);
+	g_.reserve(capacity);
+} // reserve()
+
+void ComponentStore::resize(const unsigned N) {
+	if (N*dim_*dim_ > K_.size()) K_.resize(N*dim_*dim_);
+	if (N*dim_ > h_.size()) h_.resize(N*dim_);
+	if (N > g_.size()) g_.resize(N);
+	N_ = N;
+} // resize()
+
+void ComponentStore::reset(const unsigned dimension) {
+	dim_ = dimension;
+	N_ = 0;
+} // reset()
+
+void ComponentStore::swap(ComponentStore& other) {
+	std::swap(dim_, other.dim_);
+	std::swap(N_, other.N_);
+	K_.swap(other.K_);
+	h_.swap(other.h_);
+	g_.swap(other.g_);
+} // swap()
+
+unsigned ComponentStore::append(const double* K, const double* h, const double g) {
+	unsigned i = N_;
+	resize(N_ + 1);
+
+	memcpy(this->K(i), K, dim_*dim_*sizeof(double));
+	memcpy(this->h(i), h, dim_*sizeof(double));
+	g_[i] = g;
+
+	return i;
+} // append()
+
+unsigned ComponentStore::append(const Matrix<double>& K, const ColVector<double>& h, const double g) {
+	unsigned i = N_;
+	resize(N_ + 1);
+
+	double* KPtr = this->K(i);
+	double* hPtr = this->h(i);
+	for (unsigned r = 0; r < dim_; r++) {
+		hPtr[r] = h[r];
+		for (unsigned c = 0; c < dim_; c++) KPtr[r*dim_ + c] = K(r, c);
+	} // for
+	g_[i] = g;
+
+	return i;
+} // append()
+
+unsigned ComponentStore::append(const ComponentStore& other, const unsigned i) {
+	ASSERT( other.dim_ == dim_, "Cannot append a " << other.dim_ <<
+			" dimensional component to a " << dim_ << " dimensional store" );
+	if (&other != this) return append(other.K(i), other.h(i), other.g(i));
+
+	// Grow first, a reallocation would invalidate component i.
+	unsigned k = N_;
+	resize(N_ + 1);
+
+	memcpy(K(k), K(i), dim_*dim_*sizeof(double));
+	memcpy(h(k), h(i), dim_*sizeof(double));
+	g_[k] = g_[i];
+
+	return k;
+} // append()
+
+void ComponentStore::select(const std::vector<unsigned>& indices) {
+	unsigned M = indices.size();
+	bool increasing = true;
+	for (unsigned i = 1; i < M && increasing; i++) increasing = indices[i - 1] < indices[i];
+
+	// Compact in place, a component never moves to a later slot.
+	if (increasing) {
+		for (unsigned i = 0; i < M; i++) {
+			unsigned j = indices[i];
+			if (i == j) continue;
+			memcpy(K(i), K(j), dim_*dim_*sizeof(double));
+			memcpy(h(i), h(j), dim_*sizeof(double));
+			g_[i] = g_[j];
+		} // for
+		N_ = M;
+		return;
+	} // if
+
+	// Repeated components have to be copied out.
+	std::vector<unsigned> sorted(indices);
+	std::sort(sorted.begin(), sorted.end());
+	if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+		ComponentStore selected(dim_, M);
+		for (unsigned i : indices) selected.append(*this, i);
+		swap(selected);
+		return;
+	} // if
+
+	// Otherwise compact in increasing order, then permute in place one cycle at a time.
+	select(sorted);
+
+	std::vector<unsigned> source(M);
+	for (unsigned i = 0; i < M; i++) {
+		source[i] = std::lower_bound(sorted.begin(), sorted.end(), indices[i]) - sorted.begin();
+	} // for
+
+	std::vector<bool> placed(M, false);
+	std::vector<double> tempK(dim_*dim_), tempH(dim_);
+	for (unsigned start = 0; start < M; start++) {
+		if (placed[start] || source[start] == start) continue;
+
+		memcpy(tempK.data(), K(start), dim_*dim_*sizeof(double));
+		memcpy(tempH.data(), h(start), dim_*sizeof(double));
+		double tempG = g_[start];
+
+		unsigned i = start;
+		while (source[i] != start) {
+			unsigned j = source[i];
+			memcpy(K(i), K(j), dim_*dim_*sizeof(double));
+			memcpy(h(i), h(j), dim_*sizeof(double));
+			g_[i] = g_[j];
+			placed[i] = true;
+			i = j;
+		} // while
+
+		memcpy(K(i), tempK.data(), dim_*dim_*sizeof(double));
+		memcpy(h(i), tempH.data(), dim_*sizeof(double));
+		g_[i] = tempG;
+		placed[i] = true;
+	} // for
+} // select()
+
+Matrix<double> ComponentStore::getK(const unsigned i) const {
+	Matrix<double> K = gLinear::zeros<double>(dim_, dim_);
+	const double* KPtr = this->K(i);
+	for (unsigned r = 0; r < dim_; r++) {
+		for (unsigned c = 0; c < dim_; c++) K(r, c) = KPtr[r*dim_ + c];
+	} // for
+	return K;
+} // getK()
+
+ColVector<double> ComponentStore::getH(const unsigned i) const {
+	ColVector<double> h(dim_);
+	const double* hPtr = this->h(i);
+	for (unsigned r = 0; r < dim_; r++) h[r] = hPtr[r];
+	return h;
+} // getH()
+
+std::ostream& ComponentStore::write(std::ostream& file) const {
+	writeBinary(file, (uint32_t) dim_);
+	writeBinary(file, (uint32_t) N_);
+	writeBinary(file, K_.data(), N_*dim_*dim_);
+	writeBinary(file, h_.data(), N_*dim_);
+	writeBinary(file, g_.data(), N_);
+
+	return file;
+} // write()
+
+std::istream& ComponentStore::read(std::istream& file) {
+	uint32_t dimension, N;
+	if (!readBinary(file, dimension) || !readBinary(file, N)) return file;
+
+	// The packed arrays are indexed with unsigned offsets
+	if (dimension > 0xFFFF || (uint64_t) N*dimension*dimension > 0xFFFFFFFF) {
+		file.setstate(std::ios::failbit);
+		return file;
+	} // if
+
+	reset(dimension);
+	if (!readBinary(file, K_, (size_t) N*dim_*dim_) || !readBinary(file, h_, (size_t) N*dim_)
+			|| !readBinary(file, g_, N)) {
+		return file;
+	} // if
+	N_ = N;
+
+	return file;
+} // read()
+
+//------------------ ComponentMoments
+
+void ComponentMoments::select(const std::vector<unsigned>& indices) {
+	unsigned D = dim_;
+
+	// Increasing indices are compacted in place, as in ComponentStore::select
+	bool increasing = true;
+	for (unsigned k = 1; k < indices.size() && increasing; k++) increasing = (indices[k] > indices[k - 1]);
+
+	if (increasing) {
+		for (unsigned k = 0; k < indices.size(); k++) {
+			unsigned i = indices[k];
+			if (i >= state_.size()) {
+				state_.resize(k);
+				break;
+			} // if
+
+			state_[k] = state_[i];
+			if (i == k || state_[i] != kValid) continue;
+
+			std::copy(mean_.begin() + i*D, mean_.begin() + (i + 1)*D, mean_.begin() + k*D);
+			std::copy(cov_.begin() + i*D*D, cov_.begin() + (i + 1)*D*D, cov_.begin() + k*D*D);
+			std::copy(chol_.begin() + i*D*D, chol_.begin() + (i + 1)*D*D, chol_.begin() + k*D*D);
+			logDet_[k] = logDet_[i];
+		} // for
+
+		if (state_.size() > indices.size()) state_.resize(indices.size());
+		return;
+	} // if
+
+	std::vector<char> state(indices.size(), kUnknown);
+	std::vector<double> mean(indices.size()*D), cov(indices.size()*D*D), chol(indices.size()*D*D);
+	std::vector<double> logDet(indices.size());
+
+	for (unsigned k = 0; k < indices.size(); k++) {
+		unsigned i = indices[k];
+		if (i >= state_.size() || state_[i] == kUnknown) continue;
+
+		state[k] = state_[i];
+		if (state_[i] != kValid) continue;
+
+		std::copy(mean_.begin() + i*D, mean_.begin() + (i + 1)*D, mean.begin() + k*D);
+		std::copy(cov_.begin() + i*D*D, cov_.begin() + (i + 1)*D*D, cov.begin() + k*D*D);
+		std::copy(chol_.begin() + i*D*D, chol_.begin() + (i + 1)*D*D, chol.begin() + k*D*D);
+		logDet[k] = logDet_[i];
+	} // for
+
+	state_.swap(state);
+	mean_.swap(mean);
+	cov_.swap(cov);
+	chol_.swap(chol);
+	logDet_.swap(logDet);
+} // select()
+
+bool ComponentMoments::update(const ComponentStore& components, const unsigned i) {
+	unsigned D = components.getDimension();
+
+	// A change of scope invalidates everything
+	if (D != dim_) {
+		dim_ = D;
+		state_.clear();
+	} // if
+
+	grow(components.size());
+
+	if (state_[i] == kUnknown) {
+		double* L = chol_.data() + i*D*D;
+		bool factored = squareRoot_ ? choleskyDecomposeRegularised(components.K(i), L, D, kPivotTolerance)
+				: choleskyDecompose(components.K(i), L, D);
+		if (factored) {
+			choleskySolve(L, components.h(i), mean_.data() + i*D, D);
+			choleskyInverse(L, cov_.data() + i*D*D, D);
+			logDet_[i] = choleskyLogDet(L, D);
+			state_[i] = kValid;
+		} else {
+			state_[i] = kSingular;
+		} // if
+	} // if
+
+	return state_[i] == kValid;
+} // update()
+
+void ComponentMoments::grow(const unsigned N) {
+	unsigned D = dim_;
+	if (state_.size() >= N) return;
+
+	state_.resize(N, kUnknown);
+	mean_.resize(N*D);
+	cov_.resize(N*D*D);
+	chol_.resize(N*D*D);
+	logDet_.resize(N);
+} // grow()
+
+double ComponentMoments::logMass(const ComponentStore& components, const unsigned i) {
+	if (!update(components, i)) return std::numeric_limits<double>::infinity();
+
+	unsigned D = dim_;
+	const double* h = components.h(i);
+	const double* x = mean(i);
+
+	double quad = 0;
+	for (unsigned r = 0; r < D; r++) quad += h[r]*x[r];
+
+	return components.g(i) + 0.5*( D*log(2*M_PI) - logDet_[i] + quad );
+} // logMass()
+
+void ComponentMoments::combine(const ComponentStore& components, const unsigned M, const ComponentStore& rhs,
+		const std::vector<unsigned>& rhsMap, const double sign) {
+	unsigned D = components.getDimension(), Q = rhs.getDimension();
+	unsigned N = rhs.size();
+
+	// Only factors over the same scope can be carried over
+	if (!squareRoot_ || D != dim_ || components.size() != M*N) {
+		invalidate();
+		return;
+	} // if
+
+	// Every rhs precision as a sum of outer products
+	std::vector<double> V(N*Q*Q), work(Q*Q);
+	std::vector<unsigned> rank(N);
+	for (unsigned j = 0; j < N; j++) rank[j] = semidefiniteFactor(rhs.K(j), &V[j*Q*Q], Q, work.data());
+
+	// As in combineComponentsInplace, slot i is only overwritten once it has been copied
+	grow(M);
+	grow(M*N);
+	std::vector<double> x(D), Sx(D);
+	for (unsigned i = M; i-- > 0; ) {
+		for (unsigned j = N; j-- > 0; ) {
+			unsigned k = i*N + j;
+			if (k != i) {
+				state_[k] = state_[i];
+				if (state_[i] == kValid) {
+					std::copy(cov_.begin() + i*D*D, cov_.begin() + (i + 1)*D*D, cov_.begin() + k*D*D);
+					std::copy(chol_.begin() + i*D*D, chol_.begin() + (i + 1)*D*D, chol_.begin() + k*D*D);
+				} // if
+			} // if
+
+			// A singular component may have become proper
+			if (state_[k] != kValid) {
+				state_[k] = kUnknown;
+				continue;
+			} // if
+
+			double* L = chol_.data() + k*D*D;
+			double* S = cov_.data() + k*D*D;
+			bool valid = true;
+			for (unsigned v = 0; v < rank[j] && valid; v++) {
+				const double* u = &V[j*Q*Q + v*Q];
+				std::fill(x.begin(), x.end(), 0.0);
+				for (unsigned r = 0; r < Q; r++) x[rhsMap[r]] = u[r];
+
+				// (K + xx')^{-1} = S - Sx(Sx)'/(1 + x'Sx)
+				if (sign > 0) {
+					double q = 0;
+					for (unsigned r = 0; r < D; r++) {
+						double t = 0;
+						for (unsigned c = 0; c < Q; c++) t += S[r*D + rhsMap[c]]*u[c];
+						Sx[r] = t;
+						q += x[r]*t;
+					} // for
+
+					double scale = 1.0/(1.0 + q);
+					for (unsigned r = 0; r < D; r++) {
+						for (unsigned c = 0; c < D; c++) S[r*D + c] -= scale*Sx[r]*Sx[c];
+					} // for
+				} // if
+
+				valid = choleskyRankOne(L, x.data(), D, sign);
+			} // for
+
+			if (!valid) {
+				state_[k] = kUnknown;
+				continue;
+			} // if
+
+			// The downdated covariance is determined afresh, Sherman-Morrison is unstable here
+			if (sign < 0) choleskyInverse(L, S, D);
+			choleskySolve(L, components.h(k), mean_.data() + k*D, D);
+			logDet_[k] = choleskyLogDet(L, D);
+		} // for
+	} // for
+
+	if (state_.size() > M*N) state_.resize(M*N);
+} // combine()
+
+//------------------ Dense kernels
+//
+// The tracker's 2, 6 and 8 dimensional scopes are handed to the
+// fixed dimension kernels in fixed_gaussian.hpp.
+
+bool choleskyDecompose(const double* A, double* L, const unsigned d) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::choleskyDecompose(A, L);
+		case 6: return FixedGaussian<6>::choleskyDecompose(A, L);
+		case 8: return FixedGaussian<8>::choleskyDecompose(A, L);
+	} // switch
+
+	for (unsigned j = 0; j < d; j++) {
+		double s = A[j*d + j];
+		for (unsigned k = 0; k < j; k++) s -= L[j*d + k]*L[j*d + k];
+		if (!(s > 0)) return false;
+
+		double Ljj = sqrt(s);
+		L[j*d + j] = Ljj;
+		for (unsigned i = j + 1; i < d; i++) {
+			double t = A[i*d + j];
+			for (unsigned k = 0; k < j; k++) t -= L[i*d + k]*L[j*d + k];
+			L[i*d + j] = t/Ljj;
+			L[j*d + i] = 0.0;
+		} // for
+	} // for
+	return true;
+} // choleskyDecompose()
+
+void choleskySolve(const double* L, const double* b, double* x, const unsigned d) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::choleskySolve(L, b, x);
+		case 6: return FixedGaussian<6>::choleskySolve(L, b, x);
+		case 8: return FixedGaussian<8>::choleskySolve(L, b, x);
+	} // switch
+
+	// Forward substitution, Lz = b
+	for (unsigned i = 0; i < d; i++) {
+		double s = b[i];
+		for (unsigned k = 0; k < i; k++) s -= L[i*d + k]*x[k];
+		x[i] = s/L[i*d + i];
+	} // for
+
+	// Back substitution, L'x = z
+	for (unsigned i = d; i-- > 0; ) {
+		double s = x[i];
+		for (unsigned k = i + 1; k < d; k++) s -= L[k*d + i]*x[k];
+		x[i] = s/L[i*d + i];
+	} // for
+} // choleskySolve()
+
+void choleskyInverse(const double* L, double* inverse, const unsigned d) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::choleskyInverse(L, inverse);
+		case 6: return FixedGaussian<6>::choleskyInverse(L, inverse);
+		case 8: return FixedGaussian<8>::choleskyInverse(L, inverse);
+	} // switch
+
+	// Solve for each column of the identity, the result is symmetric.
+	for (unsigned j = 0; j < d; j++) {
+		double* col = inverse + j*d;
+		for (unsigned i = 0; i < d; i++) col[i] = (i == j) ? 1.0 : 0.0;
+		choleskySolve(L, col, col, d);
+	} // for
+} // choleskyInverse()
+
+double choleskyLogDet(const double* L, const unsigned d) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::choleskyLogDet(L);
+		case 6: return FixedGaussian<6>::choleskyLogDet(L);
+		case 8: return FixedGaussian<8>::choleskyLogDet(L);
+	} // switch
+
+	double logDet = 0;
+	for (unsigned i = 0; i < d; i++) logDet += log(L[i*d + i]);
+	return 2*logDet;
+} // choleskyLogDet()
+
+void choleskyForward(const double* L, const double* b, double* x, const unsigned d) {
+	for (unsigned i = 0; i < d; i++) {
+		double s = b[i];
+		for (unsigned k = 0; k < i; k++) s -= L[i*d + k]*x[k];
+		x[i] = s/L[i*d + i];
+	} // for
+} // choleskyForward()
+
+bool choleskyDecomposeRegularised(const double* A, double* L, const unsigned d, const double tolerance) {
+	for (unsigned j = 0; j < d; j++) {
+		double a = A[j*d + j];
+		if (!(a > 0)) return false;
+
+		double s = a;
+		for (unsigned k = 0; k < j; k++) s -= L[j*d + k]*L[j*d + k];
+		if (s < -tolerance*a) return false;
+		if (s < tolerance*a) s = tolerance*a;
+
+		double Ljj = sqrt(s);
+		L[j*d + j] = Ljj;
+		for (unsigned i = j + 1; i < d; i++) {
+			double t = A[i*d + j];
+			for (unsigned k = 0; k < j; k++) t -= L[i*d + k]*L[j*d + k];
+			L[i*d + j] = t/Ljj;
+			L[j*d + i] = 0.0;
+		} // for
+	} // for
+	return true;
+} // choleskyDecomposeRegularised()
+
+bool choleskyRankOne(double* L, double* x, const unsigned d, const double sign) {
+	for (unsigned k = 0; k < d; k++) {
+		double Lkk = L[k*d + k];
+		double r2 = Lkk*Lkk + sign*x[k]*x[k];
+		if (!(r2 > 0)) return false;
+
+		double r = sqrt(r2);
+		double c = r/Lkk, s = x[k]/Lkk;
+		L[k*d + k] = r;
+		for (unsigned i = k + 1; i < d; i++) {
+			double Lik = (L[i*d + k] + sign*s*x[i])/c;
+			x[i] = c*x[i] - s*Lik;
+			L[i*d + k] = Lik;
+		} // for
+	} // for
+	return true;
+} // choleskyRankOne()
+
+unsigned semidefiniteFactor(const double* A, double* V, const unsigned d, double* work) {
+	std::copy(A, A + d*d, work);
+
+	double largest = 0;
+	for (unsigned i = 0; i < d; i++) largest = std::max(largest, A[i*d + i]);
+
+	unsigned rank = 0;
+	for (; rank < d; rank++) {
+		// Pivot on the largest remaining diagonal entry
+		unsigned p = 0;
+		for (unsigned i = 1; i < d; i++) if (work[i*d + i] > work[p*d + p]) p = i;
+
+		double pivot = work[p*d + p];
+		if (!(pivot > kPivotTolerance*largest)) break;
+
+		double* v = V + rank*d;
+		double scale = 1.0/sqrt(pivot);
+		for (unsigned i = 0; i < d; i++) v[i] = work[i*d + p]*scale;
+		for (unsigned i = 0; i < d; i++) {
+			for (unsigned j = 0; j < d; j++) work[i*d + j] -= v[i]*v[j];
+		} // for
+	} // for
+
+	return rank;
+} // semidefiniteFactor()
+
+double canonicalLogMass(const double* K, const double* h, const double g, const unsigned d, double* work) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::canonicalLogMass(K, h, g);
+		case 6: return FixedGaussian<6>::canonicalLogMass(K, h, g);
+		case 8: return FixedGaussian<8>::canonicalLogMass(K, h, g);
+	} // switch
+
+	if (d == 0) return g;
+
+	double* L = work;
+	double* x = work + d*d;
+	if (!choleskyDecompose(K, L, d)) return std::numeric_limits<double>::infinity();
+
+	choleskySolve(L, h, x, d);
+	double quad = 0;
+	for (unsigned i = 0; i < d; i++) quad += h[i]*x[i];
+
+	return g + 0.5*( d*log(2*M_PI) - choleskyLogDet(L, d) + quad );
+} // canonicalLogMass()
+
+bool canonicalMoments(const double* K, const double* h, const unsigned d,
+		double* mean, double* cov, double* work) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::canonicalMoments(K, h, mean, cov);
+		case 6: return FixedGaussian<6>::canonicalMoments(K, h, mean, cov);
+		case 8: return FixedGaussian<8>::canonicalMoments(K, h, mean, cov);
+	} // switch
+
+	double* L = work;
+	if (!choleskyDecompose(K, L, d)) return false;
+
+	choleskySolve(L, h, mean, d);
+	if (cov) choleskyInverse(L, cov, d);
+
+	return true;
+} // canonicalMoments()
+
+bool momentsToCanonical(const double* mean, const double* cov, const double logMass, const unsigned d,
+		double* K, double* h, double& g, double* work) {
+	switch (d) {
+		case 2: return FixedGaussian<2>::momentsToCanonical(mean, cov, logMass, K, h, g);
+		case 6: return FixedGaussian<6>::momentsToCanonical(mean, cov, logMass, K, h, g);
+		case 8: return FixedGaussian<8>::momentsToCanonical(mean, cov, logMass, K, h, g);
+	} // switch
+
+	double* L = work;
+	if (!choleskyDecompose(cov, L, d)) return false;
+
+	choleskyInverse(L, K, d);
+	double quad = 0;
+	for (unsigned i = 0; i < d; i++) {
+		double s = 0;
+		for (unsigned j = 0; j < d; j++) s += K[i*d + j]*mean[j];
+		h[i] = s;
+		quad += mean[i]*s;
+	} // for
+	g = logMass - 0.5*( d*log(2*M_PI) + choleskyLogDet(L, d) + quad );
+
+	return true;
+} // momentsToCanonical()
+
+//------------------ Store operations
+
+void combineComponents(const ComponentStore& lhs, const std::vector<unsigned>& lhsMap,
+		const ComponentStore& rhs, const std::vector<unsigned>& rhsMap,
+		const double sign, ComponentStore& result) {
+	unsigned D = result.getDimension();
+	unsigned P = lhs.getDimension(), Q = rhs.getDimension();
+	unsigned M = lhs.size(), N = rhs.size();
+
+	// If lhs already spans the result's scope, its blocks can be copied directly.
+	bool identity = (P == D);
+	for (unsigned i = 0; i < P && identity; i++) identity = (lhsMap[i] == i);
+
+	result.reserve(result.size() + M*N);
+	for (unsigned i = 0; i < M; i++) {
+		const double* Ki = lhs.K(i);
+		const double* hi = lhs.h(i);
+
+		for (unsigned j = 0; j < N; j++) {
+			const double* Kj = rhs.K(j);
+			const double* hj = rhs.h(j);
+
+			unsigned k = result.size();
+			result.resize(k + 1);
+			double* K = result.K(k);
+			double* h = result.h(k);
+
+			if (identity) {
+				memcpy(K, Ki, D*D*sizeof(double));
+				memcpy(h, hi, D*sizeof(double));
+			} else {
+				std::fill(K, K + D*D, 0.0);
+				std::fill(h, h + D, 0.0);
+				for (unsigned r = 0; r < P; r++) {
+					h[lhsMap[r]] = hi[r];
+					for (unsigned c = 0; c < P; c++) K[lhsMap[r]*D + lhsMap[c]] = Ki[r*P + c];
+				} // for
+			} // if
+
+			for (unsigned r = 0; r < Q; r++) {
+				h[rhsMap[r]] += sign*hj[r];
+				for (unsigned c = 0; c < Q; c++) K[rhsMap[r]*D + rhsMap[c]] += sign*Kj[r*Q + c];
+			} // for
+
+			result.g(k) = lhs.g(i) + sign*rhs.g(j);
+		} // for
+	} // for
+} // combineComponents()
+
+void combineComponentsInplace(ComponentStore& components, const ComponentStore& rhs,
+		const std::vector<unsigned>& rhsMap, const double sign) {
+	ASSERT( &components != &rhs, "A store cannot be combined with itself in place" );
+	unsigned D = components.getDimension(), Q = rhs.getDimension();
+	unsigned M = components.size(), N = rhs.size();
+
+	// Pair (i, j) is written to slot i*N + j, which is never before slot i. Working
+	// backwards every component is copied out before its slot is overwritten.
+	components.resize(M*N);
+	for (unsigned i = M; i-- > 0; ) {
+		for (unsigned j = N; j-- > 0; ) {
+			unsigned k = i*N + j;
+			double* K = components.K(k);
+			double* h = components.h(k);
+
+			if (k != i) {
+				memcpy(K, components.K(i), D*D*sizeof(double));
+				memcpy(h, components.h(i), D*sizeof(double));
+				components.g(k) = components.g(i);
+			} // if
+
+			const double* Kj = rhs.K(j);
+			const double* hj = rhs.h(j);
+			for (unsigned r = 0; r < Q; r++) {
+				h[rhsMap[r]] += sign*hj[r];
+				for (unsigned c = 0; c < Q; c++) K[rhsMap[r]*D + rhsMap[c]] += sign*Kj[r*Q + c];
+			} // for
+
+			components.g(k) += sign*rhs.g(j);
+		} // for
+	} // for
+} // combineComponentsInplace()
+
+void embedComponents(ComponentStore& components, const unsigned dimension, const std::vector<unsigned>& map) {
+	unsigned P = components.getDimension(), D = dimension;
+	unsigned M = components.size();
+
+	bool identity = (P == D);
+	for (unsigned i = 0; i < P && identity; i++) identity = (map[i] == i);
+	if (identity) return;
+
+	components.reset(D);
+	components.resize(M);
+	if (!M) return;
+
+	// The map is increasing, so no entry moves to an earlier position. Working
+	// backwards no entry is overwritten before it has been moved.
+	double* K = components.K(0);
+	double* h = components.h(0);
+	for (unsigned i = M; i-- > 0; ) {
+		for (unsigned r = P; r-- > 0; ) {
+			for (unsigned c = P; c-- > 0; ) K[i*D*D + map[r]*D + map[c]] = K[i*P*P + r*P + c];
+		} // for
+	} // for
+	for (unsigned i = M; i-- > 0; ) {
+		for (unsigned r = P; r-- > 0; ) h[i*D + map[r]] = h[i*P + r];
+	} // for
+
+	// Clear the entries of the new variables
+	std::vector<bool> mapped(D, false);
+	for (unsigned r = 0; r < P; r++) mapped[map[r]] = true;
+
+	for (unsigned i = 0; i < M; i++) {
+		for (unsigned r = 0; r < D; r++) {
+			if (!mapped[r]) h[i*D + r] = 0.0;
+			for (unsigned c = 0; c < D; c++) if (!mapped[r] || !mapped[c]) K[i*D*D + r*D + c] = 0.0;
+		} // for
+	} // for
+} // embedComponents()
+
+void marginalizeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& discard, ComponentStore& result) {
+	unsigned D = components.getDimension();
+	unsigned A = keep.size(), B = discard.size();
+	unsigned M = components.size();
+
+	// Scratch space, shared by all components
+	std::vector<double> Kbb(B*B), L(B*B), X(B*A), y(B);
+
+	result.reserve(result.size() + M);
+	for (unsigned m = 0; m < M; m++) {
+		const double* K = components.K(m);
+		const double* h = components.h(m);
+		double g = components.g(m);
+
+		unsigned k = result.size();
+		result.resize(k + 1);
+		double* Kn = result.K(k);
+		double* hn = result.h(k);
+
+		// Start with the retained blocks
+		for (unsigned r = 0; r < A; r++) {
+			hn[r] = h[keep[r]];
+			for (unsigned c = 0; c < A; c++) Kn[r*A + c] = K[keep[r]*D + keep[c]];
+		} // for
+
+		for (unsigned r = 0; r < B; r++) {
+			for (unsigned c = 0; c < B; c++) Kbb[r*B + c] = K[discard[r]*D + discard[c]];
+		} // for
+
+		// A vacuous (or improper) block can't be integrated out, leave the retained blocks as is.
+		if (B == 0 || !choleskyDecompose(Kbb.data(), L.data(), B)) {
+			result.g(k) = g;
+			continue;
+		} // if
+
+		// With Kbb = LL', W = L^{-1}Kba and z = L^{-1}hb only need forward substitution
+		for (unsigned c = 0; c < A; c++) {
+			double* col = X.data() + c*B;
+			for (unsigned r = 0; r < B; r++) col[r] = K[discard[r]*D + keep[c]];
+			choleskyForward(L.data(), col, col, B);
+		} // for
+		for (unsigned r = 0; r < B; r++) y[r] = h[discard[r]];
+		choleskyForward(L.data(), y.data(), y.data(), B);
+
+		// Schur complement, Kaa - W'W and ha - W'z
+		for (unsigned r = 0; r < A; r++) {
+			const double* Wr = X.data() + r*B;
+			double s = 0;
+			for (unsigned i = 0; i < B; i++) s += Wr[i]*y[i];
+			hn[r] -= s;
+
+			for (unsigned c = r; c < A; c++) {
+				const double* Wc = X.data() + c*B;
+				double t = 0;
+				for (unsigned i = 0; i < B; i++) t += Wr[i]*Wc[i];
+				Kn[r*A + c] -= t;
+				if (c != r) Kn[c*A + r] = Kn[r*A + c];
+			} // for
+		} // for
+
+		double quad = 0;
+		for (unsigned r = 0; r < B; r++) quad += y[r]*y[r];
+		result.g(k) = g + 0.5*( B*log(2*M_PI) - choleskyLogDet(L.data(), B) + quad );
+	} // for
+} // marginalizeComponents()
+
+void observeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& observed, const std::vector<double>& values,
+		ComponentStore& result) {
+	unsigned D = components.getDimension();
+	unsigned A = keep.size(), B = observed.size();
+	unsigned M = components.size();
+
+	result.reserve(result.size() + M);
+	for (unsigned m = 0; m < M; m++) {
+		const double* K = components.K(m);
+		const double* h = components.h(m);
+		double g = components.g(m);
+
+		unsigned k = result.size();
+		result.resize(k + 1);
+		double* Kn = result.K(k);
+		double* hn = result.h(k);
+
+		for (unsigned r = 0; r < A; r++) {
+			const double* Kr = K + keep[r]*D;
+			double s = h[keep[r]];
+			for (unsigned i = 0; i < B; i++) s -= Kr[observed[i]]*values[i];
+			hn[r] = s;
+			for (unsigned c = 0; c < A; c++) Kn[r*A + c] = Kr[keep[c]];
+		} // for
+
+		for (unsigned r = 0; r < B; r++) {
+			const double* Kr = K + observed[r]*D;
+			double s = 0;
+			for (unsigned i = 0; i < B; i++) s += Kr[observed[i]]*values[i];
+			g += values[r]*( h[observed[r]] - 0.5*s );
+		} // for
+		result.g(k) = g;
+	} // for
+} // observeComponents()
+
+void observeComponents(const ComponentStore& components, const std::vector<unsigned>& keep,
+		const std::vector<unsigned>& observed, const std::vector<std::vector<double>>& values,
+		std::vector<ComponentStore>& results) {
+	unsigned D = components.getDimension();
+	unsigned A = keep.size(), B = observed.size();
+	unsigned M = components.size(), T = values.size();
+
+	// Blocks shared by every set of values
+	std::vector<double> Kaa(A*A), Kab(A*B), Kbb(B*B), ha(A), hb(B), Kv(B);
+
+	for (unsigned t = 0; t < T; t++) results[t].reserve(results[t].size() + M);
+	for (unsigned m = 0; m < M; m++) {
+		const double* K = components.K(m);
+		const double* h = components.h(m);
+
+		for (unsigned r = 0; r < A; r++) {
+			const double* Kr = K + keep[r]*D;
+			ha[r] = h[keep[r]];
+			for (unsigned c = 0; c < A; c++) Kaa[r*A + c] = Kr[keep[c]];
+			for (unsigned c = 0; c < B; c++) Kab[r*B + c] = Kr[observed[c]];
+		} // for
+		for (unsigned r = 0; r < B; r++) {
+			hb[r] = h[observed[r]];
+			for (unsigned c = 0; c < B; c++) Kbb[r*B + c] = K[observed[r]*D + observed[c]];
+		} // for
+
+		for (unsigned t = 0; t < T; t++) {
+			const double* v = values[t].data();
+			ComponentStore& result = results[t];
+
+			unsigned k = result.size();
+			result.resize(k + 1);
+			memcpy(result.K(k), Kaa.data(), A*A*sizeof(double));
+
+			double* hn = result.h(k);
+			for (unsigned r = 0; r < A; r++) {
+				double s = ha[r];
+				for (unsigned i = 0; i < B; i++) s -= Kab[r*B + i]*v[i];
+				hn[r] = s;
+			} // for
+
+			double g = components.g(m);
+			for (unsigned r = 0; r < B; r++) {
+				double s = 0;
+				for (unsigned i = 0; i < B; i++) s += Kbb[r*B + i]*v[i];
+				g += v[r]*( hb[r] - 0.5*s );
+			} // for
+			result.g(k) = g;
+		} // for
+	} // for
+} // observeComponents()
+
+void permuteComponents(ComponentStore& components, const std::vector<unsigned>& order) {
+	unsigned D = components.getDimension();
+	std::vector<double> K(D*D), h(D);
+
+	for (unsigned m = 0; m < components.size(); m++) {
+		double* Km = components.K(m);
+		double* hm = components.h(m);
+		memcpy(K.data(), Km, D*D*sizeof(double));
+		memcpy(h.data(), hm, D*sizeof(double));
+
+		for (unsigned r = 0; r < D; r++) {
+			hm[r] = h[order[r]];
+			for (unsigned c = 0; c < D; c++) Km[r*D + c] = K[order[r]*D + order[c]];
+		} // for
+	} // for
+} // permuteComponents()
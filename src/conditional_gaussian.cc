@@ -7,12 +7,16 @@
  *************************************************************************/
 #include <vector>
 #include <iostream>
+#include <limits>
 #include "sortindices.hpp"
 #include "genvec.hpp"
 #include "genmat.hpp"
 #include "emdw.hpp"
 #include "matops.hpp"
 #include "vecset.hpp"
+#include "operator_policy.hpp"
+#include "binary_io.hpp"
+#include "component_store.hpp"
 #include "conditional_gaussian.hpp"
 
 // Default operators
@@ -26,6 +30,26 @@ rcptr<FactorOperator> defaultMarginalizerCG = uniqptr<FactorOperator>(new Margin
 rcptr<FactorOperator> defaultObserveReducerCG = uniqptr<FactorOperator>(new ObserveAndReduceCG());
 rcptr<FactorOperator> defaultInplaceWeakDamperCG = uniqptr<FactorOperator>(new InplaceWeakDampingCG());
 
+// Operators of the discrete priors read by binRead
+rcptr<FactorOperator> defaultDiscreteInplaceNormalizerCG = uniqptr<FactorOperator>(new DiscreteTable_InplaceNormalize<unsigned short>);
+rcptr<FactorOperator> defaultDiscreteNormalizerCG = uniqptr<FactorOperator>(new DiscreteTable_Normalize<unsigned short>);
+rcptr<FactorOperator> defaultDiscreteMarginalizerCG = uniqptr<FactorOperator>(new DiscreteTable_Marginalize<unsigned short>);
+
+// Types of the conditional Factors in the binary encoding
+enum { kBinaryGaussCanonical = 0, kBinaryMixture = 1 };
+
+// Shared by every conditional Gaussian constructed with the default operators
+rcptr<const OperatorPolicy> defaultOperatorsCG(new OperatorPolicy(
+			defaultInplaceNormalizerCG,
+			defaultNormalizerCG,
+			defaultInplaceAbsorberCG,
+			defaultAbsorberCG,
+			defaultInplaceCancellerCG,
+			defaultCancellerCG,
+			defaultMarginalizerCG,
+			defaultObserveReducerCG,
+			defaultInplaceWeakDamperCG));
+
 ConditionalGaussian::ConditionalGaussian(
 		const rcptr<FactorOperator>& inplaceNormalizer,
 		const rcptr<FactorOperator>& normalizer,
@@ -36,26 +60,13 @@ ConditionalGaussian::ConditionalGaussian(
 		const rcptr<FactorOperator>& marginalizer,
 		const rcptr<FactorOperator>& observerAndReducer,
 		const rcptr<FactorOperator>& inplaceDamper) 
-			: inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			: ops_(OperatorPolicy::derive(defaultOperatorsCG,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 	{
-	// Default operator intialisation
-	if (!inplaceNormalizer_) inplaceNormalizer_ = defaultInplaceNormalizerCG;
-	if (!normalizer_) normalizer_ = defaultNormalizerCG;
-	if (!inplaceAbsorber_) inplaceAbsorber_ = defaultInplaceAbsorberCG;
-	if (!absorber_) absorber_ = defaultAbsorberCG;
-	if (!inplaceCanceller_) inplaceCanceller_ = defaultInplaceCancellerCG;
-	if (!canceller_) canceller_ = defaultCancellerCG;
-	if (!marginalizer_) marginalizer_ = defaultMarginalizerCG;
-	if (!observeAndReducer_) observeAndReducer_ = defaultObserveReducerCG;
-	if (!inplaceDamper_) inplaceDamper_ = defaultInplaceWeakDamperCG;
 } // Default Constructor
 
 ConditionalGaussian::ConditionalGaussian(
@@ -70,27 +81,13 @@ ConditionalGaussian::ConditionalGaussian(
 		const rcptr<FactorOperator>& marginalizer,
 		const rcptr<FactorOperator>& observerAndReducer,
 		const rcptr<FactorOperator>& inplaceDamper) 
-			: inplaceNormalizer_(inplaceNormalizer),
-			normalizer_(normalizer),
-			inplaceAbsorber_(inplaceAbsorber),
-			absorber_(absorber),
-			inplaceCanceller_(inplaceCanceller),
-			canceller_(canceller),
-			marginalizer_(marginalizer),
-			observeAndReducer_(observerAndReducer),
-			inplaceDamper_(inplaceDamper)
+			: ops_(OperatorPolicy::derive(defaultOperatorsCG,
+						inplaceNormalizer, normalizer,
+						inplaceAbsorber, absorber,
+						inplaceCanceller, canceller,
+						marginalizer, observerAndReducer,
+						inplaceDamper))
 	{
-	// Default operator intialisation
-	if (!inplaceNormalizer_) inplaceNormalizer_ = defaultInplaceNormalizerCG;
-	if (!normalizer_) normalizer_ = defaultNormalizerCG;
-	if (!inplaceAbsorber_) inplaceAbsorber_ = defaultInplaceAbsorberCG;
-	if (!absorber_) absorber_ = defaultAbsorberCG;
-	if (!inplaceCanceller_) inplaceCanceller_ = defaultInplaceCancellerCG;
-	if (!canceller_) canceller_ = defaultCancellerCG;
-	if (!marginalizer_) marginalizer_ = defaultMarginalizerCG;
-	if (!observeAndReducer_) observeAndReducer_ = defaultObserveReducerCG;
-	if (!inplaceDamper_) inplaceDamper_ = defaultInplaceWeakDamperCG;
-
 	// Get the variables
 	emdw::RVIds vars;
 	emdw::RVIds discreteVars = discreteRV->getVars(); 
@@ -120,8 +117,45 @@ ConditionalGaussian::ConditionalGaussian(
 	vars_ = extract<unsigned>(vars, sorted);
 } // Class Specific Constructor
 
+ConditionalGaussian::ConditionalGaussian(const ConditionalGaussian& st) 
+	: Factor(st),
+	vars_(st.vars_),
+	isContinuous_(st.isContinuous_),
+	ops_(st.ops_)
+	{
+	if (st.discreteRV_) discreteRV_ = uniqptr<Factor>(st.discreteRV_->copy());
+	for (auto& i : st.conditionalList_) conditionalList_[i.first] = uniqptr<Factor>((i.second)->copy());
+} // Copy Constructor
+
 ConditionalGaussian::~ConditionalGaussian() {} // Default Destructor
 
+ConditionalGaussian& ConditionalGaussian::operator=(const ConditionalGaussian& d) {
+	if (this != &d) {
+		ConditionalGaussian copy(d);
+		*this = std::move(copy);
+	} // if
+	return *this;
+} // operator=()
+
+void ConditionalGaussian::updateScope() {
+	emdw::RVIds vars;
+	emdw::RVIds discreteVars = discreteRV_->getVars(); 
+	emdw::RVIds continuousVars = ( (conditionalList_.begin())->second )->getVars();
+
+	isContinuous_.clear();
+	vars.push_back(discreteVars[0]);
+	isContinuous_[discreteVars[0]] = false;
+
+	for (auto& i : continuousVars) {
+		vars.push_back(i);
+		isContinuous_[i] = true;
+	}
+
+	// Sort the variables
+	std::vector<size_t> sorted = sortIndices(vars, std::less<unsigned>() );
+	vars_ = extract<unsigned>(vars, sorted);
+} // updateScope()
+
 unsigned ConditionalGaussian::configure(unsigned) {
 	std::cout << "NIY" << std::endl;
 	return true;
@@ -165,34 +199,34 @@ unsigned ConditionalGaussian::classSpecificConfigure(
 //------------------Family 1: Normalization
 inline void ConditionalGaussian::inplaceNormalize(FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this);
-	else dynamicInplaceApply(inplaceNormalizer_.get(), this);
+	else dynamicInplaceApply(ops_->inplaceNormalizer.get(), this);
 } // inplaceNormalize()
 
 inline uniqptr<Factor> ConditionalGaussian::normalize(FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor>(dynamicApply(procPtr, this));
-	else return uniqptr<Factor>(dynamicApply(normalizer_.get(), this));
+	else return uniqptr<Factor>(dynamicApply(ops_->normalizer.get(), this));
 } // normalize()
 
 //------------------Family 2: Absorbtion, Cancellation
 
 inline void ConditionalGaussian::inplaceAbsorb(const Factor* rhsPtr, FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this, rhsPtr);
-	else dynamicInplaceApply(inplaceAbsorber_.get(), this, rhsPtr);
+	else dynamicInplaceApply(ops_->inplaceAbsorber.get(), this, rhsPtr);
 } // inplaceAbsorb()
 
 inline uniqptr<Factor> ConditionalGaussian::absorb(const Factor* rhsPtr, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, rhsPtr));
-	else return uniqptr<Factor> (dynamicApply(absorber_.get(), this, rhsPtr));
+	else return uniqptr<Factor> (dynamicApply(ops_->absorber.get(), this, rhsPtr));
 } // absorb()
 
 inline void ConditionalGaussian::inplaceCancel(const Factor* rhsPtr, FactorOperator* procPtr) {
 	if (procPtr) dynamicInplaceApply(procPtr, this, rhsPtr);
-	else dynamicInplaceApply(inplaceCanceller_.get(), this, rhsPtr);
+	else dynamicInplaceApply(ops_->inplaceCanceller.get(), this, rhsPtr);
 } // inplaceCancel()
 
 inline uniqptr<Factor> ConditionalGaussian::cancel(const Factor* rhsPtr, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, rhsPtr));
-	else return uniqptr<Factor> (dynamicApply(canceller_.get(), this, rhsPtr));
+	else return uniqptr<Factor> (dynamicApply(ops_->canceller.get(), this, rhsPtr));
 } // cancel()
 
 //------------------Family 4: Marginalization
@@ -200,7 +234,28 @@ inline uniqptr<Factor> ConditionalGaussian::cancel(const Factor* rhsPtr, FactorO
 inline uniqptr<Factor> ConditionalGaussian::marginalize(const emdw::RVIds& variablesToKeep, 
 		bool presorted, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, variablesToKeep, presorted));
-	else return uniqptr<Factor> (dynamicApply(marginalizer_.get(), this, variablesToKeep, presorted));
+	else return uniqptr<Factor> (dynamicApply(ops_->marginalizer.get(), this, variablesToKeep, presorted));
+} // marginalize()
+
+rcptr<Factor> ConditionalGaussian::marginalize(const emdw::RVIds& variablesToKeep, 
+		StepArena& arena, bool presorted) const {
+	bool keepsDiscrete = false;
+	for (auto& i : variablesToKeep) {
+		if (!isContinuous_[i]) keepsDiscrete = true;
+	} // for
+
+	if (keepsDiscrete || !dynamic_cast<MarginalizeCG*>(ops_->marginalizer.get())) {
+		return marginalize(variablesToKeep, presorted);
+	} // if
+
+	std::map<unsigned, rcptr<Factor>> map;
+	for (auto& i : conditionalList_) map[i.first] = (i.second)->marginalize(variablesToKeep, presorted);
+
+	rcptr<CanonicalGaussianMixture> mixture = arena.make<CanonicalGaussianMixture>(variablesToKeep, 
+			std::vector<rcptr<Factor>>());
+	MarginalizeCG::appendMarginals(*discreteRV_, map, mixture.get());
+
+	return mixture;
 } // marginalize()
 
 //------------------Family 4: ObserveAndReduce
@@ -208,7 +263,7 @@ inline uniqptr<Factor> ConditionalGaussian::marginalize(const emdw::RVIds& varia
 inline uniqptr<Factor> ConditionalGaussian::observeAndReduce( const emdw::RVIds& variables,
 		const emdw::RVVals& assignedVals, bool presorted, FactorOperator* procPtr) const {
 	if (procPtr) return uniqptr<Factor> (dynamicApply(procPtr, this, variables, assignedVals, presorted));
-	else return uniqptr<Factor> (dynamicApply(observeAndReducer_.get(), this, variables, assignedVals, presorted));
+	else return uniqptr<Factor> (dynamicApply(ops_->observeAndReducer.get(), this, variables, assignedVals, presorted));
 } // observeAndReduce()
 
 
@@ -217,7 +272,7 @@ inline uniqptr<Factor> ConditionalGaussian::observeAndReduce( const emdw::RVIds&
 // TODO: Complete this!!!
 double ConditionalGaussian::inplaceDampen(const Factor* oldMsg, double df, FactorOperator* procPtr) {
 	if (procPtr) return dynamicInplaceApply(procPtr, this, oldMsg, df);
-	else return dynamicInplaceApply(inplaceDamper_.get(), this, oldMsg, df); 
+	else return dynamicInplaceApply(ops_->inplaceDamper.get(), this, oldMsg, df); 
 } // inplaceDampen()
 
 //------------------Other required virtual methods
@@ -233,17 +288,10 @@ ConditionalGaussian* ConditionalGaussian::copy(const emdw::RVIds& newVars, bool
 			map[i.first] = uniqptr<Factor>((i.second)->copy());
 		}
 
-		return new ConditionalGaussian(discrete, 
-					map,
-					inplaceNormalizer_,
-					normalizer_,
-					inplaceAbsorber_,
-					absorber_,
-					inplaceCanceller_,
-					canceller_,
-					marginalizer_,
-					observeAndReducer_,
-					inplaceDamper_);
+		ConditionalGaussian* cg = new ConditionalGaussian(discrete, map);
+		cg->ops_ = ops_;
+
+		return cg;
 	} // if
 	
 	return new ConditionalGaussian(*this);
@@ -275,6 +323,106 @@ std::istream& ConditionalGaussian::txtRead(std::istream& file) { return file; }
 //TODO: Complete this!!
 std::ostream& ConditionalGaussian::txtWrite(std::ostream& file) const { return file; } // txtWrite()
 
+std::ostream& ConditionalGaussian::binWrite(std::ostream& file) const {
+	writeBinaryHeader(file, "CLG ");
+
+	emdw::RVIds discreteVars = discreteRV_->getVars();
+	rcptr<DiscreteTable<unsigned short>> dtConvert = 
+		std::dynamic_pointer_cast<DiscreteTable<unsigned short>>(discreteRV_);
+	ASSERT( dtConvert, "The discrete prior must be a DiscreteTable<unsigned short>" );
+
+	writeBinary(file, (uint32_t) discreteVars[0]);
+	writeBinary(file, (uint32_t) conditionalList_.size());
+
+	for (auto& i : conditionalList_) {
+		writeBinary(file, (uint32_t) i.first);
+		writeBinary(file, dtConvert->potentialAt(discreteVars, emdw::RVVals{ (unsigned short)(i.first) }));
+
+		// Tag each conditional with its type
+		rcptr<CanonicalGaussianMixture> cgmConvert = std::dynamic_pointer_cast<CanonicalGaussianMixture>(i.second);
+		rcptr<GaussCanonical> gcConvert = std::dynamic_pointer_cast<GaussCanonical>(i.second);
+		ASSERT( cgmConvert || gcConvert, "The conditional Factors must be GaussCanonical or CanonicalGaussianMixture" );
+
+		if (gcConvert) {
+			writeBinary(file, (uint8_t) kBinaryGaussCanonical);
+			writeBinary(file, gcConvert->getVars());
+
+			ComponentStore packed(gcConvert->noOfVars(), 1);
+			packed.append(gcConvert->getK(), gcConvert->getH(), gcConvert->getG());
+			packed.write(file);
+		} else {
+			writeBinary(file, (uint8_t) kBinaryMixture);
+			cgmConvert->binWrite(file);
+		} // if
+	} // for
+
+	return file;
+} // binWrite()
+
+std::istream& ConditionalGaussian::binRead(std::istream& file) {
+	if (!readBinaryHeader(file, "CLG ")) return file;
+
+	uint32_t discreteVar, N;
+	if (!readBinary(file, discreteVar) || !readBinary(file, N)) return file;
+
+	// A ConditionalGaussian needs at least one conditional Factor
+	if (!N) {
+		file.setstate(std::ios::failbit);
+		return file;
+	} // if
+
+	rcptr<std::vector<unsigned short>> domain = uniqptr<std::vector<unsigned short>>(new std::vector<unsigned short>());
+	std::map<std::vector<unsigned short>, FProb> probs;
+	std::map<unsigned, rcptr<Factor>> conditionalList;
+
+	for (unsigned i = 0; i < N; i++) {
+		uint32_t value;
+		double potential;
+		uint8_t kind;
+		if (!readBinary(file, value) || !readBinary(file, potential) || !readBinary(file, kind)) return file;
+
+		// The discrete domain is unsigned short
+		if (value > std::numeric_limits<unsigned short>::max()) {
+			file.setstate(std::ios::failbit);
+			return file;
+		} // if
+
+		domain->push_back(value);
+		probs[std::vector<unsigned short>{ (unsigned short) value }] = potential;
+
+		if (kind == kBinaryGaussCanonical) {
+			emdw::RVIds vars;
+			ComponentStore packed;
+			if (!readBinary(file, vars) || !packed.read(file)) return file;
+			if (packed.size() != 1 || packed.getDimension() != vars.size()) {
+				file.setstate(std::ios::failbit);
+				return file;
+			} // if
+
+			conditionalList[value] = uniqptr<Factor>(new GaussCanonical(vars, packed.getK(0), packed.getH(0), packed.g(0), true));
+		} else if (kind == kBinaryMixture) {
+			rcptr<CanonicalGaussianMixture> cgm = uniqptr<CanonicalGaussianMixture>(new CanonicalGaussianMixture());
+			if (!cgm->binRead(file)) return file;
+			conditionalList[value] = cgm;
+		} else {
+			// Unknown conditional Factor type
+			file.setstate(std::ios::failbit);
+			return file;
+		} // if
+	} // for
+
+	rcptr<Factor> discrete = uniqptr<Factor>(new DiscreteTable<unsigned short>(emdw::RVIds{discreteVar}, 
+				{domain}, 0.0, probs, 0.0, 0.0, false, 
+				defaultDiscreteMarginalizerCG, defaultDiscreteInplaceNormalizerCG, defaultDiscreteNormalizerCG));
+
+	// Begin anew, keeping the operators
+	rcptr<const OperatorPolicy> ops = ops_;
+	*this = ConditionalGaussian(discrete, conditionalList);
+	ops_ = ops;
+
+	return file;
+} // binRead()
+
 //==================================================FactorOperators======================================
 
 //------------------Family 1: Normalization
@@ -287,22 +435,9 @@ const std::string& InplaceNormalizeCG::isA() const {
 void InplaceNormalizeCG::inplaceProcess(ConditionalGaussian* lhsPtr) {
 	ConditionalGaussian& lhs(*lhsPtr);
 
-	// Normalize the conditional Gaussians
-	std::map<unsigned, rcptr<Factor>> map;
-	for (auto& i : lhs.conditionalList_) map[i.first] = (i.second)->normalize();
-
-	// Reconfigure the class
-	lhs.classSpecificConfigure( (lhs.discreteRV_)->normalize(),
-			        map,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_);
+	// Normalize the discrete prior and the conditional Gaussians
+	(lhs.discreteRV_)->inplaceNormalize();
+	for (auto& i : lhs.conditionalList_) (i.second)->inplaceNormalize();
 } // inplaceProcess()
 
 const std::string& NormalizeCG::isA() const {
@@ -335,10 +470,6 @@ const std::string& InplaceAbsorbCG::isA() const {
 void InplaceAbsorbCG::inplaceProcess(ConditionalGaussian* lhsPtr, const Factor* rhsFPtr) {
 	ConditionalGaussian& lhs(*lhsPtr);
 
-	// Temporary variables
-	rcptr<Factor> discretePrior;
-	std::map<unsigned, rcptr<Factor>> map;
-	rcptr<Factor> rhs = uniqptr<Factor>( rhsFPtr->copy() );
 	const ConditionalGaussian* downCast;
 
 	// An endless amount of options
@@ -348,37 +479,28 @@ void InplaceAbsorbCG::inplaceProcess(ConditionalGaussian* lhsPtr, const Factor*
 				"The discrete components must have the same scope: "
 				<< (lhs.discreteRV_)->getVars() << " != " << (downCast->discreteRV_)->getVars() );
 		
-		discretePrior = (lhs.discreteRV_)->absorb(rhs); // If the domains don't match everything should break here.
-		for (auto& i : lhs.conditionalList_) map[i.first] = (i.second)->absorb( (downCast->conditionalList_)[i.first] );
+		(lhs.discreteRV_)->inplaceAbsorb( (downCast->discreteRV_).get() ); // If the domains don't match everything should break here.
+		for (auto& i : lhs.conditionalList_) (i.second)->inplaceAbsorb( (downCast->conditionalList_)[i.first].get() );
 
 	} else if (dynamic_cast<const GaussCanonical*>(rhsFPtr)) {
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->copy() );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( (i.second)->absorb(rhs) );
+		for (auto& i : lhs.conditionalList_) (i.second)->inplaceAbsorb(rhsFPtr);
 
 	} else if (dynamic_cast<const CanonicalGaussianMixture*>(rhsFPtr)) {
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->copy() );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( rhs->absorb(i.second) );
+		// A GaussCanonical conditional becomes a mixture, anything else absorbs the mixture in place.
+		for (auto& i : lhs.conditionalList_) {
+			if (std::dynamic_pointer_cast<GaussCanonical>(i.second)) i.second = uniqptr<Factor> ( rhsFPtr->absorb(i.second.get()) );
+			else (i.second)->inplaceAbsorb(rhsFPtr);
+		} // for
 
 	} else if (dynamic_cast<const DiscreteTable<unsigned short>*>(rhsFPtr)) {
-		ASSERT( (lhs.discreteRV_)->getVars() == rhs->getVars(), "The discrete distributions must have the same scope:" 
-				<< (lhs.discreteRV_)->getVars() << " != " << rhs->getVars() );
+		ASSERT( (lhs.discreteRV_)->getVars() == rhsFPtr->getVars(), "The discrete distributions must have the same scope:" 
+				<< (lhs.discreteRV_)->getVars() << " != " << rhsFPtr->getVars() );
 
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->absorb(rhs) );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( (i.second)->copy() );
+		(lhs.discreteRV_)->inplaceAbsorb(rhsFPtr);
 	}
 
-	// Reconfigure the class
-	lhs.classSpecificConfigure(discretePrior,
-			        map,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_);
+	// The continuous scope may have grown
+	lhs.updateScope();
 } // inplaceProcess()
 
 const std::string& AbsorbCG::isA() const {
@@ -408,12 +530,7 @@ const std::string& InplaceCancelCG::isA() const {
 void InplaceCancelCG::inplaceProcess(ConditionalGaussian* lhsPtr, const Factor* rhsFPtr) {
 	ConditionalGaussian& lhs(*lhsPtr);
 
-	// Temporary variables
-	rcptr<Factor> discretePrior;
 	rcptr<Factor> mProj;
-	std::map<unsigned, rcptr<Factor>> map;
-	rcptr<Factor> rhs = uniqptr<Factor>( rhsFPtr->copy() );
-	
 	const ConditionalGaussian* downCast;
 	const CanonicalGaussianMixture* gm;
 
@@ -424,42 +541,28 @@ void InplaceCancelCG::inplaceProcess(ConditionalGaussian* lhsPtr, const Factor*
 				"The discrete components have the same single variable scope: " << (lhs.discreteRV_)->getVars() 
 				<< " != " << (downCast->discreteRV_)->getVars() );
 		
-		discretePrior = (lhs.discreteRV_)->cancel(rhs); // If the domains don't match everything should break here.
-		for (auto& i : lhs.conditionalList_) map[i.first] = (i.second)->cancel( (downCast->conditionalList_)[i.first] );
+		(lhs.discreteRV_)->inplaceCancel( (downCast->discreteRV_).get() ); // If the domains don't match everything should break here.
+		for (auto& i : lhs.conditionalList_) (i.second)->inplaceCancel( (downCast->conditionalList_)[i.first].get() );
 
 	} else if (dynamic_cast<const GaussCanonical*>(rhsFPtr)) {
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->copy() );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( (i.second)->cancel(rhs) );
+		for (auto& i : lhs.conditionalList_) (i.second)->inplaceCancel(rhsFPtr);
 
 	} else if (dynamic_cast<const CanonicalGaussianMixture*>(rhsFPtr)) {
 		gm = dynamic_cast<const CanonicalGaussianMixture*>(rhsFPtr);
 		mProj = gm->momentMatch();
 
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->copy() );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( (i.second)->cancel(mProj) );
+		for (auto& i : lhs.conditionalList_) (i.second)->inplaceCancel(mProj.get());
 
 	} else if (dynamic_cast<const DiscreteTable<unsigned short>*>(rhsFPtr)) {
-		ASSERT( (lhs.discreteRV_)->getVars() == rhs->getVars(), 
+		ASSERT( (lhs.discreteRV_)->getVars() == rhsFPtr->getVars(), 
 			"The discrete components have the same single variable scope: "
-			<< (lhs.discreteRV_)->getVars() << " != " << rhs->getVars() );
+			<< (lhs.discreteRV_)->getVars() << " != " << rhsFPtr->getVars() );
 
-		discretePrior = uniqptr<Factor> ( (lhs.discreteRV_)->cancel(rhs) );
-		for (auto& i : lhs.conditionalList_) map[i.first] = uniqptr<Factor> ( (i.second)->copy() );
+		(lhs.discreteRV_)->inplaceCancel(rhsFPtr);
 	}
 
-	// Reconfigure the class
-	lhs.classSpecificConfigure(discretePrior,
-			        map,
-				lhs.inplaceNormalizer_,
-				lhs.normalizer_,
-				lhs.inplaceAbsorber_,
-				lhs.absorber_,
-				lhs.inplaceCanceller_,
-				lhs.canceller_,
-				lhs.marginalizer_,
-				lhs.observeAndReducer_,
-				lhs.inplaceDamper_);
-
+	// The continuous scope may have grown
+	lhs.updateScope();
 } // inplaceCancel()
 
 const std::string& CancelCG::isA() const {
@@ -522,55 +625,49 @@ Factor* MarginalizeCG::process(const ConditionalGaussian* lhsPtr, const emdw::RV
 
 	// If you're not keeping the discrete variable, you get a mixture.
 	if (!discreteVar.size()) { 
-		std::vector<rcptr<Factor>> mixtureComponents; mixtureComponents.clear();
-		
-		for(auto& i : map) {
-			// Get the potential of the discrete variable
-			rcptr<DiscreteTable<unsigned short>> dtConvert = 
-				std::dynamic_pointer_cast<DiscreteTable<unsigned short>>(discretePrior);
-			double potential = dtConvert->potentialAt(discretePrior->getVars(), 
-					emdw::RVVals{ (unsigned short)(i.first) });
-
-			potential = log(potential);
-
-			// Get the factor
-			rcptr<Factor> component = i.second;
-
-			if (std::dynamic_pointer_cast<GaussCanonical>(component)) {
-				// Adjust the mass
-				std::dynamic_pointer_cast<GaussCanonical>(component)->adjustLogMass(potential);
-				mixtureComponents.push_back(component);
-			} else {
-				rcptr<CanonicalGaussianMixture> cgmConvert = 
-					std::dynamic_pointer_cast<CanonicalGaussianMixture>(component);
-				std::vector<rcptr<Factor>> components = cgmConvert->getComponents();
-
-				// Adjust the mass
-				for (rcptr<Factor> c : components) {
-					std::dynamic_pointer_cast<GaussCanonical>(c)->adjustLogMass(potential);
-					mixtureComponents.push_back(c);
-				} // for
-			}  // if
-		} // for
+		CanonicalGaussianMixture* mixture = new CanonicalGaussianMixture(variablesToKeep, 
+				std::vector<rcptr<Factor>>()); // Default GM.
+		appendMarginals(*discretePrior, map, mixture);
 
-		//std::cout << "mixturecomponents.size() = " << mixtureComponents.size() << std::endl;
-		return new CanonicalGaussianMixture(variablesToKeep, mixtureComponents); // Default GM.
+		return mixture;
 	} // if 
 
-	return new ConditionalGaussian(discretePrior, 
-			map,
-			lhs.inplaceNormalizer_,
-			lhs.normalizer_,
-			lhs.inplaceAbsorber_,
-			lhs.absorber_,
-			lhs.inplaceCanceller_,
-			lhs.canceller_,
-			lhs.marginalizer_,
-			lhs.observeAndReducer_,
-			lhs.inplaceDamper_);
+	ConditionalGaussian* cg = new ConditionalGaussian(discretePrior, map);
+	cg->ops_ = lhs.ops_;
+
+	return cg;
 } // process()
 
 
+void MarginalizeCG::appendMarginals(const Factor& discretePrior,
+		const std::map<unsigned, rcptr<Factor>>& marginals,
+		CanonicalGaussianMixture* mixture) {
+	const DiscreteTable<unsigned short>& dtConvert = 
+		dynamic_cast<const DiscreteTable<unsigned short>&>(discretePrior);
+
+	for(auto& i : marginals) {
+		// Get the potential of the discrete variable
+		double potential = dtConvert.potentialAt(discretePrior.getVars(), 
+				emdw::RVVals{ (unsigned short)(i.first) });
+
+		potential = log(potential);
+
+		// Get the factor
+		rcptr<Factor> component = i.second;
+
+		if (std::dynamic_pointer_cast<GaussCanonical>(component)) {
+			// Copy the component, adjusting the mass
+			mixture->appendComponent(component.get(), potential);
+		} else {
+			rcptr<CanonicalGaussianMixture> cgmConvert = 
+				std::dynamic_pointer_cast<CanonicalGaussianMixture>(component);
+
+			// Copy each component straight out of the packed mixture, adjusting the mass
+			for (ComponentView c : cgmConvert->components()) mixture->appendComponent(c, potential);
+		}  // if
+	} // for
+} // appendMarginals()
+
 //------------------Family 4: ObserveAndReduce
 
 const std::string& ObserveAndReduceCG::isA() const {
@@ -620,17 +717,10 @@ Factor* ObserveAndReduceCG::process(const ConditionalGaussian* lhsPtr, const emd
 		return gcConvert->copy();
 	}
 
-	return new ConditionalGaussian(discretePrior, 
-			map,
-			lhs.inplaceNormalizer_,
-			lhs.normalizer_,
-			lhs.inplaceAbsorber_,
-			lhs.absorber_,
-			lhs.inplaceCanceller_,
-			lhs.canceller_,
-			lhs.marginalizer_,
-			lhs.observeAndReducer_,
-			lhs.inplaceDamper_);
+	ConditionalGaussian* cg = new ConditionalGaussian(discretePrior, map);
+	cg->ops_ = lhs.ops_;
+
+	return cg;
 } // process()
 
 
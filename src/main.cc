@@ -131,6 +131,9 @@ int main(int, char *argv[]) {
 			// Remove states
 			removeStates(i, currentStates, stateNodes);
 		} // if
+
+		// Release the time step's short lived factors
+		stepArena.reset();
 	}
 
 	// State Extraction
@@ -0,0 +1,88 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the batched validation gate.
+ *************************************************************************/
+#include <vector>
+#include <stdio.h>
+#include <algorithm>
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "gausscanonical.hpp"
+#include "component_store.hpp"
+#include "measurement_gate.hpp"
+
+MeasurementGate::MeasurementGate(const unsigned dimension)
+	: dim_(dimension),
+	means_(dimension),
+	factors_(dimension*dimension)
+{
+} // Default Constructor
+
+bool MeasurementGate::addTarget(const unsigned target, const Factor* predicted) {
+	const GaussCanonical* gc = dynamic_cast<const GaussCanonical*>(predicted);
+	ASSERT( gc, "The predicted measurement distribution must be a GaussCanonical" );
+	ASSERT( gc->noOfVars() == dim_, "The predicted measurement distribution is over " << gc->noOfVars()
+			<< " variables, not " << dim_ );
+
+	unsigned D = dim_;
+	Matrix<double> K = gc->getK();
+	ColVector<double> h = gc->getH();
+
+	std::vector<double> precision(D*D), L(D*D), mean(D);
+	for (unsigned r = 0; r < D; r++) {
+		mean[r] = h[r];
+		for (unsigned c = 0; c < D; c++) precision[r*D + c] = K(r, c);
+	} // for
+
+	if (!choleskyDecompose(precision.data(), L.data(), D)) {
+		printf("Could not factor the predicted measurement precision at line number %d in file %s\n", __LINE__, __FILE__);
+		return false;
+	} // if
+	choleskySolve(L.data(), mean.data(), mean.data(), D);
+
+	targets_.push_back(target);
+	for (unsigned r = 0; r < D; r++) {
+		means_[r].push_back(mean[r]);
+		for (unsigned c = 0; c < D; c++) factors_[r*D + c].push_back(L[r*D + c]);
+	} // for
+
+	return true;
+} // addTarget()
+
+void MeasurementGate::gate(const std::vector<ColVector<double>>& measurements, const double threshold,
+		std::vector<rcptr<std::vector<unsigned short>>>& hypotheses) const {
+	unsigned D = dim_, T = targets_.size();
+	std::vector<double> distance(T), diff(D*T), y(T);
+
+	for (unsigned j = 0; j < measurements.size(); j++) {
+		if (!measurements[j].size() || !hypotheses[j]) continue;
+
+		// Offsets of the measurement from every target's mean
+		for (unsigned r = 0; r < D; r++) {
+			const double x = measurements[j][r];
+			const double* mu = means_[r].data();
+			double* d = &diff[r*T];
+			for (unsigned t = 0; t < T; t++) d[t] = x - mu[t];
+		} // for
+
+		// |L'(x - mu)|^2, where (L'd)_c = sum_{r >= c} L(r, c) d_r
+		std::fill(distance.begin(), distance.end(), 0.0);
+		for (unsigned c = 0; c < D; c++) {
+			std::fill(y.begin(), y.end(), 0.0);
+			for (unsigned r = c; r < D; r++) {
+				const double* l = factors_[r*D + c].data();
+				const double* d = &diff[r*T];
+				for (unsigned t = 0; t < T; t++) y[t] += l[t]*d[t];
+			} // for
+			for (unsigned t = 0; t < T; t++) distance[t] += y[t]*y[t];
+		} // for
+
+		for (unsigned t = 0; t < T; t++) {
+			if (distance[t] < threshold) hypotheses[j]->push_back(targets_[t]);
+		} // for
+	} // for
+} // gate()
@@ -15,6 +15,7 @@
 #include "emdw.hpp"
 #include "matops.hpp"
 #include "vecset.hpp"
+#include "conditional_gaussian.hpp"
 #include "node.hpp"
 
 Node::Node(const rcptr<Factor>& factor, const unsigned N) {
@@ -129,6 +130,12 @@ uniqptr<Factor> Node::marginalize(const emdw::RVIds& variablesToKeep, bool preso
 	return (factor_)->marginalize(variablesToKeep, presorted, procPtr);
 } // marginalize()
 
+rcptr<Factor> Node::marginalize(const emdw::RVIds& variablesToKeep, StepArena& arena, bool presorted) const {
+	const ConditionalGaussian* clg = dynamic_cast<const ConditionalGaussian*>(factor_.get());
+	if (clg) return clg->marginalize(variablesToKeep, arena, presorted);
+	else return (factor_)->marginalize(variablesToKeep, presorted);
+} // marginalize()
+
 void Node::inplaceObserveAndReduce (const emdw::RVIds& variables, const emdw::RVVals& assignedVals, 
 		bool presorted, FactorOperator* procPtr) {
 	factor_ = (factor_)->observeAndReduce(variables, assignedVals, presorted, procPtr);
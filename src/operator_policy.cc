@@ -0,0 +1,64 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the operators shared by factors of the same type.
+ *************************************************************************/
+#include "operator_policy.hpp"
+
+OperatorPolicy::OperatorPolicy(
+		const rcptr<FactorOperator>& inplaceNormalizer,
+		const rcptr<FactorOperator>& normalizer,
+		const rcptr<FactorOperator>& inplaceAbsorber,
+		const rcptr<FactorOperator>& absorber,
+		const rcptr<FactorOperator>& inplaceCanceller,
+		const rcptr<FactorOperator>& canceller,
+		const rcptr<FactorOperator>& marginalizer,
+		const rcptr<FactorOperator>& observeAndReducer,
+		const rcptr<FactorOperator>& inplaceDamper,
+		const rcptr<FactorOperator>& inplaceReducer)
+			: inplaceNormalizer(inplaceNormalizer),
+			normalizer(normalizer),
+			inplaceAbsorber(inplaceAbsorber),
+			absorber(absorber),
+			inplaceCanceller(inplaceCanceller),
+			canceller(canceller),
+			marginalizer(marginalizer),
+			observeAndReducer(observeAndReducer),
+			inplaceDamper(inplaceDamper),
+			inplaceReducer(inplaceReducer)
+		{
+} // Default Constructor
+
+rcptr<const OperatorPolicy> OperatorPolicy::derive(
+		const rcptr<const OperatorPolicy>& base,
+		const rcptr<FactorOperator>& inplaceNormalizer,
+		const rcptr<FactorOperator>& normalizer,
+		const rcptr<FactorOperator>& inplaceAbsorber,
+		const rcptr<FactorOperator>& absorber,
+		const rcptr<FactorOperator>& inplaceCanceller,
+		const rcptr<FactorOperator>& canceller,
+		const rcptr<FactorOperator>& marginalizer,
+		const rcptr<FactorOperator>& observeAndReducer,
+		const rcptr<FactorOperator>& inplaceDamper,
+		const rcptr<FactorOperator>& inplaceReducer) {
+	// Nothing overridden, share the base.
+	if (!inplaceNormalizer && !normalizer && !inplaceAbsorber && !absorber
+			&& !inplaceCanceller && !canceller && !marginalizer
+			&& !observeAndReducer && !inplaceDamper && !inplaceReducer) {
+		return base;
+	} // if
+
+	return rcptr<const OperatorPolicy>(new OperatorPolicy(
+				inplaceNormalizer ? inplaceNormalizer : base->inplaceNormalizer,
+				normalizer ? normalizer : base->normalizer,
+				inplaceAbsorber ? inplaceAbsorber : base->inplaceAbsorber,
+				absorber ? absorber : base->absorber,
+				inplaceCanceller ? inplaceCanceller : base->inplaceCanceller,
+				canceller ? canceller : base->canceller,
+				marginalizer ? marginalizer : base->marginalizer,
+				observeAndReducer ? observeAndReducer : base->observeAndReducer,
+				inplaceDamper ? inplaceDamper : base->inplaceDamper,
+				inplaceReducer ? inplaceReducer : base->inplaceReducer));
+} // derive()
@@ -0,0 +1,79 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the cached scope plans.
+ *************************************************************************/
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "emdw.hpp"
+#include "scope_plan.hpp"
+
+ScopePlan::Cache ScopePlan::cache_;
+const unsigned ScopePlan::kMaxPlans;
+
+ScopePlan::ScopePlan(const Layout& layout) {
+	unsigned n = layout[0];
+
+	// The first selection entry of each scope variable is its source
+	std::vector<int> sources(n, -1);
+	for (unsigned j = 1; j < layout.size(); j++) {
+		if (layout[j] >= 0 && sources[layout[j]] < 0) sources[layout[j]] = j - 1;
+	} // for
+
+	for (unsigned i = 0; i < n; i++) {
+		if (sources[i] < 0) {
+			remaining_.push_back(i);
+		} else {
+			selected_.push_back(i);
+			source_.push_back(sources[i]);
+		} // if
+	} // for
+} // Default Constructor
+
+ScopePlan::Layout ScopePlan::layout(const emdw::RVIds& scope, const emdw::RVIds& selection) {
+	Layout layout(selection.size() + 1);
+	layout[0] = scope.size();
+
+	for (unsigned j = 0; j < selection.size(); j++) {
+		emdw::RVIds::const_iterator it = std::find(scope.begin(), scope.end(), selection[j]);
+		layout[j + 1] = (it == scope.end()) ? -1 : it - scope.begin();
+	} // for
+
+	return layout;
+} // layout()
+
+rcptr<const ScopePlan> ScopePlan::get(const emdw::RVIds& scope, const emdw::RVIds& selection) {
+	Layout key = layout(scope, selection);
+
+	Cache::const_iterator it = cache_.find(key);
+	if (it != cache_.end()) return it->second;
+
+	if (cache_.size() >= kMaxPlans) cache_.clear();
+
+	rcptr<const ScopePlan> plan(new ScopePlan(key));
+	cache_[key] = plan;
+	return plan;
+} // get()
+
+void ScopePlan::clear() {
+	cache_.clear();
+} // clear()
+
+unsigned ScopePlan::size() {
+	return cache_.size();
+} // size()
+
+emdw::RVIds ScopePlan::selectedVars(const emdw::RVIds& scope) const {
+	emdw::RVIds vars(selected_.size());
+	for (unsigned k = 0; k < selected_.size(); k++) vars[k] = scope[selected_[k]];
+	return vars;
+} // selectedVars()
+
+emdw::RVIds ScopePlan::remainingVars(const emdw::RVIds& scope) const {
+	emdw::RVIds vars(remaining_.size());
+	for (unsigned k = 0; k < remaining_.size(); k++) vars[k] = scope[remaining_[k]];
+	return vars;
+} // remainingVars()
@@ -0,0 +1,83 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the per time step arena.
+ *************************************************************************/
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "emdw.hpp"
+#include "step_arena.hpp"
+
+//------------------ArenaBlocks
+
+ArenaBlocks::ArenaBlocks(const size_t blockSize)
+	: blockSize_(blockSize), block_(0), offset_(0)
+{
+} // Default Constructor
+
+ArenaBlocks::~ArenaBlocks() {
+	for (unsigned i = 0; i < blocks_.size(); i++) delete[] blocks_[i];
+} // Default Destructor
+
+void* ArenaBlocks::allocate(const size_t bytes, const size_t alignment) {
+	// Try the current block, then the next free one, before adding one.
+	for (; block_ < blocks_.size(); block_++, offset_ = 0) {
+		uintptr_t base = reinterpret_cast<uintptr_t>(blocks_[block_]);
+		size_t start = ((base + offset_ + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+
+		if (start + bytes <= sizes_[block_]) {
+			offset_ = start + bytes;
+			return blocks_[block_] + start;
+		} // if
+	} // for
+
+	// Oversized allocations get a block of their own.
+	size_t size = std::max(blockSize_, bytes + alignment);
+	blocks_.push_back(new char[size]);
+	sizes_.push_back(size);
+	block_ = blocks_.size() - 1;
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(blocks_[block_]);
+	size_t start = ((base + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+	offset_ = start + bytes;
+
+	return blocks_[block_] + start;
+} // allocate()
+
+void ArenaBlocks::rewind() {
+	block_ = 0;
+	offset_ = 0;
+} // rewind()
+
+size_t ArenaBlocks::capacity() const {
+	size_t total = 0;
+	for (unsigned i = 0; i < sizes_.size(); i++) total += sizes_[i];
+
+	return total;
+} // capacity()
+
+//------------------StepArena
+
+StepArena::StepArena(const size_t blockSize)
+	: blockSize_(blockSize),
+	blocks_(new ArenaBlocks(blockSize))
+{
+} // Default Constructor
+
+rcptr<Factor> StepArena::promote(const rcptr<Factor>& factor) {
+	return uniqptr<Factor>(factor->copy());
+} // promote()
+
+bool StepArena::reset() {
+	// Every surviving object holds a reference to the blocks.
+	if (blocks_.use_count() == 1) {
+		blocks_->rewind();
+		return true;
+	} // if
+
+	blocks_ = rcptr<ArenaBlocks>(new ArenaBlocks(blockSize_));
+	return false;
+} // reset()
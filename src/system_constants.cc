@@ -21,12 +21,14 @@ const unsigned short mht::kMeasSpaceDim = 2;
 // Motion model
 rcptr<V2VTransform> mht::kMotionModel;
 Matrix<double> mht::kRCovMat;
+rcptr<const TransitionFactor> mht::kTransition;
 
 // Measurement model
 const double mht::kC = 3e8;
 const double mht::kFc = 10.525e9;
 const double mht::kTp = 200e-6; 
 const double mht::kBw = 47e6; 
+std::vector<bool> mht::kLinearisedSensors;
 
 std::vector<rcptr<V2VTransform>> mht::kMeasurementModel;
 std::vector<Matrix<double>> mht::kQCovMat;
@@ -81,6 +83,9 @@ unsigned kNumberOfTimeSteps;
 // GraphBuilder
 rcptr<GraphBuilder> graphBuilder;
 
+// Short lived factors of the current time step
+StepArena stepArena;
+
 // Graph representation
 std::map<unsigned, std::vector<rcptr<Node>>> stateNodes;
 std::map<unsigned, std::vector<rcptr<Node>>> measurementNodes;
@@ -98,9 +103,11 @@ bool initialiseVariables() {
 	// Sensor location
 	mht::kRCovMat = initialiseRCovMat();
 	mht::kMotionModel = initialiseMotionModel();
+	mht::kTransition = initialiseTransition();
 
 	// Measurement models
 	mht::kQCovMat = initialiseQCovMat();
+	mht::kLinearisedSensors = initialiseLinearisedSensors();
 	mht::kMeasurementModel = initialiseMeasurementModels();
 
 	// Clutter cov
@@ -262,15 +269,29 @@ std::vector<ColVector<double>> initialiseSensorLocations() {
 } // initialiseSensorLocations()
 
 rcptr<V2VTransform> initialiseMotionModel() {
+	// An AffineTransform, so predictions are formed in closed form
 	return uniqptr<V2VTransform>(new MotionModel(mht::kTimeStep));
 } // initialiseMotionModel()
 
+rcptr<const TransitionFactor> initialiseTransition() {
+	const AffineTransform* motion = dynamic_cast<const AffineTransform*>(mht::kMotionModel.get());
+	ASSERT( motion, "The motion model must be affine" );
+
+	return uniqptr<const TransitionFactor>(new TransitionFactor(*motion, mht::kRCovMat));
+} // initialiseTransition()
+
+std::vector<bool> initialiseLinearisedSensors() {
+	// Every sensor uses the Unscented Transform unless selected here
+	return std::vector<bool>(mht::kNumSensors, false);
+} // initialiseLinearisedSensors()
+
 std::vector<rcptr<V2VTransform>> initialiseMeasurementModels() {
 	std::vector<rcptr<V2VTransform>> models(6);
 	std::vector<ColVector<double>> locations = initialiseSensorLocations();
 
 	for (unsigned i = 0; i < 6; i++) {
-		models[i] = uniqptr<V2VTransform>(new SensorModel(locations[i], mht::kC, mht::kFc, mht::kTp, mht::kBw));
+		models[i] = uniqptr<V2VTransform>(new SensorModel(locations[i], mht::kC, mht::kFc, mht::kTp, mht::kBw,
+					mht::kLinearisedSensors[i]));
 	}
 
 	return models;
@@ -10,6 +10,8 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <math.h>
 #include "genvec.hpp"
 #include "genmat.hpp"
 #include "emdw.hpp"
@@ -20,40 +22,153 @@
 
 using namespace std;
 
+// AffineTransform
+AffineTransform::AffineTransform(const Matrix<double>& A, const ColVector<double>& b, const unsigned inputDimension)
+	: A_(A), b_(b), n_(inputDimension), m_(b.size()) {
+} // Default Constructor
+
+std::vector< ColVector<double> > AffineTransform::operator()(const ColVector<double>& x) const {
+	// Assert dimensional consistency
+	ASSERT(x.size() == n_, "x has inconsistent dimensions, needs to be " << n_ << "x1");
+	std::vector< ColVector<double> > y(1); y[0].resize(m_);
+
+	std::vector<double> in(n_), out(m_);
+	for (unsigned i = 0; i < n_; i++) in[i] = x[i];
+	transform(in.data(), 1, out.data());
+	for (unsigned i = 0; i < m_; i++) y[0][i] = out[i];
+
+	return y;
+} // operator()
+
+void AffineTransform::transform(const double* X, const unsigned count, double* Y) const {
+	for (unsigned p = 0; p < count; p++) {
+		const double* x = X + n_*p;
+		double* y = Y + m_*p;
+
+		for (unsigned r = 0; r < m_; r++) {
+			double s = b_[r];
+			for (unsigned c = 0; c < n_; c++) s += A_(r, c)*x[c];
+			y[r] = s;
+		} // for
+	} // for
+} // transform()
+
 // MotionModel
+MotionModel::MotionModel(const double timeStep)
+	: AffineTransform(transitionMatrix(timeStep), gravityOffset(timeStep), 6),
+	deltaT_(timeStep) {
+} // Default Constructor
+
+Matrix<double> MotionModel::transitionMatrix(const double timeStep) {
+	Matrix<double> A = gLinear::zeros<double>(6, 6);
+	for (unsigned i = 0; i < 6; i++) A(i, i) = 1;
+	A(0, 1) = A(2, 3) = A(4, 5) = timeStep;
+
+	return A;
+} // transitionMatrix()
+
+ColVector<double> MotionModel::gravityOffset(const double timeStep) {
+	ColVector<double> b(6);
+	for (unsigned i = 0; i < 6; i++) b[i] = 0;
+	b[4] = -(0.5)*(9.81)*pow(timeStep, 2);
+	b[5] = -(9.81)*(timeStep);
+
+	return b;
+} // gravityOffset()
+
 std::vector< ColVector<double> > MotionModel::operator()(const ColVector<double>& x) const {
 	// Assert dimensional consistency
 	ASSERT(x.size() == 6, "x has inconsistent dimensions, needs to be 6x1");
 	std::vector< ColVector<double> > y(1); y[0].resize(6);
-	
-	// Shift target through the motion model
-	y[0][0] = x[0] + x[1]*deltaT_;
-	y[0][1] = x[1];
-	y[0][2] = x[2] + x[3]*deltaT_;
-	y[0][3] = x[3];
-	y[0][4] = x[4] + x[5]*deltaT_ - (0.5)*(9.81)*pow(deltaT_, 2);
-	y[0][5] = x[5] - (9.81)*(deltaT_);
+
+	double in[6], out[6];
+	for (unsigned i = 0; i < 6; i++) in[i] = x[i];
+	transform(in, 1, out);
+	for (unsigned i = 0; i < 6; i++) y[0][i] = out[i];
 
 	return y;
 } // operator()
 
+void MotionModel::transform(const double* X, const unsigned count, double* Y) const {
+	for (unsigned p = 0; p < count; p++) {
+		const double* x = X + 6*p;
+		double* y = Y + 6*p;
+
+		// Shift target through the motion model
+		y[0] = x[0] + x[1]*deltaT_;
+		y[1] = x[1];
+		y[2] = x[2] + x[3]*deltaT_;
+		y[3] = x[3];
+		y[4] = x[4] + x[5]*deltaT_ - (0.5)*(9.81)*pow(deltaT_, 2);
+		y[5] = x[5] - (9.81)*(deltaT_);
+	} // for
+} // transform()
+
 // SensorModel
+const double SensorModel::kWrapMargin = 3.0;
+
 std::vector< ColVector<double> > SensorModel::operator()(const ColVector<double>& x) const {
 	// Assert dimensional consistency
 	ASSERT(x.size() == 6, "x has inconsistent dimensions, needs to be 6x1");
-	std::vector< ColVector<double> > z(1); z[0].resize(2); z[0] *= 0;
-	
-	// Determine the 'true' Range-Doppler measurements
-	ColVector<double> relativePosition = x.slice(gLinear::gIndexRange(0, 4 , 2)) - sensorPosition_;
-	z[0][0] = sqrt((relativePosition.transpose())*relativePosition);
-	z[0][1] = (1.0/z[0][0])*( relativePosition.transpose()*(x.slice(gLinear::gIndexRange(1, 5, 2))) );
-
-	// Adjust the range measurements
-	z[0][0] += (z[0][1]*fc_*tp_)/(bw_);
+	std::vector< ColVector<double> > z(1); z[0].resize(2);
 
-	// Account for Doppler wrapping
-	if (z[0][1] > vMax_) z[0][1] = -(z[0][1] - 2*vMax_);
-	if (z[0][1] < -vMax_) z[0][1] = -(z[0][1] + 2*vMax_);
+	double in[6], out[2];
+	for (unsigned i = 0; i < 6; i++) in[i] = x[i];
+	transform(in, 1, out);
+	z[0][0] = out[0]; z[0][1] = out[1];
 
 	return z;
 } // operator()
+
+void SensorModel::transform(const double* X, const unsigned count, double* Y) const {
+	double s[3] = {sensorPosition_[0], sensorPosition_[1], sensorPosition_[2]};
+
+	for (unsigned p = 0; p < count; p++) {
+		const double* x = X + 6*p;
+		double* z = Y + 2*p;
+
+		// Determine the 'true' Range-Doppler measurements
+		double dx = x[0] - s[0], dy = x[2] - s[1], dz = x[4] - s[2];
+		z[0] = sqrt(dx*dx + dy*dy + dz*dz);
+		z[1] = (1.0/z[0])*( dx*x[1] + dy*x[3] + dz*x[5] );
+
+		// Adjust the range measurements
+		z[0] += (z[1]*fc_*tp_)/(bw_);
+
+		// Account for Doppler wrapping
+		if (z[1] > vMax_) z[1] = -(z[1] - 2*vMax_);
+		if (z[1] < -vMax_) z[1] = -(z[1] + 2*vMax_);
+	} // for
+} // transform()
+
+bool SensorModel::linearise(const double* mean, const double* cov, double* y, double* J) const {
+	const double* x = mean;
+	double dx = x[0] - sensorPosition_[0], dy = x[2] - sensorPosition_[1], dz = x[4] - sensorPosition_[2];
+	double r = sqrt(dx*dx + dy*dy + dz*dz);
+	if (!(r > 1e-9)) return false;
+
+	double p = dx*x[1] + dy*x[3] + dz*x[5];
+	double doppler = p/r, k = (fc_*tp_)/(bw_);
+
+	// Doppler row: d(p/r)/dx, the range row adds k times it
+	double* jr = J;
+	double* jd = J + 6;
+	double d[3] = {dx, dy, dz};
+	for (unsigned i = 0; i < 3; i++) {
+		jd[2*i] = x[2*i + 1]/r - p*d[i]/(r*r*r);
+		jd[2*i + 1] = d[i]/r;
+		jr[2*i] = d[i]/r + k*jd[2*i];
+		jr[2*i + 1] = k*jd[2*i + 1];
+	} // for
+
+	// Keep the component's Doppler spread clear of the wrap
+	double variance = 0;
+	for (unsigned i = 0; i < 6; i++) {
+		for (unsigned j = 0; j < 6; j++) variance += jd[i]*cov[i*6 + j]*jd[j];
+	} // for
+	if (fabs(doppler) + kWrapMargin*sqrt(std::max(variance, 0.0)) >= vMax_) return false;
+
+	y[0] = r + doppler*k;
+	y[1] = doppler;
+	return true;
+} // linearise()
@@ -0,0 +1,126 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the precomputed transition factor.
+ *************************************************************************/
+#include <vector>
+#include <math.h>
+#include <algorithm>
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "v2vtransform.hpp"
+#include "transforms.hpp"
+#include "component_store.hpp"
+#include "transition_factor.hpp"
+
+TransitionFactor::TransitionFactor(const AffineTransform& transform, const Matrix<double>& Q)
+	: n_(transform.inputDimension()),
+	m_(transform.outputDimension())
+{
+	const Matrix<double>& A = transform.getA();
+	const ColVector<double>& b = transform.getB();
+
+	std::vector<double> packedA(m_*n_), packedB(m_);
+	for (unsigned r = 0; r < m_; r++) {
+		packedB[r] = b[r];
+		for (unsigned c = 0; c < n_; c++) packedA[r*n_ + c] = A(r, c);
+	} // for
+	factorNoise(Q);
+	linearise(packedA.data(), packedB.data());
+} // Default Constructor
+
+TransitionFactor::TransitionFactor(const double* A, const double* b, const Matrix<double>& Q,
+		const unsigned n, const unsigned m)
+	: n_(n),
+	m_(m)
+{
+	factorNoise(Q);
+	linearise(A, b);
+} // Packed Constructor
+
+TransitionFactor::TransitionFactor(const Matrix<double>& Q, const unsigned n, const unsigned m)
+	: n_(n),
+	m_(m),
+	K_((n + m)*(n + m), 0.0),
+	h_(n + m, 0.0),
+	g_(0)
+{
+	factorNoise(Q);
+} // Noise Constructor
+
+void TransitionFactor::factorNoise(const Matrix<double>& Q) {
+	unsigned m = m_;
+
+	std::vector<double> packedQ(m*m);
+	for (unsigned r = 0; r < m; r++) {
+		for (unsigned c = 0; c < m; c++) packedQ[r*m + c] = Q(r, c);
+	} // for
+	L_.resize(m*m);
+	W_.resize(m*m);
+	bool factored = choleskyDecompose(packedQ.data(), L_.data(), m);
+	ASSERT( factored, "The noise covariance must be positive definite" );
+	choleskyInverse(L_.data(), W_.data(), m);
+	logNormaliser_ = -0.5*(m*log(2*M_PI) + choleskyLogDet(L_.data(), m));
+} // factorNoise()
+
+void TransitionFactor::linearise(const double* A, const double* b) {
+	unsigned n = n_, m = m_, D = n + m;
+	const double* W = W_.data();
+
+	std::vector<double> WA(m*n, 0.0), Wb(m, 0.0);
+	for (unsigned r = 0; r < m; r++) {
+		for (unsigned k = 0; k < m; k++) {
+			const double w = W[r*m + k];
+			Wb[r] += w*b[k];
+			for (unsigned c = 0; c < n; c++) WA[r*n + c] += w*A[k*n + c];
+		} // for
+	} // for
+
+	// K = [A'WA, -A'W; -WA, W], h = [-A'Wb; Wb]
+	K_.assign(D*D, 0.0);
+	h_.assign(D, 0.0);
+	g_ = logNormaliser_;
+	for (unsigned k = 0; k < m; k++) {
+		g_ -= 0.5*b[k]*Wb[k];
+		for (unsigned r = 0; r < n; r++) {
+			const double a = A[k*n + r];
+			h_[r] -= a*Wb[k];
+			for (unsigned c = 0; c < n; c++) K_[r*D + c] += a*WA[k*n + c];
+		} // for
+	} // for
+	for (unsigned r = 0; r < m; r++) {
+		h_[n + r] = Wb[r];
+		for (unsigned c = 0; c < n; c++) {
+			K_[(n + r)*D + c] = -WA[r*n + c];
+			K_[c*D + n + r] = -WA[r*n + c];
+		} // for
+		for (unsigned c = 0; c < m; c++) K_[(n + r)*D + n + c] = W[r*m + c];
+	} // for
+} // linearise()
+
+void TransitionFactor::predict(const ComponentStore& prior, ComponentStore& joint) const {
+	unsigned N = prior.size();
+	ASSERT( prior.getDimension() == n_, "The components are over " << prior.getDimension()
+			<< " variables, not " << n_ );
+
+	joint = ComponentStore(n_ + m_, N);
+	joint.resize(N);
+	for (unsigned i = 0; i < N; i++) predict(prior, i, joint.K(i), joint.h(i), joint.g(i));
+} // predict()
+
+void TransitionFactor::predict(const ComponentStore& prior, const unsigned i, double* K, double* h, double& g) const {
+	unsigned n = n_, D = n_ + m_;
+	const double* Kx = prior.K(i);
+	const double* hx = prior.h(i);
+
+	std::copy(K_.begin(), K_.end(), K);
+	std::copy(h_.begin(), h_.end(), h);
+	for (unsigned r = 0; r < n; r++) {
+		for (unsigned c = 0; c < n; c++) K[r*D + c] += Kx[r*n + c];
+		h[r] += hx[r];
+	} // for
+	g = prior.g(i) + g_;
+} // predict()
@@ -65,12 +65,12 @@ void extractStates(const unsigned N,
 
 		// Moment match the current marginal
 		rcptr<Factor> marginal = stateNodes[N][i]->marginalize(elementsOfX[currentStates[N][i]], true);
-		std::vector<rcptr<Factor>> comps = std::dynamic_pointer_cast<CGM>( marginal )->getComponents();
+		ComponentRange comps = std::dynamic_pointer_cast<CGM>( marginal )->components();
 		
 		// Get the mean and mass
 		for (unsigned j = 0; j < comps.size(); j++) {
-			double mass = std::dynamic_pointer_cast<GC>(comps[j])->getLogMass();
-			ColVector<double> mean =  std::dynamic_pointer_cast<GC>(comps[j])->getMean();
+			double mass = comps[j].getLogMass();
+			ColVector<double> mean = comps[j].getMean();
 
 			std::cout << N+1 << "," << i << "," << j << "," << mean[0] << "," << mean[2] << "," << mean[4] 
 				<< "," << mass << std::endl;
@@ -0,0 +1,159 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Source file for the kernels operating on packed arrays of logarithmic
+ * component weights.
+ *************************************************************************/
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "weight_kernels.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define WEIGHT_KERNELS_AVX2
+#endif
+
+#ifdef WEIGHT_KERNELS_AVX2
+
+// Arguments outside this range underflow or overflow the scaling by 2^n
+static const double kMinExp = -708.39641853226408;
+static const double kMaxExp = 709.0;
+
+/**
+ * Four exponentials at once, Cephes' rational approximation on
+ * [-ln(2)/2, ln(2)/2] scaled by 2^n. Arguments below kMinExp, including
+ * -inf, give zero. Arguments above kMaxExp and NaNs are not handled.
+ */
+static inline __m256d exp4(__m256d x) {
+	const __m256d P0 = _mm256_set1_pd(1.26177193074810590878E-4);
+	const __m256d P1 = _mm256_set1_pd(3.02994407707441961300E-2);
+	const __m256d P2 = _mm256_set1_pd(9.99999999999999999910E-1);
+	const __m256d Q0 = _mm256_set1_pd(3.00198505138664455042E-6);
+	const __m256d Q1 = _mm256_set1_pd(2.52448340349684104192E-3);
+	const __m256d Q2 = _mm256_set1_pd(2.27265548208155028766E-1);
+	const __m256d Q3 = _mm256_set1_pd(2.00000000000000000009E0);
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	__m256d underflow = _mm256_cmp_pd(x, _mm256_set1_pd(kMinExp), _CMP_LT_OQ);
+	x = _mm256_max_pd(x, _mm256_set1_pd(kMinExp));
+
+	// x = n*ln(2) + r
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634073599)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	x = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125E-1), x);
+	x = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212E-6), x);
+
+	// exp(r) = 1 + 2r P(r^2)/(Q(r^2) - r P(r^2))
+	__m256d xx = _mm256_mul_pd(x, x);
+	__m256d px = _mm256_fmadd_pd(_mm256_fmadd_pd(P0, xx, P1), xx, P2);
+	px = _mm256_mul_pd(px, x);
+	__m256d qx = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(Q0, xx, Q1), xx, Q2), xx, Q3);
+	__m256d r = _mm256_div_pd(px, _mm256_sub_pd(qx, px));
+	r = _mm256_fmadd_pd(_mm256_set1_pd(2.0), r, one);
+
+	// Scale by 2^n through the exponent bits
+	__m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+	e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+	r = _mm256_mul_pd(r, _mm256_castsi256_pd(e));
+
+	return _mm256_andnot_pd(underflow, r);
+} // exp4()
+
+/**
+ * Does any of the four arguments overflow exp4 or is NaN?
+ */
+static inline bool exceeds4(__m256d x) {
+	__m256d valid = _mm256_cmp_pd(x, _mm256_set1_pd(kMaxExp), _CMP_LE_OQ);
+	return _mm256_movemask_pd(valid) != 0xF;
+} // exceeds4()
+
+double logSumExp(const double* logWeights, const unsigned n) {
+	const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+
+	// Largest finite weight
+	__m256d maxv = _mm256_sub_pd(_mm256_setzero_pd(), inf);
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(logWeights + i);
+		__m256d finite = _mm256_cmp_pd(_mm256_and_pd(x, absMask), inf, _CMP_LT_OQ);
+		maxv = _mm256_max_pd(maxv, _mm256_blendv_pd(_mm256_sub_pd(_mm256_setzero_pd(), inf), x, finite));
+	} // for
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, maxv);
+	double maxWeight = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+	for (; i < n; i++) if (std::isfinite(logWeights[i]) && logWeights[i] > maxWeight) maxWeight = logWeights[i];
+
+	// If there is no finite weight
+	if (std::isinf(maxWeight)) return -std::numeric_limits<double>::infinity();
+
+	// Every finite argument is at most zero, so nothing overflows
+	__m256d shift = _mm256_set1_pd(maxWeight), sum = _mm256_setzero_pd();
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(logWeights + i);
+		__m256d finite = _mm256_cmp_pd(_mm256_and_pd(x, absMask), inf, _CMP_LT_OQ);
+		__m256d w = exp4(_mm256_and_pd(_mm256_sub_pd(x, shift), finite));
+		sum = _mm256_add_pd(sum, _mm256_and_pd(w, finite));
+	} // for
+
+	_mm256_storeu_pd(lanes, sum);
+	double linearSum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	for (; i < n; i++) if (std::isfinite(logWeights[i])) linearSum += exp(logWeights[i] - maxWeight);
+
+	return maxWeight + log(linearSum);
+} // logSumExp()
+
+void relativeWeights(const double* logWeights, const unsigned n, const double logTotal, double* weights) {
+	__m256d shift = _mm256_set1_pd(logTotal);
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_sub_pd(_mm256_loadu_pd(logWeights + i), shift);
+		if (exceeds4(x)) {
+			for (unsigned j = i; j < i + 4; j++) weights[j] = exp(logWeights[j] - logTotal);
+		} else {
+			_mm256_storeu_pd(weights + i, exp4(x));
+		} // if
+	} // for
+	for (; i < n; i++) weights[i] = exp(logWeights[i] - logTotal);
+} // relativeWeights()
+
+void expWeights(const double* logWeights, const unsigned n, double* weights) {
+	unsigned i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(logWeights + i);
+		if (exceeds4(x)) {
+			for (unsigned j = i; j < i + 4; j++) weights[j] = exp(logWeights[j]);
+		} else {
+			_mm256_storeu_pd(weights + i, exp4(x));
+		} // if
+	} // for
+	for (; i < n; i++) weights[i] = exp(logWeights[i]);
+} // expWeights()
+
+#else
+
+double logSumExp(const double* logWeights, const unsigned n) {
+	double maxWeight = -std::numeric_limits<double>::infinity();
+	for (unsigned i = 0; i < n; i++) if (std::isfinite(logWeights[i]) && logWeights[i] > maxWeight) maxWeight = logWeights[i];
+
+	// If there is no finite weight
+	if (std::isinf(maxWeight)) return -std::numeric_limits<double>::infinity();
+
+	double linearSum = 0;
+	for (unsigned i = 0; i < n; i++) if (std::isfinite(logWeights[i])) linearSum += exp(logWeights[i] - maxWeight);
+	return maxWeight + log(linearSum);
+} // logSumExp()
+
+void relativeWeights(const double* logWeights, const unsigned n, const double logTotal, double* weights) {
+	for (unsigned i = 0; i < n; i++) weights[i] = exp(logWeights[i] - logTotal);
+} // relativeWeights()
+
+void expWeights(const double* logWeights, const unsigned n, double* weights) {
+	for (unsigned i = 0; i < n; i++) weights[i] = exp(logWeights[i]);
+} // expWeights()
+
+#endif // WEIGHT_KERNELS_AVX2
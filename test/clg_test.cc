@@ -6,6 +6,7 @@
  * Google Test fixture for linear_gaussian.hpp.
  *************************************************************************/
 #include <iostream>
+#include <sstream>
 #include "gtest/gtest.h"
 #include "genvec.hpp"
 #include "genmat.hpp"
@@ -196,3 +197,61 @@ TEST_F (CLGTest, MarginalizeDiscrete) {
 TEST_F (CLGTest, ObserveAndReduceDiscrete) {
 	rcptr<Factor> lg = uniqptr<Factor>(new ConditionalGaussian(discreteRV_, conditionalList_));
 }
+
+TEST_F (CLGTest, AbsorbLeavesOriginal) {
+	rcptr<Factor> lg = uniqptr<Factor>(new ConditionalGaussian(discreteRV_, conditionalList_));
+	rcptr<ConditionalGaussian> cast = std::dynamic_pointer_cast<ConditionalGaussian>(lg);
+
+	std::map<unsigned, double> before;
+	for (auto& i : cast->getConditionalList()) before[i.first] = std::dynamic_pointer_cast<GaussCanonical>(i.second)->getH()[0];
+
+	rcptr<Factor> product = lg->absorb(mixtureComponents_[0]);
+
+	for (auto& i : cast->getConditionalList()) {
+		EXPECT_DOUBLE_EQ(std::dynamic_pointer_cast<GaussCanonical>(i.second)->getH()[0], before[i.first]);
+	}
+}
+
+TEST_F (CLGTest, BinaryRoundTrip) {
+	// Mix both supported conditional types
+	std::map<unsigned, rcptr<Factor>> conditionalList = conditionalList_;
+	conditionalList[2] = gm_;
+	rcptr<ConditionalGaussian> lg = uniqptr<ConditionalGaussian>(new ConditionalGaussian(discreteRV_, conditionalList));
+
+	std::stringstream encoded;
+	lg->binWrite(encoded);
+
+	rcptr<ConditionalGaussian> decoded = uniqptr<ConditionalGaussian>(new ConditionalGaussian());
+	ASSERT_TRUE(decoded->binRead(encoded));
+	EXPECT_EQ(decoded->getVars(), lg->getVars());
+
+	std::map<unsigned, rcptr<Factor>> decodedList = decoded->getConditionalList();
+	ASSERT_EQ(decodedList.size(), 3);
+	EXPECT_TRUE(std::dynamic_pointer_cast<GaussCanonical>(decodedList[0]) != nullptr);
+	EXPECT_TRUE(std::dynamic_pointer_cast<CanonicalGaussianMixture>(decodedList[2]) != nullptr);
+
+	// Encoding the decoded factor reproduces the original bytes
+	std::stringstream reencoded;
+	decoded->binWrite(reencoded);
+	EXPECT_EQ(reencoded.str(), encoded.str());
+
+	// A domain value beyond unsigned short, after the tag, version, variable and count
+	std::string corrupt = encoded.str();
+	uint32_t value = 0x10000;
+	corrupt.replace(14, sizeof(value), reinterpret_cast<const char*>(&value), sizeof(value));
+	std::stringstream outOfRange(corrupt);
+	EXPECT_FALSE(decoded->binRead(outOfRange));
+
+	// No conditional Factors
+	corrupt = encoded.str();
+	uint32_t count = 0;
+	corrupt.replace(10, sizeof(count), reinterpret_cast<const char*>(&count), sizeof(count));
+	std::stringstream empty(corrupt);
+	EXPECT_FALSE(decoded->binRead(empty));
+
+	// An unknown conditional Factor type, after the value and potential
+	corrupt = encoded.str();
+	corrupt[26] = 7;
+	std::stringstream unknown(corrupt);
+	EXPECT_FALSE(decoded->binRead(unknown));
+}
@@ -0,0 +1,90 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for component_index.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include <random>
+#include "gtest/gtest.h"
+#include "component_index.hpp"
+
+class ComponentIndexTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			std::mt19937 generator(7);
+			std::uniform_real_distribution<double> coordinate(-10.0, 10.0);
+			std::uniform_real_distribution<double> radius(0.5, 3.0);
+
+			points_.resize(kPoints_*kDim_);
+			radii_.resize(kPoints_);
+			for (double& p : points_) p = coordinate(generator);
+			for (double& r : radii_) r = radius(generator);
+		}
+
+		virtual void TearDown() {
+			points_.clear();
+			radii_.clear();
+		}
+
+		/**
+		 * Every remaining point within its radius of the centre, by brute force.
+		 */
+		std::vector<unsigned> bruteForce(const double* centre, const std::vector<bool>& removed) {
+			std::vector<unsigned> found;
+			for (unsigned i = 0; i < kPoints_; i++) {
+				if (removed[i]) continue;
+
+				double distance = 0;
+				for (unsigned r = 0; r < kDim_; r++) {
+					double d = points_[i*kDim_ + r] - centre[r];
+					distance += d*d;
+				}
+				if (distance <= radii_[i]*radii_[i]) found.push_back(i);
+			}
+			return found;
+		}
+
+	protected:
+		const unsigned kPoints_ = 200;
+		const unsigned kDim_ = 6;
+
+		std::vector<double> points_;
+		std::vector<double> radii_;
+};
+
+TEST_F (ComponentIndexTest, QueryMatchesBruteForce) {
+	ComponentIndex index(points_, radii_, kDim_);
+	std::vector<bool> removed(kPoints_, false);
+	std::vector<unsigned> found;
+
+	for (unsigned i = 0; i < kPoints_; i++) {
+		index.query(&points_[i*kDim_], found);
+		EXPECT_EQ(found, bruteForce(&points_[i*kDim_], removed));
+	}
+
+	// Removed points are never found
+	for (unsigned i = 0; i < kPoints_; i += 2) {
+		index.remove(i);
+		removed[i] = true;
+	}
+	ASSERT_EQ(index.size(), kPoints_/2);
+
+	for (unsigned i = 0; i < kPoints_; i++) {
+		index.query(&points_[i*kDim_], found);
+		EXPECT_EQ(found, bruteForce(&points_[i*kDim_], removed));
+	}
+}
+
+TEST_F (ComponentIndexTest, Empty) {
+	std::vector<double> points, radii;
+	ComponentIndex index(points, radii, kDim_);
+
+	std::vector<unsigned> found(1, 0);
+	index.query(&points_[0], found);
+	EXPECT_TRUE(found.empty());
+	EXPECT_EQ(index.size(), 0u);
+}
@@ -0,0 +1,270 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for component_store.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <math.h>
+#include "gtest/gtest.h"
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "gausscanonical.hpp"
+#include "component_store.hpp"
+
+class ComponentStoreTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			vars_ = emdw::RVIds{0, 1};
+
+			// A correlated two dimensional Gaussian
+			mu_ = ColVector<double>(kDim_);
+			mu_[0] = 1.0; mu_[1] = -2.0;
+
+			S_ = gLinear::zeros<double>(kDim_, kDim_);
+			S_(0, 0) = 2.0; S_(0, 1) = S_(1, 0) = 0.5; S_(1, 1) = 1.0;
+
+			gc_ = uniqptr<GaussCanonical>(new GaussCanonical(vars_, mu_, S_));
+			gc_->adjustLogMass(kLogWeight_);
+		}
+
+		virtual void TearDown() {
+			vars_.clear();
+		}
+
+	protected:
+		const unsigned kDim_ = 2;
+		const double kLogWeight_ = -0.5;
+		const double kTolerance_ = 1e-9;
+		emdw::RVIds vars_;
+
+		ColVector<double> mu_;
+		Matrix<double> S_;
+		rcptr<GaussCanonical> gc_;
+};
+
+TEST_F (ComponentStoreTest, AppendAndSelect) {
+	ComponentStore store(kDim_);
+	for (unsigned i = 0; i < 4; i++) store.append(gc_->getK(), gc_->getH(), 1.0*i);
+
+	ASSERT_EQ(store.size(), 4u);
+	store.select(std::vector<unsigned>{1, 3});
+	ASSERT_EQ(store.size(), 2u);
+	EXPECT_DOUBLE_EQ(store.g(0), 1.0);
+	EXPECT_DOUBLE_EQ(store.g(1), 3.0);
+
+	store.select(std::vector<unsigned>{1, 0});
+	EXPECT_DOUBLE_EQ(store.g(0), 3.0);
+	EXPECT_DOUBLE_EQ(store.getK(1)(0, 1), gc_->getK()(0, 1));
+}
+
+TEST_F (ComponentStoreTest, LogMassAndMoments) {
+	ComponentStore store(kDim_);
+	store.append(gc_->getK(), gc_->getH(), gc_->getG());
+
+	std::vector<double> work(kDim_*(kDim_ + 1)), mean(kDim_), cov(kDim_*kDim_);
+	EXPECT_NEAR(canonicalLogMass(store.K(0), store.h(0), store.g(0), kDim_, work.data()), kLogWeight_, kTolerance_);
+
+	ASSERT_TRUE(canonicalMoments(store.K(0), store.h(0), kDim_, mean.data(), cov.data(), work.data()));
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(mean[i], mu_[i], kTolerance_);
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(cov[i*kDim_ + j], S_(i, j), kTolerance_);
+	}
+
+	// A vacuous component has no finite mass
+	std::vector<double> K(kDim_*kDim_, 0.0), h(kDim_, 0.0);
+	EXPECT_TRUE(std::isinf(canonicalLogMass(K.data(), h.data(), 0.0, kDim_, work.data())));
+}
+
+TEST_F (ComponentStoreTest, MomentsToCanonical) {
+	std::vector<double> mean = {mu_[0], mu_[1]};
+	std::vector<double> cov = {S_(0, 0), S_(0, 1), S_(1, 0), S_(1, 1)};
+	std::vector<double> K(kDim_*kDim_), h(kDim_), work(kDim_*kDim_);
+	double g;
+
+	ASSERT_TRUE(momentsToCanonical(mean.data(), cov.data(), kLogWeight_, kDim_, K.data(), h.data(), g, work.data()));
+	EXPECT_NEAR(g, gc_->getG(), kTolerance_);
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(h[i], gc_->getH()[i], kTolerance_);
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(K[i*kDim_ + j], gc_->getK()(i, j), kTolerance_);
+	}
+}
+
+TEST_F (ComponentStoreTest, CombineComponents) {
+	ComponentStore lhs(kDim_), rhs(1), product(3);
+	lhs.append(gc_->getK(), gc_->getH(), gc_->getG());
+	lhs.append(gc_->getK(), gc_->getH(), 0.0);
+
+	double Kr = 4.0, hr = 1.0;
+	rhs.append(&Kr, &hr, 0.25);
+
+	// lhs spans {0, 1} and rhs {1, 2} of the union {0, 1, 2}
+	combineComponents(lhs, std::vector<unsigned>{0, 1}, rhs, std::vector<unsigned>{1}, 1.0, product);
+
+	ASSERT_EQ(product.size(), 2u);
+	EXPECT_NEAR(product.K(0)[1*3 + 1], gc_->getK()(1, 1) + Kr, kTolerance_);
+	EXPECT_NEAR(product.K(0)[2*3 + 2], 0.0, kTolerance_);
+	EXPECT_NEAR(product.h(1)[1], gc_->getH()[1] + hr, kTolerance_);
+	EXPECT_NEAR(product.g(0), gc_->getG() + 0.25, kTolerance_);
+}
+
+TEST_F (ComponentStoreTest, MarginalizeAndObserve) {
+	ComponentStore store(kDim_), marginal(1), observed(1);
+	store.append(gc_->getK(), gc_->getH(), gc_->getG());
+
+	// Marginalizing out x1 leaves N(mu_0, S_00) with the same mass
+	marginalizeComponents(store, std::vector<unsigned>{0}, std::vector<unsigned>{1}, marginal);
+
+	std::vector<double> work(2), mean(1), cov(1);
+	ASSERT_TRUE(canonicalMoments(marginal.K(0), marginal.h(0), 1, mean.data(), cov.data(), work.data()));
+	EXPECT_NEAR(mean[0], mu_[0], kTolerance_);
+	EXPECT_NEAR(cov[0], S_(0, 0), kTolerance_);
+	EXPECT_NEAR(canonicalLogMass(marginal.K(0), marginal.h(0), marginal.g(0), 1, work.data()), kLogWeight_, kTolerance_);
+
+	// Observing x1 at its mean leaves the conditional mean at mu_0
+	observeComponents(store, std::vector<unsigned>{0}, std::vector<unsigned>{1}, std::vector<double>{mu_[1]}, observed);
+	ASSERT_TRUE(canonicalMoments(observed.K(0), observed.h(0), 1, mean.data(), cov.data(), work.data()));
+	EXPECT_NEAR(mean[0], mu_[0], kTolerance_);
+	EXPECT_NEAR(cov[0], S_(0, 0) - S_(0, 1)*S_(1, 0)/S_(1, 1), kTolerance_);
+}
+
+TEST_F (ComponentStoreTest, SelectPermutation) {
+	ComponentStore store(kDim_);
+	for (unsigned i = 0; i < 5; i++) store.append(gc_->getK(), gc_->getH(), 1.0*i);
+
+	// Rearranged in place
+	store.select(std::vector<unsigned>{4, 0, 3, 1});
+	ASSERT_EQ(store.size(), 4u);
+	EXPECT_DOUBLE_EQ(store.g(0), 4.0);
+	EXPECT_DOUBLE_EQ(store.g(1), 0.0);
+	EXPECT_DOUBLE_EQ(store.g(2), 3.0);
+	EXPECT_DOUBLE_EQ(store.g(3), 1.0);
+	EXPECT_DOUBLE_EQ(store.h(3)[1], gc_->getH()[1]);
+
+	// Repeated components
+	store.select(std::vector<unsigned>{2, 2});
+	EXPECT_DOUBLE_EQ(store.g(0), 3.0);
+	EXPECT_DOUBLE_EQ(store.g(1), 3.0);
+}
+
+TEST_F (ComponentStoreTest, CombineComponentsInplace) {
+	ComponentStore lhs(kDim_), rhs(1), product(3);
+	lhs.append(gc_->getK(), gc_->getH(), gc_->getG());
+	lhs.append(gc_->getK(), gc_->getH(), 0.0);
+
+	double Kr[] = {4.0, 2.0}, hr[] = {1.0, -1.0};
+	rhs.append(&Kr[0], &hr[0], 0.25);
+	rhs.append(&Kr[1], &hr[1], 0.5);
+
+	// lhs spans {0, 1} and rhs {2} of the union {0, 1, 2}
+	std::vector<unsigned> lhsMap = {0, 1}, rhsMap = {2};
+	combineComponents(lhs, lhsMap, rhs, rhsMap, 1.0, product);
+
+	embedComponents(lhs, 3, lhsMap);
+	combineComponentsInplace(lhs, rhs, rhsMap, 1.0);
+
+	ASSERT_EQ(lhs.size(), product.size());
+	for (unsigned k = 0; k < lhs.size(); k++) {
+		EXPECT_DOUBLE_EQ(lhs.g(k), product.g(k));
+		for (unsigned i = 0; i < 3; i++) {
+			EXPECT_DOUBLE_EQ(lhs.h(k)[i], product.h(k)[i]);
+			for (unsigned j = 0; j < 3; j++) EXPECT_DOUBLE_EQ(lhs.K(k)[i*3 + j], product.K(k)[i*3 + j]);
+		}
+	}
+}
+
+TEST_F (ComponentStoreTest, ComponentMoments) {
+	ComponentStore store(kDim_);
+	store.append(gc_->getK(), gc_->getH(), gc_->getG());
+
+	std::vector<double> K(kDim_*kDim_, 0.0), h(kDim_, 0.0);
+	store.append(K.data(), h.data(), 0.0);
+
+	ComponentMoments moments;
+	ASSERT_TRUE(moments.update(store, 0));
+	EXPECT_FALSE(moments.update(store, 1));
+	EXPECT_TRUE(std::isinf(moments.logMass(store, 1)));
+
+	std::vector<double> work(kDim_*(kDim_ + 1));
+	EXPECT_DOUBLE_EQ(moments.logMass(store, 0), canonicalLogMass(store.K(0), store.h(0), store.g(0), kDim_, work.data()));
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(moments.mean(0)[i], mu_[i], kTolerance_);
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(moments.cov(0)[i*kDim_ + j], S_(i, j), kTolerance_);
+	}
+
+	// The moments follow the selected components
+	store.select(std::vector<unsigned>{1, 0});
+	moments.select(std::vector<unsigned>{1, 0});
+	EXPECT_FALSE(moments.update(store, 0));
+	ASSERT_TRUE(moments.update(store, 1));
+	EXPECT_NEAR(moments.mean(1)[0], mu_[0], kTolerance_);
+
+	// Changing a component's precision requires invalidating it
+	store.K(1)[0] *= 2;
+	moments.invalidate(1);
+	ASSERT_TRUE(moments.update(store, 1));
+	EXPECT_NEAR(moments.cov(1)[0], 1.0/(2*gc_->getK()(0, 0) - gc_->getK()(0, 1)*gc_->getK()(1, 0)/gc_->getK()(1, 1)), kTolerance_);
+}
+
+TEST_F (ComponentStoreTest, SquareRootMoments) {
+	ComponentStore store(kDim_), rhs(1);
+	store.append(gc_->getK(), gc_->getH(), gc_->getG());
+	store.append(gc_->getK(), gc_->getH(), 0.0);
+
+	double Kr[] = {4.0, 0.5}, hr[] = {1.0, -1.0};
+	rhs.append(&Kr[0], &hr[0], 0.0);
+	rhs.append(&Kr[1], &hr[1], 0.0);
+
+	ComponentMoments moments;
+	moments.setSquareRoot(true);
+	ASSERT_TRUE(moments.update(store, 0));
+
+	// Absorb into the second variable and check against factoring afresh
+	std::vector<unsigned> rhsMap = {1};
+	combineComponentsInplace(store, rhs, rhsMap, 1.0);
+	moments.combine(store, 2, rhs, rhsMap, 1.0);
+
+	ComponentMoments fresh;
+	for (unsigned k = 0; k < store.size(); k++) {
+		ASSERT_TRUE(moments.update(store, k));
+		ASSERT_TRUE(fresh.update(store, k));
+		EXPECT_NEAR(moments.logDet(k), fresh.logDet(k), kTolerance_);
+		for (unsigned i = 0; i < kDim_; i++) {
+			EXPECT_NEAR(moments.mean(k)[i], fresh.mean(k)[i], kTolerance_);
+			for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(moments.cov(k)[i*kDim_ + j], fresh.cov(k)[i*kDim_ + j], kTolerance_);
+		}
+	}
+
+	// Cancelling it again recovers the original moments
+	ComponentStore single(1);
+	single.append(rhs, 0);
+	combineComponentsInplace(store, single, rhsMap, -1.0);
+	moments.combine(store, 4, single, rhsMap, -1.0);
+	ASSERT_TRUE(moments.update(store, 0));
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(moments.mean(0)[i], mu_[i], kTolerance_);
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(moments.cov(0)[i*kDim_ + j], S_(i, j), kTolerance_);
+	}
+
+	// A rank one precision is recovered from its outer products
+	double A[] = {1.0, 2.0, 2.0, 4.0}, V[4], work[4];
+	ASSERT_EQ(semidefiniteFactor(A, V, kDim_, work), 1u);
+	for (unsigned i = 0; i < kDim_; i++) {
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(V[i]*V[j], A[i*kDim_ + j], kTolerance_);
+	}
+
+	// Cancellation leaves a nearly singular precision slightly indefinite
+	double Kn[] = {1.0, 1.0, 1.0, 1.0 - 1e-15}, hn[] = {0.0, 0.0};
+	ComponentStore nearlySingular(kDim_);
+	nearlySingular.append(&Kn[0], &hn[0], 0.0);
+
+	ComponentMoments plain, robust;
+	robust.setSquareRoot(true);
+	EXPECT_FALSE(plain.update(nearlySingular, 0));
+	ASSERT_TRUE(robust.update(nearlySingular, 0));
+	EXPECT_TRUE(std::isfinite(robust.logMass(nearlySingular, 0)));
+	for (unsigned i = 0; i < kDim_*kDim_; i++) EXPECT_TRUE(std::isfinite(robust.cov(0)[i]));
+}
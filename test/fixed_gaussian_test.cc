@@ -0,0 +1,93 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for fixed_gaussian.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <math.h>
+#include "gtest/gtest.h"
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "gausscanonical.hpp"
+#include "fixed_gaussian.hpp"
+#include "component_store.hpp"
+
+class FixedGaussianTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			vars_ = emdw::RVIds(kDim_);
+			for (unsigned i = 0; i < kDim_; i++) vars_[i] = i;
+
+			// A banded, diagonally dominant covariance
+			mu_ = ColVector<double>(kDim_);
+			S_ = gLinear::zeros<double>(kDim_, kDim_);
+			for (unsigned i = 0; i < kDim_; i++) {
+				mu_[i] = 0.5*i - 1.0;
+				S_(i, i) = 2.0 + i;
+				if (i > 0) S_(i, i - 1) = S_(i - 1, i) = 0.5;
+			}
+
+			gc_ = uniqptr<GaussCanonical>(new GaussCanonical(vars_, mu_, S_));
+			gc_->adjustLogMass(kLogWeight_);
+
+			K_ = std::vector<double>(kDim_*kDim_);
+			h_ = std::vector<double>(kDim_);
+			for (unsigned i = 0; i < kDim_; i++) {
+				h_[i] = gc_->getH()[i];
+				for (unsigned j = 0; j < kDim_; j++) K_[i*kDim_ + j] = gc_->getK()(i, j);
+			}
+		}
+
+		virtual void TearDown() {
+			vars_.clear();
+		}
+
+	protected:
+		static const unsigned kDim_ = 6;
+		const double kLogWeight_ = -1.5;
+		const double kTolerance_ = 1e-9;
+		emdw::RVIds vars_;
+
+		ColVector<double> mu_;
+		Matrix<double> S_;
+		rcptr<GaussCanonical> gc_;
+
+		std::vector<double> K_;
+		std::vector<double> h_;
+};
+
+TEST_F (FixedGaussianTest, LogMassAndMoments) {
+	EXPECT_NEAR(FixedGaussian<kDim_>::canonicalLogMass(K_.data(), h_.data(), gc_->getG()), kLogWeight_, kTolerance_);
+
+	std::vector<double> mean(kDim_), cov(kDim_*kDim_);
+	ASSERT_TRUE(FixedGaussian<kDim_>::canonicalMoments(K_.data(), h_.data(), mean.data(), cov.data()));
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(mean[i], mu_[i], kTolerance_);
+		for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(cov[i*kDim_ + j], S_(i, j), kTolerance_);
+	}
+}
+
+TEST_F (FixedGaussianTest, MatchesDynamicKernels) {
+	// The dynamic kernels dispatch to FixedGaussian, force the generic path through a 7-D embedding
+	const unsigned P = kDim_ + 1;
+	std::vector<double> K(P*P, 0.0), h(P, 0.0);
+	for (unsigned i = 0; i < kDim_; i++) {
+		h[i] = h_[i];
+		for (unsigned j = 0; j < kDim_; j++) K[i*P + j] = K_[i*kDim_ + j];
+	}
+	K[P*P - 1] = 1.0;
+
+	std::vector<double> work(P*(P + 1));
+	double generic = canonicalLogMass(K.data(), h.data(), 0.0, P, work.data()) - 0.5*log(2*M_PI);
+	double fixed = FixedGaussian<kDim_>::canonicalLogMass(K_.data(), h_.data(), 0.0);
+	EXPECT_NEAR(generic, fixed, kTolerance_);
+
+	// A matrix which isn't positive definite
+	std::vector<double> L(kDim_*kDim_);
+	K_[0] = -1.0;
+	EXPECT_FALSE(FixedGaussian<kDim_>::choleskyDecompose(K_.data(), L.data()));
+}
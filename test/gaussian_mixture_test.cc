@@ -6,6 +6,7 @@
  * Google Test fixture for canonical_gaussian_mixture.hpp.
  *************************************************************************/
 #include <iostream>
+#include <sstream>
 #include "gtest/gtest.h"
 #include "genvec.hpp"
 #include "genmat.hpp"
@@ -18,6 +19,23 @@
 #include "system_constants.hpp"
 #include "utils.hpp"
 
+/**
+ * Hides that the wrapped transform is affine, so the mixture falls back
+ * to the Unscented Transform.
+ */
+class OpaqueTransform : public V2VTransform, public BatchTransform {
+	public:
+		OpaqueTransform(const rcptr<AffineTransform>& transform) : transform_(transform) {}
+
+		std::vector< ColVector<double> > operator()(const ColVector<double>& x) const { return (*transform_)(x); }
+		unsigned inputDimension() const { return transform_->inputDimension(); }
+		unsigned outputDimension() const { return transform_->outputDimension(); }
+		void transform(const double* X, const unsigned count, double* Y) const { transform_->transform(X, count, Y); }
+
+	private:
+		rcptr<AffineTransform> transform_;
+}; // OpaqueTransform
+
 class CGMTest : public testing::Test {
 
 	protected:
@@ -85,6 +103,63 @@ class CGMTest : public testing::Test {
 			K_.clear();
 		}
 
+		/**
+		 * @brief A mixture of unit covariance components, one centred
+		 * at each offset along every axis.
+		 */
+		rcptr<CGM> offsetMixture(const std::vector<double>& offsets, const unsigned maxComp) const {
+			std::vector<rcptr<Factor>> comps;
+			for (double offset : offsets) {
+				ColVector<double> mu(kDim_);
+				for (unsigned i = 0; i < kDim_; i++) mu[i] = offset;
+				comps.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S_[0])) );
+			}
+			return uniqptr<CGM>(new CGM(vars_, comps, false, maxComp, kThreshold_, kUnionDistance_));
+		}
+
+		/**
+		 * @brief A 2-D mixture of three components, the first two
+		 * close enough to merge, with cached masses and collapse.
+		 */
+		rcptr<CGM> warmMixture(const unsigned maxComp) const {
+			emdw::RVIds vars = {0, 1};
+			std::vector<double> weights = {0.5, 0.3, 0.2};
+			std::vector<ColVector<double>> means(3);
+			std::vector<Matrix<double>> covs(3);
+			for (unsigned k = 0; k < 3; k++) {
+				means[k] = ColVector<double>(2);
+				covs[k] = gLinear::zeros<double>(2, 2);
+			}
+			means[0][0] = 50.0; means[0][1] = -15.0; covs[0](0, 0) = 6.0; covs[0](1, 1) = 2.0;
+			means[1][0] = 50.5; means[1][1] = -14.5; covs[1](0, 0) = 5.0; covs[1](1, 1) = 3.0;
+			means[2][0] = 10.0; means[2][1] = 30.0; covs[2](0, 0) = 1.0; covs[2](1, 1) = 1.0;
+
+			rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars, weights, means, covs, false, maxComp, kThreshold_, kUnionDistance_));
+			cgm->getLogMass();
+			cgm->momentMatch();
+			return cgm;
+		}
+
+		/**
+		 * @brief Expect the mixture to collapse to the same Gaussian as
+		 * copies of its components.
+		 */
+		void expectFreshMomentMatch(const rcptr<CGM>& cgm) const {
+			rcptr<Factor> projected = mProject(cgm->getComponents());
+			rcptr<GaussCanonical> expected = std::dynamic_pointer_cast<GaussCanonical>(projected);
+			rcptr<Factor> match = cgm->momentMatch();
+			rcptr<GaussCanonical> matched = std::dynamic_pointer_cast<GaussCanonical>(match);
+			ASSERT_EQ(matched->getVars(), expected->getVars());
+
+			ColVector<double> mu = matched->getMean(), expectedMu = expected->getMean();
+			Matrix<double> S = matched->getCov(), expectedS = expected->getCov();
+			for (unsigned i = 0; i < mu.size(); i++) {
+				EXPECT_NEAR(mu[i], expectedMu[i], 1e-9);
+				for (unsigned j = 0; j < mu.size(); j++) EXPECT_NEAR(S(i, j), expectedS(i, j), 1e-9);
+			}
+			EXPECT_NEAR(log(matched->getMass()), cgm->getLogMass(), 1e-9);
+		}
+
 	protected:
 		const unsigned kCompN_ = 3;
 		const unsigned kDim_ = 6;
@@ -238,3 +313,624 @@ TEST_F (CGMTest, MergeComponents) {
 	//std::cout << *merged[0] << std::endl;
 
 }
+
+TEST_F (CGMTest, ComponentView) {
+	rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars_, w_, mu_, S_));
+	std::vector<rcptr<Factor>> clones = cgm->cloneComponents();
+
+	unsigned j = 0;
+	for (ComponentView c : cgm->components()) {
+		rcptr<GaussCanonical> gc = std::dynamic_pointer_cast<GaussCanonical>(clones[j++]);
+
+		EXPECT_EQ(c.getVars(), gc->getVars());
+		EXPECT_DOUBLE_EQ(c.getG(), gc->getG());
+		EXPECT_NEAR(c.getLogMass(), gc->getLogMass(), 1e-9);
+		for (unsigned i = 0; i < kDim_; i++) EXPECT_NEAR(c.getMean()[i], gc->getMean()[i], 1e-9);
+	}
+	EXPECT_EQ(j, kCompN_);
+}
+
+TEST_F (CGMTest, AppendComponent) {
+	rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars_, w_, mu_, S_));
+	rcptr<CGM> mixture = uniqptr<CGM>(new CGM(vars_, std::vector<rcptr<Factor>>()));
+
+	for (ComponentView c : cgm->components()) mixture->appendComponent(c, log(0.5));
+	mixture->appendComponent(mixture->getComponent(0));
+
+	ASSERT_EQ(mixture->getNumberOfComponents(), kCompN_ + 1);
+	double expected = log(0.5*exp(cgm->getLogMass()) + 0.5*exp(cgm->getComponent(0).getLogMass()));
+	EXPECT_NEAR(mixture->getLogMass(), expected, 1e-9);
+}
+
+TEST_F (CGMTest, CachedLogMass) {
+	emdw::RVIds newVars = emdw::RVIds(kDim_);
+	for (unsigned i = 0; i < kDim_; i++) newVars[i] = kDim_ + i;
+
+	rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars_, w_, mu_, S_));
+	double logMass = cgm->getLogMass();
+
+	// Scaling and normalising update the cached masses
+	cgm->adjustMass(2.0);
+	EXPECT_NEAR(cgm->getLogMass(), logMass + log(2.0), 1e-9);
+
+	std::static_pointer_cast<Factor>(cgm)->inplaceNormalize();
+	EXPECT_NEAR(cgm->getLogMass(), 0.0, 1e-9);
+
+	// The product over disjoint scopes has the sum of both masses
+	rcptr<CGM> multiplier = uniqptr<CGM>(new CGM(newVars, w_, mu_, S_));
+	std::static_pointer_cast<Factor>(cgm)->inplaceAbsorb(multiplier.get());
+
+	std::vector<double> cached = cgm->getLogWeights();
+	ASSERT_EQ(cached.size(), kCompN_*kCompN_);
+	EXPECT_NEAR(cgm->getLogMass(), multiplier->getLogMass(), 1e-9);
+
+	unsigned j = 0;
+	for (ComponentView c : cgm->components()) EXPECT_NEAR(cached[j++], c.getLogMass(), 1e-9);
+}
+
+TEST_F (CGMTest, CachedMoments) {
+	rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars_, w_, mu_, S_));
+	std::vector<ColVector<double>> means = cgm->getMeans();
+	for (unsigned i = 0; i < kDim_; i++) EXPECT_NEAR(means[0][i], mu_[0][i], 1e-9);
+
+	// Absorbing a Gaussian over the same scope shifts every cached mean
+	ColVector<double> mu(kDim_);
+	for (unsigned i = 0; i < kDim_; i++) mu[i] = 2.0;
+	rcptr<Factor> gc = uniqptr<GaussCanonical>(new GaussCanonical(vars_, mu, S_[0]));
+	std::static_pointer_cast<Factor>(cgm)->inplaceAbsorb(gc.get());
+
+	means = cgm->getMeans();
+	std::vector<Matrix<double>> covs = cgm->getCovs();
+	for (unsigned i = 0; i < kDim_; i++) {
+		EXPECT_NEAR(means[0][i], 1.0, 1e-9);
+		EXPECT_NEAR(covs[0](i, i), 0.5, 1e-9);
+	}
+}
+
+TEST_F (CGMTest, InplaceAbsorbAndReduce) {
+	// Two widely separated components over the same scope
+	std::vector<rcptr<Factor>> comps(2);
+	for (unsigned k = 0; k < 2; k++) {
+		ColVector<double> mu(kDim_);
+		for (unsigned i = 0; i < kDim_; i++) mu[i] = 20.0*k;
+
+		rcptr<GaussCanonical> gc = uniqptr<GaussCanonical>(new GaussCanonical(vars_, mu, S_[0]));
+		gc->adjustLogMass(log(0.7 - 0.4*k));
+		comps[k] = gc;
+	}
+
+	rcptr<CGM> full = uniqptr<CGM>(new CGM(vars_, comps, false, 3, -1e10, kUnionDistance_));
+	rcptr<CGM> fused = uniqptr<CGM>(new CGM(vars_, comps, false, 3, -1e10, kUnionDistance_));
+	rcptr<CGM> multiplier = uniqptr<CGM>(new CGM(vars_, comps));
+
+	std::static_pointer_cast<Factor>(full)->inplaceAbsorb(multiplier.get());
+	full->pruneAndMerge();
+	fused->inplaceAbsorbAndReduce(multiplier.get());
+
+	// Only the three heaviest products survive, the fourth is negligible
+	ASSERT_EQ(fused->getNumberOfComponents(), 3);
+	EXPECT_NEAR(fused->getLogMass(), full->getLogMass(), 1e-6);
+
+	std::vector<ColVector<double>> means = fused->getMeans();
+	EXPECT_NEAR(means[0][0], 0.0, 1e-9);
+	EXPECT_NEAR(means[1][0], 20.0, 1e-9);
+	EXPECT_NEAR(means[2][0], 10.0, 1e-9);
+
+	// Within the budget it is a plain product
+	rcptr<CGM> small = uniqptr<CGM>(new CGM(vars_, comps, false, kMaxComp_, kThreshold_, kUnionDistance_));
+	small->inplaceAbsorbAndReduce(multiplier.get());
+	EXPECT_EQ(small->getNumberOfComponents(), 4);
+}
+
+TEST_F (CGMTest, BatchedAbsorbAndReduce) {
+	rcptr<CGM> sequential = uniqptr<CGM>(new CGM(vars_, K_, h_, g_, false, kMaxComp_, kThreshold_, kUnionDistance_));
+	rcptr<CGM> batched = uniqptr<CGM>(new CGM(vars_, K_, h_, g_, false, kMaxComp_, kThreshold_, kUnionDistance_));
+
+	std::vector<rcptr<Factor>> absorbed, cancelled;
+	for (unsigned i = 0; i < 2; i++) {
+		absorbed.push_back( uniqptr<Factor>(new GaussCanonical(vars_, K_[i], h_[i], g_[i])) );
+		cancelled.push_back( uniqptr<Factor>(new GaussCanonical(vars_, 0.5*K_[i], h_[i], 0.0)) );
+	}
+
+	for (unsigned i = 0; i < 2; i++) {
+		std::static_pointer_cast<Factor>(sequential)->inplaceAbsorb(absorbed[i].get());
+		std::static_pointer_cast<Factor>(sequential)->inplaceCancel(cancelled[i].get());
+	}
+	batched->inplaceAbsorbAndReduce(absorbed, cancelled);
+
+	ASSERT_EQ(batched->getNumberOfComponents(), sequential->getNumberOfComponents());
+	EXPECT_NEAR(batched->getLogMass(), sequential->getLogMass(), 1e-9);
+}
+
+TEST_F (CGMTest, PrunePackedComponents) {
+	ComponentStore store(1);
+	std::vector<double> masses = {-1.0, -5.0, -2.0, -0.5};
+	double K = 1.0, h = 0.0;
+	for (double m : masses) store.append(&K, &h, m);
+
+	// Nothing is pruned
+	pruneComponents(store, masses, 4, -10.0, true);
+	ASSERT_EQ(store.size(), 4u);
+	EXPECT_DOUBLE_EQ(store.g(1), -5.0);
+
+	// Below threshold components are dropped, the order is kept
+	pruneComponents(store, masses, 2, -3.0, false);
+	ASSERT_EQ(store.size(), 3u);
+	EXPECT_DOUBLE_EQ(masses[1], -2.0);
+	EXPECT_DOUBLE_EQ(store.g(1), -2.0);
+
+	// Clipping keeps the heaviest, heaviest first
+	pruneComponents(store, masses, 2, -3.0, true);
+	ASSERT_EQ(store.size(), 2u);
+	EXPECT_DOUBLE_EQ(masses[0], -0.5);
+	EXPECT_DOUBLE_EQ(store.g(0), -0.5);
+	EXPECT_DOUBLE_EQ(store.g(1), -1.0);
+
+	// Everything below threshold keeps the heaviest
+	pruneComponents(store, masses, 1, 0.0, false);
+	ASSERT_EQ(store.size(), 1u);
+	EXPECT_DOUBLE_EQ(store.g(0), -0.5);
+}
+
+TEST_F (CGMTest, RunnallsReduce) {
+	// Two close pairs of components and a distant one
+	rcptr<CGM> cgm = offsetMixture({0.0, 0.1, 10.0, 10.2, 30.0}, 3);
+	double logMass = cgm->getLogMass();
+
+	cgm->setReducer( uniqptr<FactorOperator>(new InplaceRunnallsReduceCGM()) );
+	cgm->reduce();
+
+	// Each close pair is merged, the mass is preserved
+	ASSERT_EQ(cgm->getNumberOfComponents(), 3);
+	EXPECT_NEAR(cgm->getLogMass(), logMass, 1e-9);
+
+	std::vector<ColVector<double>> means = cgm->getMeans();
+	EXPECT_NEAR(means[0][0], 0.05, 1e-9);
+	EXPECT_NEAR(means[1][0], 10.1, 1e-9);
+	EXPECT_NEAR(means[2][0], 30.0, 1e-9);
+
+	// The merged covariance includes the spread of the means
+	std::vector<Matrix<double>> covs = cgm->getCovs();
+	EXPECT_NEAR(covs[0](0, 0), S_[0](0, 0) + 0.05*0.05, 1e-9);
+}
+
+TEST_F (CGMTest, SharedOperators) {
+	// Too far apart to merge, only Runnalls' reduction keeps all the mass
+	rcptr<CGM> cgm = offsetMixture({0.0, 20.0, 40.0, 60.0, 80.0}, 3);
+	double logMass = cgm->getLogMass();
+	cgm->setReducer( uniqptr<FactorOperator>(new InplaceRunnallsReduceCGM()) );
+
+	// Copies share the reducer, changing a copy's reducer leaves the original alone
+	rcptr<CGM> copy = uniqptr<CGM>(cgm->copy());
+	rcptr<CGM> other = uniqptr<CGM>(cgm->copy());
+	other->setReducer(0);
+
+	other->reduce();
+	copy->reduce();
+	cgm->reduce();
+	ASSERT_EQ(other->getNumberOfComponents(), 3);
+	ASSERT_EQ(copy->getNumberOfComponents(), 3);
+	ASSERT_EQ(cgm->getNumberOfComponents(), 3);
+
+	// The default reducer discards the two excess components
+	EXPECT_NEAR(cgm->getLogMass(), logMass, 1e-9);
+	EXPECT_NEAR(copy->getLogMass(), logMass, 1e-9);
+	EXPECT_NEAR(other->getLogMass(), logMass + log(3.0/5.0), 1e-9);
+}
+
+TEST_F (CGMTest, BinaryRoundTrip) {
+	std::vector<double> offsets = {0.0, 0.1, 10.0};
+	rcptr<CGM> cgm = offsetMixture(offsets, 7);
+
+	std::stringstream encoded;
+	cgm->binWrite(encoded);
+
+	rcptr<CGM> decoded = uniqptr<CGM>(new CGM());
+	ASSERT_TRUE(decoded->binRead(encoded));
+	EXPECT_EQ(decoded->getVars(), cgm->getVars());
+	ASSERT_EQ(decoded->getNumberOfComponents(), 3);
+	EXPECT_DOUBLE_EQ(decoded->getLogMass(), cgm->getLogMass());
+	EXPECT_DOUBLE_EQ(decoded->getMeans()[1][0], 0.1);
+
+	std::stringstream reencoded;
+	decoded->binWrite(reencoded);
+	EXPECT_EQ(reencoded.str(), encoded.str());
+
+	// A truncated encoding leaves the mixture untouched
+	std::stringstream truncated(encoded.str().substr(0, encoded.str().size() - 8));
+	rcptr<CGM> partial = offsetMixture(offsets, kMaxComp_);
+	EXPECT_FALSE(partial->binRead(truncated));
+	EXPECT_EQ(partial->getNumberOfComponents(), 3);
+
+	// So does a corrupt scope size, after the tag and version
+	std::string corrupt = encoded.str();
+	uint32_t size = 0xFFFFFFFF;
+	corrupt.replace(6, sizeof(size), reinterpret_cast<const char*>(&size), sizeof(size));
+	std::stringstream oversized(corrupt);
+	EXPECT_FALSE(partial->binRead(oversized));
+	EXPECT_EQ(partial->getNumberOfComponents(), 3);
+}
+
+TEST_F (CGMTest, SquareRoot) {
+	rcptr<CGM> plain = uniqptr<CGM>(new CGM(vars_, K_, h_, g_, false, kMaxComp_, kThreshold_, kUnionDistance_));
+	rcptr<CGM> root = uniqptr<CGM>(new CGM(vars_, K_, h_, g_, false, kMaxComp_, kThreshold_, kUnionDistance_));
+	root->setSquareRoot(true);
+	root->getCovs();
+
+	// A likelihood over part of the scope
+	emdw::RVIds observed = {1, 3};
+	Matrix<double> K = gLinear::zeros<double>(2, 2);
+	K(0, 0) = 2.0; K(0, 1) = K(1, 0) = 0.5; K(1, 1) = 1.0;
+	ColVector<double> h(2);
+	h[0] = 1.0; h[1] = -0.5;
+	rcptr<Factor> likelihood = uniqptr<Factor>(new GaussCanonical(observed, K, h, 0.0));
+
+	std::static_pointer_cast<Factor>(plain)->inplaceAbsorb(likelihood.get());
+	std::static_pointer_cast<Factor>(root)->inplaceAbsorb(likelihood.get());
+	std::static_pointer_cast<Factor>(plain)->inplaceCancel(likelihood.get());
+	std::static_pointer_cast<Factor>(root)->inplaceCancel(likelihood.get());
+	std::static_pointer_cast<Factor>(plain)->inplaceAbsorb(likelihood.get());
+	std::static_pointer_cast<Factor>(root)->inplaceAbsorb(likelihood.get());
+
+	EXPECT_NEAR(root->getLogMass(), plain->getLogMass(), 1e-9);
+	std::vector<ColVector<double>> means = root->getMeans(), expectedMeans = plain->getMeans();
+	std::vector<Matrix<double>> covs = root->getCovs(), expectedCovs = plain->getCovs();
+	ASSERT_EQ(covs.size(), expectedCovs.size());
+	for (unsigned k = 0; k < covs.size(); k++) {
+		for (unsigned i = 0; i < kDim_; i++) {
+			EXPECT_NEAR(means[k][i], expectedMeans[k][i], 1e-9);
+			for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(covs[k](i, j), expectedCovs[k](i, j), 1e-9);
+		}
+	}
+
+	// Derived mixtures inherit the setting
+	rcptr<Factor> marginal = root->marginalize(observed);
+	EXPECT_TRUE(std::dynamic_pointer_cast<CGM>(marginal)->isSquareRoot());
+	EXPECT_FALSE(plain->isSquareRoot());
+}
+
+TEST_F (CGMTest, BatchedObserveAndReduce) {
+	rcptr<CGM> cgm = uniqptr<CGM>(new CGM(vars_, K_, h_, g_, false, kMaxComp_, kThreshold_, kUnionDistance_));
+	std::static_pointer_cast<Factor>(cgm)->inplaceAbsorb(cgm.get());
+
+	// The observed variables in an order other than the scope's
+	emdw::RVIds observed = {4, 1};
+	std::vector<ColVector<double>> values(3);
+	for (unsigned t = 0; t < values.size(); t++) {
+		values[t] = ColVector<double>(2);
+		values[t][0] = 0.5*t; values[t][1] = -1.0 + t;
+	}
+
+	std::vector<rcptr<Factor>> batched = cgm->observeAndReduce(observed, values);
+	ASSERT_EQ(batched.size(), values.size());
+
+	for (unsigned t = 0; t < values.size(); t++) {
+		rcptr<Factor> single = std::static_pointer_cast<Factor>(cgm)->observeAndReduce(observed,
+				emdw::RVVals{values[t][0], values[t][1]});
+		EXPECT_EQ(batched[t]->getVars(), single->getVars());
+		EXPECT_NEAR(std::dynamic_pointer_cast<CGM>(batched[t])->getLogMass(),
+				std::dynamic_pointer_cast<CGM>(single)->getLogMass(), 1e-9);
+
+		std::vector<ColVector<double>> means = std::dynamic_pointer_cast<CGM>(batched[t])->getMeans();
+		std::vector<ColVector<double>> expected = std::dynamic_pointer_cast<CGM>(single)->getMeans();
+		ASSERT_EQ(means.size(), expected.size());
+		for (unsigned k = 0; k < means.size(); k++) {
+			for (unsigned i = 0; i < means[k].size(); i++) EXPECT_NEAR(means[k][i], expected[k][i], 1e-9);
+		}
+	}
+}
+
+TEST_F (CGMTest, BatchedUnscentedTransform) {
+	// Distinct, correlated components
+	std::vector<rcptr<Factor>> comps;
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu(kDim_);
+		Matrix<double> S = gLinear::zeros<double>(kDim_, kDim_);
+		for (unsigned i = 0; i < kDim_; i++) {
+			mu[i] = 1.0*k - 0.5*i;
+			S(i, i) = 1.0 + 0.25*i;
+		}
+		S(0, 1) = S(1, 0) = 0.3;
+		comps.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S)) );
+	}
+	rcptr<Factor> prior = uniqptr<Factor>(new CGM(vars_, comps));
+
+	emdw::RVIds newVars(kDim_);
+	for (unsigned i = 0; i < kDim_; i++) newVars[i] = kDim_ + i;
+	rcptr<V2VTransform> opaque = uniqptr<V2VTransform>(new OpaqueTransform(
+				uniqptr<AffineTransform>(new MotionModel(kTimeStep_))));
+	rcptr<CGM> joint = uniqptr<CGM>(new CGM(prior, opaque, newVars, Q_));
+	ASSERT_EQ(joint->getNumberOfComponents(), kCompN_);
+
+	// The motion model is affine, so the Unscented Transform is exact
+	Matrix<double> A = MotionModel::transitionMatrix(kTimeStep_);
+	ColVector<double> b = MotionModel::gravityOffset(kTimeStep_);
+
+	std::vector<ColVector<double>> means = joint->getMeans();
+	std::vector<Matrix<double>> covs = joint->getCovs();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu = std::dynamic_pointer_cast<GaussCanonical>(comps[k])->getMean();
+		Matrix<double> S = std::dynamic_pointer_cast<GaussCanonical>(comps[k])->getCov();
+		ColVector<double> y = A*mu + b;
+		Matrix<double> Syy = A*S*A.transpose() + Q_;
+		Matrix<double> Sxy = S*A.transpose();
+
+		for (unsigned i = 0; i < kDim_; i++) {
+			EXPECT_NEAR(means[k][i], mu[i], 1e-9);
+			EXPECT_NEAR(means[k][kDim_ + i], y[i], 1e-9);
+			for (unsigned j = 0; j < kDim_; j++) {
+				EXPECT_NEAR(covs[k](kDim_ + i, kDim_ + j), Syy(i, j), 1e-9);
+				EXPECT_NEAR(covs[k](i, kDim_ + j), Sxy(i, j), 1e-9);
+			}
+		}
+	}
+	EXPECT_NEAR(joint->getLogMass(), std::dynamic_pointer_cast<CGM>(prior)->getLogMass(), 1e-9);
+}
+
+TEST_F (CGMTest, BatchedSensorModel) {
+	ColVector<double> location(3);
+	for (unsigned i = 0; i < 3; i++) location[i] = 0;
+	rcptr<SensorModel> sensor = uniqptr<SensorModel>(new SensorModel(location, 3e8, 10.525e9, 200e-6, 47e6));
+
+	// Targets spread widely enough for the model's curvature to matter
+	std::vector<rcptr<Factor>> comps;
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu(kDim_);
+		Matrix<double> S = gLinear::zeros<double>(kDim_, kDim_);
+		for (unsigned i = 0; i < kDim_; i++) S(i, i) = 4.0 + k;
+		S(0, 2) = S(2, 0) = 1.5;
+		mu[0] = 20.0 + 15.0*k; mu[1] = 3.0 - 2.0*k;
+		mu[2] = -10.0 + 5.0*k; mu[3] = 1.0;
+		mu[4] = 5.0; mu[5] = -0.5*k;
+		comps.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S)) );
+	}
+	rcptr<Factor> prior = uniqptr<Factor>(new CGM(vars_, comps));
+
+	emdw::RVIds newVars = {kDim_, kDim_ + 1};
+	Matrix<double> R = gLinear::zeros<double>(2, 2);
+	R(0, 0) = 9; R(1, 1) = 4;
+	rcptr<CGM> joint = uniqptr<CGM>(new CGM(prior, rcptr<V2VTransform>(sensor), newVars, R));
+	ASSERT_EQ(joint->getNumberOfComponents(), kCompN_);
+
+	// The batched sigma points must give GaussCanonical's own Unscented Transform
+	std::vector<ColVector<double>> means = joint->getMeans();
+	std::vector<Matrix<double>> covs = joint->getCovs();
+	std::vector<double> logWeights = joint->getLogWeights();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		GaussCanonical expected(comps[k].get(), *sensor, newVars, R, false);
+		ASSERT_EQ(expected.getVars(), joint->getVars());
+		ColVector<double> mu = expected.getMean();
+		Matrix<double> S = expected.getCov();
+
+		for (unsigned i = 0; i < kDim_ + 2; i++) {
+			EXPECT_NEAR(means[k][i], mu[i], 1e-6*(1 + fabs(mu[i])));
+			for (unsigned j = 0; j < kDim_ + 2; j++) EXPECT_NEAR(covs[k](i, j), S(i, j), 1e-6*(1 + fabs(S(i, j))));
+		}
+		EXPECT_NEAR(logWeights[k], log(expected.getMass()), 1e-6);
+	}
+}
+
+TEST_F (CGMTest, AffineConstructor) {
+	std::vector<rcptr<Factor>> comps;
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu(kDim_);
+		Matrix<double> S = gLinear::zeros<double>(kDim_, kDim_);
+		for (unsigned i = 0; i < kDim_; i++) {
+			mu[i] = 0.5*k + 0.25*i;
+			S(i, i) = 2.0 - 0.2*i;
+		}
+		S(2, 3) = S(3, 2) = -0.4;
+		comps.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S)) );
+	}
+	rcptr<Factor> prior = uniqptr<Factor>(new CGM(vars_, comps));
+
+	emdw::RVIds newVars(kDim_);
+	for (unsigned i = 0; i < kDim_; i++) newVars[i] = kDim_ + i;
+
+	Matrix<double> A = MotionModel::transitionMatrix(kTimeStep_);
+	ColVector<double> b = MotionModel::gravityOffset(kTimeStep_);
+	rcptr<CGM> exact = uniqptr<CGM>(new CGM(prior, A, b, newVars, Q_));
+	rcptr<CGM> model = uniqptr<CGM>(new CGM(prior, motion_model_, newVars, Q_));
+	ASSERT_EQ(exact->getNumberOfComponents(), kCompN_);
+	ASSERT_EQ(model->getNumberOfComponents(), kCompN_);
+
+	// The motion model takes the same closed form path
+	std::vector<Matrix<double>> K = exact->getK(), modelK = model->getK();
+	std::vector<ColVector<double>> h = exact->getH(), modelH = model->getH();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		for (unsigned i = 0; i < 2*kDim_; i++) {
+			EXPECT_NEAR(h[k][i], modelH[k][i], 1e-9);
+			for (unsigned j = 0; j < 2*kDim_; j++) EXPECT_NEAR(K[k](i, j), modelK[k](i, j), 1e-9);
+		}
+	}
+
+	// And the joint's moments are exact
+	std::vector<ColVector<double>> means = exact->getMeans();
+	std::vector<Matrix<double>> covs = exact->getCovs();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu = std::dynamic_pointer_cast<GaussCanonical>(comps[k])->getMean();
+		Matrix<double> S = std::dynamic_pointer_cast<GaussCanonical>(comps[k])->getCov();
+		ColVector<double> y = A*mu + b;
+		Matrix<double> Syy = A*S*A.transpose() + Q_;
+		Matrix<double> Sxy = S*A.transpose();
+
+		for (unsigned i = 0; i < kDim_; i++) {
+			EXPECT_NEAR(means[k][i], mu[i], 1e-9);
+			EXPECT_NEAR(means[k][kDim_ + i], y[i], 1e-9);
+			for (unsigned j = 0; j < kDim_; j++) {
+				EXPECT_NEAR(covs[k](i, j), S(i, j), 1e-9);
+				EXPECT_NEAR(covs[k](kDim_ + i, kDim_ + j), Syy(i, j), 1e-9);
+				EXPECT_NEAR(covs[k](i, kDim_ + j), Sxy(i, j), 1e-9);
+			}
+		}
+	}
+	EXPECT_NEAR(exact->getLogMass(), std::dynamic_pointer_cast<CGM>(prior)->getLogMass(), 1e-9);
+}
+
+TEST_F (CGMTest, LinearisedSensorModel) {
+	ColVector<double> location(3);
+	for (unsigned i = 0; i < 3; i++) location[i] = 0;
+	rcptr<SensorModel> linearised = uniqptr<SensorModel>(new SensorModel(location, 3e8, 10.525e9, 200e-6, 47e6, true));
+	rcptr<SensorModel> unscented = uniqptr<SensorModel>(new SensorModel(location, 3e8, 10.525e9, 200e-6, 47e6));
+
+	// A slow target, and one receding close to the Doppler wrap
+	std::vector<rcptr<Factor>> comps;
+	for (unsigned k = 0; k < 2; k++) {
+		ColVector<double> mu(kDim_);
+		Matrix<double> S = gLinear::zeros<double>(kDim_, kDim_);
+		for (unsigned i = 0; i < kDim_; i++) {
+			mu[i] = 0;
+			S(i, i) = 0.5;
+		}
+		mu[0] = 80; mu[2] = 40; mu[4] = 10;
+		mu[1] = k ? 39 : 2; mu[3] = -1;
+		comps.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S)) );
+	}
+	rcptr<Factor> prior = uniqptr<Factor>(new CGM(vars_, comps));
+
+	emdw::RVIds newVars = {kDim_, kDim_ + 1};
+	Matrix<double> R = gLinear::zeros<double>(2, 2);
+	R(0, 0) = 9; R(1, 1) = 4;
+
+	rcptr<CGM> joint = uniqptr<CGM>(new CGM(prior, rcptr<V2VTransform>(linearised), newVars, R));
+	rcptr<CGM> sigma = uniqptr<CGM>(new CGM(prior, rcptr<V2VTransform>(unscented), newVars, R));
+	ASSERT_EQ(joint->getNumberOfComponents(), 2);
+	ASSERT_EQ(sigma->getNumberOfComponents(), 2);
+
+	// The slow target is linearised about its mean
+	ColVector<double> mu = std::dynamic_pointer_cast<GaussCanonical>(comps[0])->getMean();
+	Matrix<double> S = std::dynamic_pointer_cast<GaussCanonical>(comps[0])->getCov();
+	double x[6], cov[36], y[2], J[12];
+	for (unsigned i = 0; i < kDim_; i++) {
+		x[i] = mu[i];
+		for (unsigned j = 0; j < kDim_; j++) cov[i*kDim_ + j] = S(i, j);
+	}
+	ASSERT_TRUE(linearised->linearise(x, cov, y, J));
+
+	std::vector<ColVector<double>> means = joint->getMeans();
+	std::vector<Matrix<double>> covs = joint->getCovs();
+	for (unsigned r = 0; r < 2; r++) {
+		EXPECT_NEAR(means[0][kDim_ + r], y[r], 1e-6);
+		for (unsigned c = 0; c < kDim_; c++) {
+			double sxy = 0;
+			for (unsigned k = 0; k < kDim_; k++) sxy += S(c, k)*J[r*kDim_ + k];
+			EXPECT_NEAR(covs[0](c, kDim_ + r), sxy, 1e-6);
+		}
+		for (unsigned c = 0; c < 2; c++) {
+			double syy = R(r, c);
+			for (unsigned i = 0; i < kDim_; i++) {
+				for (unsigned k = 0; k < kDim_; k++) syy += J[r*kDim_ + i]*S(i, k)*J[c*kDim_ + k];
+			}
+			EXPECT_NEAR(covs[0](kDim_ + r, kDim_ + c), syy, 1e-6);
+		}
+	}
+
+	// The target near the wrap falls back to the Unscented Transform
+	std::vector<Matrix<double>> K = joint->getK(), sigmaK = sigma->getK();
+	std::vector<ColVector<double>> h = joint->getH(), sigmaH = sigma->getH();
+	for (unsigned i = 0; i < kDim_ + 2; i++) {
+		EXPECT_NEAR(h[1][i], sigmaH[1][i], 1e-9);
+		for (unsigned j = 0; j < kDim_ + 2; j++) EXPECT_NEAR(K[1](i, j), sigmaK[1](i, j), 1e-9);
+	}
+}
+
+TEST_F (CGMTest, SinglePassMomentMatch) {
+	// The tracker's state dimension and one without fixed size kernels
+	for (unsigned dim = 3; dim <= kDim_; dim += 3) {
+		emdw::RVIds vars(dim);
+		std::vector<double> weights = {2.0, 1e-3, 0.5};
+		std::vector<ColVector<double>> means(3);
+		std::vector<Matrix<double>> covs(3);
+		for (unsigned k = 0; k < 3; k++) {
+			means[k] = ColVector<double>(dim);
+			covs[k] = gLinear::zeros<double>(dim, dim);
+			for (unsigned i = 0; i < dim; i++) {
+				vars[i] = i;
+				means[k][i] = 3.0*k - 0.5*i;
+				covs[k](i, i) = 1.0 + 0.3*k + 0.1*i;
+			}
+			covs[k](0, 1) = covs[k](1, 0) = 0.2;
+		}
+
+		// Masses determined during the match, then taken from the cache
+		rcptr<CGM> cgm = uniqptr<CGM>( new CGM(vars, weights, means, covs) );
+		rcptr<CGM> reference = uniqptr<CGM>( new CGM(vars, weights, means, covs) );
+		double logMass = reference->getLogMass();
+
+		rcptr<Factor> projected = mProject(cgm->getComponents());
+		rcptr<GaussCanonical> expected = std::dynamic_pointer_cast<GaussCanonical>(projected);
+		for (unsigned pass = 0; pass < 2; pass++) {
+			rcptr<Factor> match = cgm->momentMatch();
+			rcptr<GaussCanonical> matched = std::dynamic_pointer_cast<GaussCanonical>(match);
+			ColVector<double> mu = matched->getMean(), expectedMu = expected->getMean();
+			Matrix<double> S = matched->getCov(), expectedS = expected->getCov();
+			for (unsigned i = 0; i < dim; i++) {
+				EXPECT_NEAR(mu[i], expectedMu[i], 1e-9);
+				for (unsigned j = 0; j < dim; j++) EXPECT_NEAR(S(i, j), expectedS(i, j), 1e-9);
+			}
+			EXPECT_NEAR(cgm->getLogMass(), logMass, 1e-9);
+			EXPECT_NEAR(log(matched->getMass()), logMass, 1e-9);
+		}
+	}
+}
+
+TEST_F (CGMTest, CollapseCache) {
+	emdw::RVIds vars = {0, 1};
+	std::vector<double> weights = {0.7, 0.3};
+	std::vector<ColVector<double>> means(2);
+	std::vector<Matrix<double>> covs(2);
+	for (unsigned k = 0; k < 2; k++) {
+		means[k] = ColVector<double>(2);
+		means[k][0] = 2.0*k;
+		means[k][1] = -1.0*k;
+		covs[k] = gLinear::zeros<double>(2, 2);
+		covs[k](0, 0) = covs[k](1, 1) = 1.0 + k;
+	}
+	rcptr<CGM> cgm = uniqptr<CGM>( new CGM(vars, weights, means, covs) );
+
+	// Repeated collapses of an unchanged mixture are served from its cache
+	CGM::resetCollapseCounters();
+	rcptr<Factor> first = cgm->momentMatch();
+	rcptr<Factor> second = cgm->momentMatchCGM();
+	EXPECT_EQ(CGM::collapseMisses(), 1u);
+	EXPECT_EQ(CGM::collapseHits(), 1u);
+
+	ColVector<double> mu = std::dynamic_pointer_cast<GaussCanonical>(first)->getMean();
+	std::vector<ColVector<double>> cachedMu = std::dynamic_pointer_cast<CGM>(second)->getMeans();
+	ASSERT_EQ(cachedMu.size(), 1u);
+	for (unsigned i = 0; i < 2; i++) EXPECT_DOUBLE_EQ(cachedMu[0][i], mu[i]);
+
+	// Changing the mixture invalidates the cache
+	double logMass = log(std::dynamic_pointer_cast<GaussCanonical>(first)->getMass());
+	cgm->adjustMass(2.0);
+	rcptr<Factor> scaled = cgm->momentMatch();
+	EXPECT_EQ(CGM::collapseMisses(), 2u);
+	EXPECT_NEAR(log(std::dynamic_pointer_cast<GaussCanonical>(scaled)->getMass()), logMass + log(2.0), 1e-9);
+
+	cgm->appendComponent(first.get());
+	cgm->momentMatch();
+	EXPECT_EQ(CGM::collapseMisses(), 3u);
+	EXPECT_EQ(CGM::collapseHits(), 1u);
+	CGM::resetCollapseCounters();
+}
+
+TEST_F (CGMTest, StaleMoments) {
+	// Pruning and merging keeps the cached masses but not the moments
+	rcptr<CGM> merged = warmMixture(2);
+	merged->pruneAndMerge();
+	ASSERT_EQ(merged->getNumberOfComponents(), 2);
+	expectFreshMomentMatch(merged);
+
+	// Copying onto a new scope permutes the moments
+	rcptr<CGM> source = warmMixture(3);
+	rcptr<CGM> swapped = uniqptr<CGM>(source->copy({1, 0}));
+	expectFreshMomentMatch(swapped);
+
+	// The fused product and reduction
+	rcptr<CGM> fused = warmMixture(2);
+	ColVector<double> mu(2); mu[0] = 45.0; mu[1] = -10.0;
+	Matrix<double> S = gLinear::zeros<double>(2, 2); S(0, 0) = 100.0; S(1, 1) = 100.0;
+	GaussCanonical multiplier(emdw::RVIds{0, 1}, mu, S);
+	fused->inplaceAbsorbAndReduce(&multiplier);
+	expectFreshMomentMatch(fused);
+}
@@ -0,0 +1,84 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for measurement_gate.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include <random>
+#include "gtest/gtest.h"
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "gausscanonical.hpp"
+#include "measurement_gate.hpp"
+
+class MeasurementGateTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			std::mt19937 generator(5);
+			std::uniform_real_distribution<double> position(-20.0, 20.0);
+			std::uniform_real_distribution<double> spread(0.5, 4.0);
+
+			for (unsigned t = 0; t < kTargets_; t++) {
+				ColVector<double> mean(kDim_);
+				Matrix<double> cov = gLinear::zeros<double>(kDim_, kDim_);
+				for (unsigned r = 0; r < kDim_; r++) {
+					mean[r] = position(generator);
+					cov(r, r) = spread(generator);
+				}
+				cov(0, 1) = cov(1, 0) = 0.3*sqrt(cov(0, 0)*cov(1, 1));
+				targets_.push_back(uniqptr<Factor>(new GaussCanonical(emdw::RVIds{0, 1}, mean, cov)));
+			}
+
+			for (unsigned j = 0; j < kMeasurements_; j++) {
+				ColVector<double> z(kDim_);
+				for (unsigned r = 0; r < kDim_; r++) z[r] = position(generator);
+				measurements_.push_back(z);
+			}
+			measurements_.push_back(ColVector<double>()); // Empty measurement
+		}
+
+		virtual void TearDown() {
+			targets_.clear();
+			measurements_.clear();
+		}
+
+	protected:
+		const unsigned kDim_ = 2;
+		const unsigned kTargets_ = 13;
+		const unsigned kMeasurements_ = 40;
+		const double kThreshold_ = 9.0;
+
+		std::vector<rcptr<Factor>> targets_;
+		std::vector<ColVector<double>> measurements_;
+};
+
+TEST_F (MeasurementGateTest, MatchesMahalanobis) {
+	// Target indices offset as they would be by the sensors
+	MeasurementGate gate(kDim_);
+	for (unsigned t = 0; t < kTargets_; t++) EXPECT_TRUE(gate.addTarget(t + 3, targets_[t].get()));
+	ASSERT_EQ(gate.size(), kTargets_);
+
+	std::vector<rcptr<std::vector<unsigned short>>> hypotheses(measurements_.size());
+	for (unsigned j = 0; j < kMeasurements_; j++) hypotheses[j] = uniqptr<std::vector<unsigned short>>(new std::vector<unsigned short>{1});
+	gate.gate(measurements_, kThreshold_, hypotheses);
+
+	unsigned gated = 0;
+	for (unsigned j = 0; j < kMeasurements_; j++) {
+		std::vector<unsigned short> expected{1};
+		for (unsigned t = 0; t < kTargets_; t++) {
+			double distance = std::dynamic_pointer_cast<GaussCanonical>(targets_[t])->mahalanobis(measurements_[j]);
+			if (distance < kThreshold_) expected.push_back(t + 3);
+		}
+		EXPECT_EQ(*hypotheses[j], expected);
+		gated += expected.size() - 1;
+	}
+
+	// The test is only meaningful if some pairs pass the gate
+	EXPECT_GT(gated, 0);
+	EXPECT_TRUE(hypotheses[kMeasurements_] == nullptr);
+}
@@ -0,0 +1,73 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for scope_plan.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "emdw.hpp"
+#include "scope_plan.hpp"
+
+class ScopePlanTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			ScopePlan::clear();
+
+			// An 8 dimensional joint
+			for (unsigned i = 0; i < 8; i++) joint_.push_back(10 + i);
+		}
+
+		virtual void TearDown() {
+			ScopePlan::clear();
+		}
+
+	protected:
+		emdw::RVIds joint_;
+};
+
+TEST_F (ScopePlanTest, SplitsScope) {
+	// The selection's order and stray variables don't matter to the split
+	rcptr<const ScopePlan> plan = ScopePlan::get(joint_, emdw::RVIds{17, 11, 3, 12});
+
+	EXPECT_EQ(plan->selected(), (std::vector<unsigned>{1, 2, 7}));
+	EXPECT_EQ(plan->remaining(), (std::vector<unsigned>{0, 3, 4, 5, 6}));
+	EXPECT_EQ(plan->selectedVars(joint_), (emdw::RVIds{11, 12, 17}));
+	EXPECT_EQ(plan->remainingVars(joint_), (emdw::RVIds{10, 13, 14, 15, 16}));
+	EXPECT_EQ(plan->source(), (std::vector<unsigned>{1, 3, 0}));
+}
+
+TEST_F (ScopePlanTest, CachesPlans) {
+	emdw::RVIds state = {10, 11, 12, 13, 14, 15};
+	rcptr<const ScopePlan> first = ScopePlan::get(joint_, state);
+	rcptr<const ScopePlan> second = ScopePlan::get(joint_, state);
+	EXPECT_EQ(first.get(), second.get());
+	EXPECT_EQ(ScopePlan::size(), 1u);
+
+	// A full cache starts over, plans already handed out survive
+	for (unsigned i = 0; i < ScopePlan::kMaxPlans; i++) ScopePlan::get(emdw::RVIds(9 + i), state);
+	EXPECT_LT(ScopePlan::size(), ScopePlan::kMaxPlans);
+	EXPECT_EQ(first->selectedVars(joint_), state);
+	EXPECT_NE(ScopePlan::get(joint_, state).get(), first.get());
+}
+
+TEST_F (ScopePlanTest, SharesLayouts) {
+	// Another target's joint at a later time step, with the same layout
+	emdw::RVIds later;
+	for (unsigned i = 0; i < 8; i++) later.push_back(50 + 3*i);
+
+	rcptr<const ScopePlan> first = ScopePlan::get(joint_, emdw::RVIds{10, 11, 12, 13, 14, 15});
+	rcptr<const ScopePlan> second = ScopePlan::get(later, emdw::RVIds{50, 53, 56, 59, 62, 65});
+	EXPECT_EQ(first.get(), second.get());
+	EXPECT_EQ(ScopePlan::size(), 1u);
+	EXPECT_EQ(second->selectedVars(later), (emdw::RVIds{50, 53, 56, 59, 62, 65}));
+	EXPECT_EQ(second->remainingVars(later), (emdw::RVIds{68, 71}));
+
+	// A different selection order is a different layout
+	rcptr<const ScopePlan> reordered = ScopePlan::get(later, emdw::RVIds{53, 50, 56, 59, 62, 65});
+	EXPECT_NE(reordered.get(), first.get());
+	EXPECT_EQ(reordered->source(), (std::vector<unsigned>{1, 0, 2, 3, 4, 5}));
+}
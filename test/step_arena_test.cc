@@ -0,0 +1,121 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for step_arena.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include "gtest/gtest.h"
+#include "step_arena.hpp"
+#include "system_constants.hpp"
+#include "algorithmic_steps.hpp"
+
+class StepArenaTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+		}
+
+		virtual void TearDown() {
+		}
+
+	protected:
+		// A step's worth of small allocations fits in one block
+		const size_t kBlockSize_ = 1 << 12;
+};
+
+TEST_F (StepArenaTest, RewindsWhenNothingSurvives) {
+	StepArena arena(kBlockSize_);
+
+	{
+		rcptr<std::vector<double>> values = arena.make<std::vector<double>>(3, 1.5);
+		EXPECT_EQ(values->size(), 3);
+		EXPECT_EQ((*values)[2], 1.5);
+	}
+	size_t capacity = arena.capacity();
+	arena.reset();
+
+	// The blocks are reused rather than reallocated
+	for (unsigned step = 0; step < 10; step++) {
+		std::vector<rcptr<double>> values;
+		for (unsigned i = 0; i < 50; i++) values.push_back(arena.make<double>(i));
+		for (unsigned i = 0; i < 50; i++) EXPECT_EQ(*values[i], i);
+
+		values.clear();
+		arena.reset();
+	}
+	EXPECT_EQ(arena.capacity(), capacity);
+}
+
+TEST_F (StepArenaTest, SurvivorsOutliveReset) {
+	StepArena arena(kBlockSize_);
+
+	rcptr<std::vector<unsigned>> survivor = arena.make<std::vector<unsigned>>(4, 7u);
+	arena.reset();
+
+	// New allocations must not overwrite the survivor
+	for (unsigned i = 0; i < 100; i++) arena.make<std::vector<unsigned>>(4, i);
+	std::vector<rcptr<unsigned>> fresh;
+	for (unsigned i = 0; i < 100; i++) fresh.push_back(arena.make<unsigned>(i));
+
+	ASSERT_EQ(survivor->size(), 4);
+	for (unsigned i = 0; i < 4; i++) EXPECT_EQ((*survivor)[i], 7u);
+}
+
+TEST_F (StepArenaTest, Oversized) {
+	ArenaBlocks blocks(kBlockSize_);
+
+	// Allocations larger than a block get their own, suitably aligned
+	void* small = blocks.allocate(24, 8);
+	void* large = blocks.allocate(4*kBlockSize_, 32);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(small) % 8, 0);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 32, 0);
+	EXPECT_GE(blocks.capacity(), 5*kBlockSize_);
+
+	// Rewinding hands out the same memory again
+	blocks.rewind();
+	EXPECT_EQ(blocks.allocate(24, 8), small);
+}
+
+TEST_F (StepArenaTest, MeasurementStepRewinds) {
+	measurementManager = uniqptr<MeasurementManager>(new MeasurementManager("data/cpep_single/single_target_0.05", mht::kNumSensors));
+	graphBuilder = uniqptr<GraphBuilder>(new GraphBuilder());
+
+	// Clutter states and a single target, as set up by main
+	currentStates[0].clear(); currentStates[0].resize(mht::kNumSensors+1); 
+	stateNodes[0].clear(); stateNodes[0].resize(mht::kNumSensors+1); 
+	for (unsigned i = 0; i < mht::kNumSensors; i++) vecX.push_back(i);
+
+	currentStates[0][mht::kNumSensors] = addVariables(variables, vecX, elementsOfX, mht::kStateSpaceDim);
+	rcptr<Factor> prior = uniqptr<Factor>(new CGM(elementsOfX[currentStates[0][mht::kNumSensors]], 
+				{1.0},
+				{1.0*mht::kGenericMean},
+				{1.0*mht::kGenericCov}));
+	stateNodes[0][mht::kNumSensors] = uniqptr<Node> (new Node(prior, mht::kNumSensors) );
+	stepArena.reset();
+
+	// Nothing made during a measurement step outlives it
+	size_t capacity = 0;
+	for (unsigned N = 1; N < 5; N++) {
+		predictStatesAU(N, currentStates, stateNodes);
+		measurementUpdateAU(N, currentStates, virtualMeasurementVars, stateNodes, measurementNodes, 
+				predMarginals, predMeasurements, validationRegion);
+		ASSERT_GT(measurementNodes[N].size(), 0);
+
+		if (N == 1) capacity = stepArena.capacity();
+		EXPECT_GT(capacity, 0);
+		EXPECT_TRUE(stepArena.reset());
+		EXPECT_EQ(stepArena.capacity(), capacity);
+	}
+
+	// The state nodes are still usable after the resets
+	for (unsigned N = 0; N < 5; N++) {
+		const emdw::RVIds& vars = elementsOfX[currentStates[N][mht::kNumSensors]];
+		rcptr<Factor> marginal = stateNodes[N][mht::kNumSensors]->marginalize(vars);
+		EXPECT_EQ(marginal->getVars(), vars);
+		EXPECT_GT(std::dynamic_pointer_cast<CGM>(marginal)->getNumberOfComponents(), 0);
+	}
+}
@@ -41,3 +41,49 @@ TEST_F (TransformsTest, MotionModelTest) {
 
 	//for (unsigned i = 0; i < 6; i++) std::cout << (transform[i]->operator()(x))[0] << std::endl;
 }
+
+TEST_F (TransformsTest, SensorModelJacobian) {
+	ColVector<double> location(3);
+	location[0] = 1.0; location[1] = -2.0; location[2] = 0.5;
+	SensorModel sensor(location, 3e8, 10.525e9, 200e-6, 47e6, true);
+
+	double x[6] = {-94.8463, -12.8935, 22.0664, -0.0470, 13.4131, -8.4455};
+	double cov[36] = {0};
+	for (unsigned i = 0; i < 6; i++) cov[i*6 + i] = 0.01;
+
+	double y[2], J[12], z[2];
+	ASSERT_TRUE(sensor.linearise(x, cov, y, J));
+	sensor.transform(x, 1, z);
+	EXPECT_NEAR(y[0], z[0], 1e-12);
+	EXPECT_NEAR(y[1], z[1], 1e-12);
+
+	// Central differences
+	const double step = 1e-5;
+	for (unsigned c = 0; c < 6; c++) {
+		double plus[6], minus[6], zp[2], zm[2];
+		for (unsigned i = 0; i < 6; i++) plus[i] = minus[i] = x[i];
+		plus[c] += step; minus[c] -= step;
+		sensor.transform(plus, 1, zp);
+		sensor.transform(minus, 1, zm);
+		for (unsigned r = 0; r < 2; r++) EXPECT_NEAR(J[r*6 + c], (zp[r] - zm[r])/(2*step), 1e-6);
+	}
+}
+
+TEST_F (TransformsTest, SensorModelWrap) {
+	ColVector<double> location(3);
+	for (unsigned i = 0; i < 3; i++) location[i] = 0;
+	SensorModel sensor(location, 3e8, 10.525e9, 200e-6, 47e6);
+	EXPECT_FALSE(sensor.isLinearised());
+
+	// Receding at close to vMax = c/(4 fc tp) ~ 35.6 m/s
+	double x[6] = {100, 30, 0, 0, 0, 0};
+	double cov[36] = {0};
+	for (unsigned i = 0; i < 6; i++) cov[i*6 + i] = 0.01;
+
+	double y[2], J[12];
+	EXPECT_TRUE(sensor.linearise(x, cov, y, J));
+
+	// A wider spread reaches the wrap
+	for (unsigned i = 0; i < 6; i++) cov[i*6 + i] = 4;
+	EXPECT_FALSE(sensor.linearise(x, cov, y, J));
+}
@@ -0,0 +1,110 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for transition_factor.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "genvec.hpp"
+#include "genmat.hpp"
+#include "emdw.hpp"
+#include "v2vtransform.hpp"
+#include "gausscanonical.hpp"
+#include "canonical_gaussian_mixture.hpp"
+#include "transforms.hpp"
+#include "transition_factor.hpp"
+
+class TransitionFactorTest : public testing::Test {
+
+	protected:
+		typedef CanonicalGaussianMixture CGM;
+
+		virtual void SetUp() {
+			for (unsigned i = 0; i < kDim_; i++) {
+				vars_.push_back(i);
+				newVars_.push_back(kDim_ + i);
+			}
+
+			Q_ = gLinear::zeros<double>(kDim_, kDim_);
+			for (unsigned i = 0; i < kDim_; i++) Q_(i, i) = 1.0 + 0.5*i;
+			Q_(4, 5) = Q_(5, 4) = 0.2;
+
+			for (unsigned k = 0; k < kCompN_; k++) {
+				ColVector<double> mu(kDim_);
+				Matrix<double> S = gLinear::zeros<double>(kDim_, kDim_);
+				for (unsigned i = 0; i < kDim_; i++) {
+					mu[i] = 2.0*k - 0.3*i;
+					S(i, i) = 0.5 + 0.1*i + 0.2*k;
+				}
+				S(0, 1) = S(1, 0) = 0.1;
+				comps_.push_back( uniqptr<Factor>(new GaussCanonical(vars_, mu, S)) );
+			}
+			prior_ = uniqptr<Factor>(new CGM(vars_, comps_));
+		}
+
+		virtual void TearDown() {
+			comps_.clear();
+		}
+
+	protected:
+		const unsigned kCompN_ = 4;
+		const unsigned kDim_ = 6;
+		const double kTimeStep_ = 0.04;
+
+		emdw::RVIds vars_;
+		emdw::RVIds newVars_;
+		Matrix<double> Q_;
+		std::vector<rcptr<Factor>> comps_;
+		rcptr<Factor> prior_;
+};
+
+TEST_F (TransitionFactorTest, MatchesAffineConstructor) {
+	MotionModel motion(kTimeStep_);
+	rcptr<const TransitionFactor> transition(new TransitionFactor(motion, Q_));
+	EXPECT_EQ(transition->inputDimension(), kDim_);
+	EXPECT_EQ(transition->outputDimension(), kDim_);
+
+	// Reused across mixtures, it must give the per-call result
+	rcptr<CGM> cached = uniqptr<CGM>(new CGM(prior_, transition, newVars_));
+	rcptr<CGM> direct = uniqptr<CGM>(new CGM(prior_, motion.getA(), motion.getB(), newVars_, Q_));
+	ASSERT_EQ(cached->getNumberOfComponents(), kCompN_);
+	EXPECT_EQ(cached->getVars(), direct->getVars());
+
+	std::vector<Matrix<double>> K = cached->getK(), directK = direct->getK();
+	std::vector<ColVector<double>> h = cached->getH(), directH = direct->getH();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		for (unsigned i = 0; i < 2*kDim_; i++) {
+			EXPECT_DOUBLE_EQ(h[k][i], directH[k][i]);
+			for (unsigned j = 0; j < 2*kDim_; j++) EXPECT_DOUBLE_EQ(K[k](i, j), directK[k](i, j));
+		}
+	}
+	EXPECT_NEAR(cached->getLogMass(), std::dynamic_pointer_cast<CGM>(prior_)->getLogMass(), 1e-9);
+}
+
+TEST_F (TransitionFactorTest, PredictsMoments) {
+	MotionModel motion(kTimeStep_);
+	rcptr<const TransitionFactor> transition(new TransitionFactor(motion, Q_));
+	rcptr<CGM> joint = uniqptr<CGM>(new CGM(prior_, transition, newVars_));
+
+	// The prediction's marginal over x_t is N(A mu + b, A S A' + Q)
+	rcptr<Factor> marginal = joint->marginalize(newVars_);
+	std::vector<ColVector<double>> means = std::dynamic_pointer_cast<CGM>(marginal)->getMeans();
+	std::vector<Matrix<double>> covs = std::dynamic_pointer_cast<CGM>(marginal)->getCovs();
+	ASSERT_EQ(means.size(), kCompN_);
+
+	const Matrix<double>& A = motion.getA();
+	for (unsigned k = 0; k < kCompN_; k++) {
+		ColVector<double> mu = std::dynamic_pointer_cast<GaussCanonical>(comps_[k])->getMean();
+		Matrix<double> S = std::dynamic_pointer_cast<GaussCanonical>(comps_[k])->getCov();
+		ColVector<double> y = A*mu + motion.getB();
+		Matrix<double> Syy = A*S*A.transpose() + Q_;
+
+		for (unsigned i = 0; i < kDim_; i++) {
+			EXPECT_NEAR(means[k][i], y[i], 1e-9);
+			for (unsigned j = 0; j < kDim_; j++) EXPECT_NEAR(covs[k](i, j), Syy(i, j), 1e-9);
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/*************************************************************************
+ *  Compilation: ./run_main.sh
+ *  Execution: ./run_main.sh
+ *  Dependencies: None
+ *
+ * Google Test fixture for weight_kernels.hpp.
+ *************************************************************************/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+#include "gtest/gtest.h"
+#include "weight_kernels.hpp"
+
+class WeightKernelsTest : public testing::Test {
+
+	protected:
+		virtual void SetUp() {
+			std::mt19937 generator(11);
+			std::uniform_real_distribution<double> logWeight(-800.0, 50.0);
+
+			// An odd length exercises the scalar tail
+			logWeights_.resize(kWeights_);
+			for (double& w : logWeights_) w = logWeight(generator);
+			logWeights_[3] = -std::numeric_limits<double>::infinity();
+			logWeights_[8] = std::numeric_limits<double>::infinity();
+		}
+
+		virtual void TearDown() {
+			logWeights_.clear();
+		}
+
+	protected:
+		const unsigned kWeights_ = 103;
+		std::vector<double> logWeights_;
+};
+
+TEST_F (WeightKernelsTest, LogSumExp) {
+	double maxWeight = -std::numeric_limits<double>::infinity();
+	for (double w : logWeights_) if (std::isfinite(w)) maxWeight = std::max(maxWeight, w);
+	double linearSum = 0;
+	for (double w : logWeights_) if (std::isfinite(w)) linearSum += exp(w - maxWeight);
+
+	EXPECT_NEAR(logSumExp(logWeights_.data(), kWeights_), maxWeight + log(linearSum), 1e-12);
+
+	// Nothing finite
+	std::vector<double> none(5, -std::numeric_limits<double>::infinity());
+	EXPECT_TRUE(std::isinf(logSumExp(none.data(), none.size())));
+	EXPECT_TRUE(std::isinf(logSumExp(none.data(), 0)));
+}
+
+TEST_F (WeightKernelsTest, RelativeWeights) {
+	double total = logSumExp(logWeights_.data(), kWeights_);
+	std::vector<double> weights(kWeights_);
+	relativeWeights(logWeights_.data(), kWeights_, total, weights.data());
+
+	for (unsigned i = 0; i < kWeights_; i++) {
+		double expected = exp(logWeights_[i] - total);
+		if (std::isinf(expected)) EXPECT_TRUE(std::isinf(weights[i]));
+		else EXPECT_NEAR(weights[i], expected, 1e-14*expected + 1e-300);
+	}
+
+	// In place
+	relativeWeights(logWeights_.data(), kWeights_, total, logWeights_.data());
+	for (unsigned i = 0; i < kWeights_; i++) {
+		if (std::isfinite(weights[i])) {
+			EXPECT_EQ(logWeights_[i], weights[i]);
+		}
+	}
+}
+
+TEST_F (WeightKernelsTest, ExpWeights) {
+	std::vector<double> weights(kWeights_);
+	expWeights(logWeights_.data(), kWeights_, weights.data());
+
+	for (unsigned i = 0; i < kWeights_; i++) {
+		double expected = exp(logWeights_[i]);
+		if (std::isinf(expected)) EXPECT_TRUE(std::isinf(weights[i]));
+		else EXPECT_NEAR(weights[i], expected, 1e-14*expected + 1e-300);
+	}
+}